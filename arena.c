@@ -0,0 +1,107 @@
+#include "./arena.h"
+#include <stdlib.h>
+
+// every allocation is aligned for the strictest of these
+typedef union {
+    long double ld;
+    long long ll;
+    void *p;
+} align_t;
+#define ALIGNMENT sizeof(align_t)
+
+// blocks form a list from the newest block, allocations come from the front
+// of the newest block and a new block is added when it is full
+struct arena_block {
+    struct arena_block *next;
+    size_t size;
+    size_t used;
+    align_t data[];
+};
+typedef struct arena_block arena_block_t;
+
+// total is the size of every block together, so that a reset can replace
+// them with one block that is big enough for the same allocations
+struct arena {
+    arena_block_t *blocks;
+    size_t total;
+};
+
+/* allocates a block that holds size bytes */
+static arena_block_t *new_block(size_t size, arena_block_t *next) {
+    arena_block_t *block =
+        (arena_block_t *)malloc(sizeof(arena_block_t) + size);
+    block->next = next;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+/* initializes an arena whose first block holds size bytes, returns pointer */
+arena_t *init_arena(size_t size) {
+    arena_t *arena = (arena_t *)malloc(sizeof(arena_t));
+    arena->blocks = new_block(size, NULL);
+    arena->total = size;
+    return arena;
+}
+
+/*
+ * cleans up the arena and everything allocated from it
+ * Note: this function will free the arena pointer
+ * DO NOT use the pointer after this function is called
+ */
+void cleanup_arena(arena_t *arena) {
+    if (arena == NULL) {
+        return;
+    }
+    arena_block_t *block = arena->blocks;
+    while (block != NULL) {
+        arena_block_t *next = block->next;
+        free(block);
+        block = next;
+    }
+    free(arena);
+}
+
+/*
+ * allocates size bytes from the arena, aligned for any pointer or integer,
+ * returns pointer, the memory is not zeroed
+ * everything allocated stays valid until the arena is reset
+ */
+void *arena_alloc(arena_t *arena, size_t size) {
+    size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+
+    arena_block_t *block = arena->blocks;
+    if (block->size - block->used < size) {
+        // at least double what the arena holds, so a run of allocations
+        // only adds a few blocks
+        size_t block_size = arena->total;
+        while (block_size < size) {
+            block_size *= 2;
+        }
+        block = new_block(block_size, block);
+        arena->blocks = block;
+        arena->total += block_size;
+    }
+
+    void *memory = (char *)block->data + block->used;
+    block->used += size;
+    return memory;
+}
+
+/*
+ * frees everything allocated from the arena at once, keeping its memory
+ * for the next allocations
+ */
+void reset_arena(arena_t *arena) {
+    if (arena->blocks->next != NULL) {
+        // merge the blocks into one, next time everything fits in it
+        arena_block_t *block = arena->blocks;
+        while (block != NULL) {
+            arena_block_t *next = block->next;
+            free(block);
+            block = next;
+        }
+        arena->blocks = new_block(arena->total, NULL);
+    }
+    arena->blocks->used = 0;
+}
@@ -0,0 +1,30 @@
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <stddef.h>
+
+typedef struct arena arena_t;
+
+/* initializes an arena whose first block holds size bytes, returns pointer */
+arena_t *init_arena(size_t size);
+/*
+ * cleans up the arena and everything allocated from it
+ * Note: this function will free the arena pointer
+ * DO NOT use the pointer after this function is called
+ */
+void cleanup_arena(arena_t *arena);
+
+/*
+ * allocates size bytes from the arena, aligned for any pointer or integer,
+ * returns pointer, the memory is not zeroed
+ * everything allocated stays valid until the arena is reset
+ */
+void *arena_alloc(arena_t *arena, size_t size);
+
+/*
+ * frees everything allocated from the arena at once, keeping its memory
+ * for the next allocations
+ */
+void reset_arena(arena_t *arena);
+
+#endif  // ARENA_H_
@@ -0,0 +1,704 @@
+#include <fcntl.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "./parser.h"
+#include "./sh.h"
+#include "./walk.h"
+
+/*
+ * microbenchmarks of the shell's hot paths, run with make bench
+ * every benchmark is timed over RUNS runs of many operations each, and is
+ * reported as the mean time of one operation with the standard deviation and
+ * the minimum over the runs
+ */
+
+#define RUNS 10
+#define PARSE_BYTES (1 << 22)  // bytes parsed in every run of a parse benchmark
+#define JOB_OPS (1 << 18)      // operations in every run of a job benchmark
+#define JOB_BATCH 1024         // most jobs removed and added back at once
+#define ENV_OPS (1 << 16)      // operations in every run of an environment benchmark
+#define HISTORY_ENTRIES 1000000  // entries in the history file
+#define HISTORY_OPS (1 << 18)    // lookups in every run of the history benchmark
+#define HISTORY_ADDS 1024        // appends in every run of the history benchmark
+#define SEARCH_OPS 256           // searches in every run of a search benchmark
+#define COMPLETION_FILES 100000  // files in the directory that is completed in
+#define COMPLETION_OPS 1024      // completions in every run of a completion benchmark
+#define COMPLETION_ADDS 64       // files created in every run of the update benchmark
+#define GLOB_FILES 100000        // files in the directory that is globbed
+#define GLOB_OPS 256             // expansions in every run of a narrow glob benchmark
+#define WALK_FANOUT 16           // directories in every directory of the walked tree
+#define WALK_FILES 64            // files in every directory at its bottom
+#define PID_BASE 1000000       // the fake PIDs of the jobs start here
+#define LINE_SIZE 8192
+
+static const int word_counts[] = {1, 8, 64, 512};
+static const int job_counts[] = {10, 1000, 100000};
+static const int env_counts[] = {10, 1000, 10000};
+
+// searches of the history benchmark: a needle found in the newest entries, one
+// found once in the middle, one in no entry, and an autosuggestion's prefix
+static const struct {
+    const char *name;
+    const char *needle;
+    int prefix;
+} searches[] = {
+    {"history/1M search recent", "pattern3", 0},
+    {"history/1M search rare", "file500000 ", 0},
+    {"history/1M search missing", "/usr/bin/env", 0},
+    {"history/1M search prefix", "/bin/cat /tmp/file4242", 1},
+};
+
+/* gets the current CLOCK_MONOTONIC time in nanoseconds */
+static uint64_t now_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+/* xorshift, random enough to pick jobs in an order the table can't predict */
+static uint64_t next_random(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/* shuffles the first n PIDs of the array */
+static void shuffle(pid_t *pids, int n, uint64_t *state) {
+    for (int i = n - 1; i > 0; i--) {
+        int j = (int)(next_random(state) % (uint64_t)(i + 1));
+        pid_t tmp = pids[i];
+        pids[i] = pids[j];
+        pids[j] = tmp;
+    }
+}
+
+/* prints the mean, standard deviation and minimum of the runs, in ns/op */
+static void report(const char *name, const double *runs) {
+    double sum = 0;
+    double min = runs[0];
+    for (int i = 0; i < RUNS; i++) {
+        sum += runs[i];
+        min = runs[i] < min ? runs[i] : min;
+    }
+    double mean = sum / RUNS;
+
+    double squares = 0;
+    for (int i = 0; i < RUNS; i++) {
+        squares += (runs[i] - mean) * (runs[i] - mean);
+    }
+    double stddev = sqrt(squares / (RUNS - 1));
+
+    printf("%-32s %12.1f %10.1f %12.1f\n", name, mean, stddev, min);
+}
+
+/*
+ * times parse() on the line, which is copied first every time since parse()
+ * unquotes it in place, and the arena is reset after it like run_line() does
+ */
+static void bench_parse(const char *name, const char *line, arena_t *arena,
+                        vars_t *vars) {
+    static char buffer[LINE_SIZE];
+    double runs[RUNS];
+    size_t len = strlen(line) + 1;
+    int ops = (int)(PARSE_BYTES / len) + 1;
+    pipeline_t pipeline;
+
+    for (int r = 0; r < RUNS; r++) {
+        uint64_t start = now_ns();
+        for (int i = 0; i < ops; i++) {
+            memcpy(buffer, line, len);
+            if (parse(buffer, arena, vars, NULL, NULL, &pipeline) != 0) {
+                fprintf(stderr, "%s: line doesn't parse\n", name);
+                exit(1);
+            }
+            reset_arena(arena);
+        }
+        runs[r] = (double)(now_ns() - start) / ops;
+    }
+    report(name, runs);
+}
+
+/* builds a command of n words, with redirections and quoting if fancy is set */
+static void build_line(char *line, int n, int fancy) {
+    int len = sprintf(line, "%s", fancy ? "< in.txt /bin/cmd" : "/bin/cmd");
+    for (int i = 1; i < n; i++) {
+        if (fancy && i % 4 == 0) {
+            len += sprintf(line + len, " \"arg %d\"", i);
+        } else if (fancy && i % 4 == 2) {
+            len += sprintf(line + len, " 'a\\%d'", i);
+        } else {
+            len += sprintf(line + len, " arg%d", i);
+        }
+    }
+    if (fancy) {
+        sprintf(line + len, " >> out.txt");
+    }
+}
+
+static void bench_parser() {
+    arena_t *arena = init_arena(ARENA_SIZE);
+    vars_t *vars = init_vars();
+    char line[LINE_SIZE];
+    char name[64];
+
+    for (size_t i = 0; i < sizeof(word_counts) / sizeof(word_counts[0]); i++) {
+        build_line(line, word_counts[i], 0);
+        sprintf(name, "parse/%d words", word_counts[i]);
+        bench_parse(name, line, arena, vars);
+
+        build_line(line, word_counts[i], 1);
+        sprintf(name, "parse/%d words quoted+redir", word_counts[i]);
+        bench_parse(name, line, arena, vars);
+    }
+
+    // one expansion that fits in place and one that has to move to the arena
+    set_var(vars, "D", 1, "/tmp", 4);
+    set_var(vars, "LONG", 4, "/usr/local/share/applications", 29);
+    bench_parse("parse/expansions",
+                "/bin/ls -l $D/a ${D}/b \"$LONG/c\" $? x$LONG/y", arena, vars);
+    bench_parse("parse/4-stage pipeline",
+                "/bin/cat < in.txt | /bin/grep -v 'x y' | /bin/sort -r | "
+                "/usr/bin/uniq -c > out.txt &",
+                arena, vars);
+
+    cleanup_vars(vars);
+    cleanup_arena(arena);
+}
+
+/*
+ * times get_job_jid(), remove_job_pid() and add_job() on a table of n jobs,
+ * jobs are removed and added back in batches so the table keeps its size
+ */
+static void bench_job_table(int n) {
+    job_list_t *jobs = init_job_list();
+    pid_t *pids = (pid_t *)malloc((size_t)n * sizeof(pid_t));
+    uint64_t state = 0x2545f4914f6cdd1d;
+    double lookup_runs[RUNS];
+    double remove_runs[RUNS];
+    double add_runs[RUNS];
+    char name[64];
+    int batch = n < JOB_BATCH ? n : JOB_BATCH;
+
+    for (int i = 0; i < n; i++) {
+        pids[i] = PID_BASE + i;
+        add_job(jobs, i + 1, pids[i], RUNNING, "/bin/sleep 100");
+    }
+
+    for (int r = 0; r < RUNS; r++) {
+        shuffle(pids, n, &state);
+        int found = 0;
+        uint64_t start = now_ns();
+        for (int i = 0; i < JOB_OPS; i++) {
+            found += get_job_jid(jobs, pids[i % n]) > 0;
+        }
+        lookup_runs[r] = (double)(now_ns() - start) / JOB_OPS;
+        if (found != JOB_OPS) {
+            fprintf(stderr, "get_job_jid: missing jobs\n");
+            exit(1);
+        }
+
+        uint64_t remove_ns = 0;
+        uint64_t add_ns = 0;
+        for (int done = 0; done < JOB_OPS; done += batch) {
+            shuffle(pids, n, &state);
+            start = now_ns();
+            for (int i = 0; i < batch; i++) {
+                remove_job_pid(jobs, pids[i]);
+            }
+            uint64_t middle = now_ns();
+            // a job gets the lowest free JID, like the shell does it
+            for (int i = 0; i < batch; i++) {
+                add_job(jobs, get_next_jid(jobs), pids[i], RUNNING,
+                        "/bin/sleep 100");
+            }
+            remove_ns += middle - start;
+            add_ns += now_ns() - middle;
+        }
+        int ops = (JOB_OPS + batch - 1) / batch * batch;
+        remove_runs[r] = (double)remove_ns / ops;
+        add_runs[r] = (double)add_ns / ops;
+    }
+
+    sprintf(name, "jobs/%d get_job_jid", n);
+    report(name, lookup_runs);
+    sprintf(name, "jobs/%d remove_job_pid", n);
+    report(name, remove_runs);
+    sprintf(name, "jobs/%d add_job", n);
+    report(name, add_runs);
+
+    // the PIDs are made up, so the jobs are removed before cleanup_job_list()
+    // could send them a SIGKILL
+    for (int i = 0; i < n; i++) {
+        remove_job_pid(jobs, pids[i]);
+    }
+    cleanup_job_list(jobs);
+    free(pids);
+}
+
+/*
+ * times keeping the environment of n exported variables up to date, setting
+ * one of them, unsetting and exporting one again, and building the
+ * environment of a command with an assignment before it
+ */
+static void bench_env(int n) {
+    vars_t *vars = init_vars();
+    arena_t *arena = init_arena(ARENA_SIZE);
+    double set_runs[RUNS];
+    double unset_runs[RUNS];
+    double overlay_runs[RUNS];
+    char *overrides[] = {"V0=override", "NEW=1"};
+    char name[64];
+    uint64_t state = 0x2545f4914f6cdd1d;
+
+    for (int i = 0; i < n; i++) {
+        int len = sprintf(name, "V%d", i);
+        set_var(vars, name, (size_t)len, "/usr/local/bin", 14);
+        export_var(vars, name, (size_t)len);
+    }
+
+    for (int r = 0; r < RUNS; r++) {
+        uint64_t start = now_ns();
+        for (int i = 0; i < ENV_OPS; i++) {
+            int len = sprintf(name, "V%d", (int)(next_random(&state) % (uint64_t)n));
+            set_var(vars, name, (size_t)len, "/usr/bin", 8);
+        }
+        set_runs[r] = (double)(now_ns() - start) / ENV_OPS;
+
+        start = now_ns();
+        for (int i = 0; i < ENV_OPS; i++) {
+            int len = sprintf(name, "V%d", (int)(next_random(&state) % (uint64_t)n));
+            unset_var(vars, name, (size_t)len);
+            set_var(vars, name, (size_t)len, "/usr/bin", 8);
+            export_var(vars, name, (size_t)len);
+        }
+        unset_runs[r] = (double)(now_ns() - start) / ENV_OPS;
+
+        start = now_ns();
+        for (int i = 0; i < ENV_OPS; i++) {
+            overlay_envp(vars, arena, overrides, 2);
+            reset_arena(arena);
+        }
+        overlay_runs[r] = (double)(now_ns() - start) / ENV_OPS;
+    }
+
+    sprintf(name, "env/%d set exported", n);
+    report(name, set_runs);
+    sprintf(name, "env/%d unset+export", n);
+    report(name, unset_runs);
+    sprintf(name, "env/%d overlay_envp", n);
+    report(name, overlay_runs);
+
+    cleanup_arena(arena);
+    cleanup_vars(vars);
+}
+
+/* finds the newest entry with the needle by looking at every entry */
+static long scan_history(history_t *history, const char *needle, int prefix) {
+    size_t needle_len = strlen(needle);
+    size_t len;
+    for (size_t i = history_len(history); i-- > 0;) {
+        const char *line = get_history(history, i, &len);
+        if (prefix ? len > needle_len && !memcmp(line, needle, needle_len)
+                   : memmem(line, len, needle, needle_len) != NULL) {
+            return (long)i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * times searching a history, the first search indexes every entry, each
+ * search is checked against a scan of every entry first
+ */
+static void bench_history_search(const char *path) {
+    history_t *history = init_history(path);
+    history_search_t *search = init_history_search(history);
+    double runs[RUNS];
+    size_t total = history_len(history);
+
+    uint64_t start = now_ns();
+    search_history(search, "x", 1, 0);
+    printf("%-32s %12.1f\n", "history/1M search index build",
+           (double)(now_ns() - start));
+
+    for (size_t i = 0; i < sizeof(searches) / sizeof(searches[0]); i++) {
+        const char *needle = searches[i].needle;
+        size_t len = strlen(needle);
+        long expected = scan_history(history, needle, searches[i].prefix);
+        long found = searches[i].prefix
+                         ? search_history_prefix(search, needle, len, total)
+                         : search_history(search, needle, len, total);
+        if (found != expected) {
+            fprintf(stderr, "%s: found %ld, not %ld\n", searches[i].name, found,
+                    expected);
+            exit(1);
+        }
+
+        for (int r = 0; r < RUNS; r++) {
+            start = now_ns();
+            for (int j = 0; j < SEARCH_OPS; j++) {
+                if (searches[i].prefix) {
+                    search_history_prefix(search, needle, len, total);
+                } else {
+                    search_history(search, needle, len, total);
+                }
+            }
+            runs[r] = (double)(now_ns() - start) / SEARCH_OPS;
+        }
+        report(searches[i].name, runs);
+    }
+
+    cleanup_history_search(search);
+    cleanup_history(history);
+}
+
+/*
+ * times opening a history file of HISTORY_ENTRIES lines, which only maps it
+ * and its index, looking entries up at random and appending lines
+ */
+static void bench_history() {
+    char dir[] = "/tmp/33bench.XXXXXX";
+    char path[64];
+    char index_path[64];
+    double open_runs[RUNS];
+    double lookup_runs[RUNS];
+    double add_runs[RUNS];
+    uint64_t state = 0x2545f4914f6cdd1d;
+
+    if (mkdtemp(dir) == NULL) {
+        perror("mkdtemp");
+        exit(1);
+    }
+    sprintf(path, "%s/history", dir);
+    sprintf(index_path, "%s/history.idx", dir);
+    FILE *file = fopen(path, "w");
+    for (int i = 0; i < HISTORY_ENTRIES; i++) {
+        fprintf(file, "/bin/cat /tmp/file%d | /bin/grep -v pattern%d\n", i, i % 97);
+    }
+    fclose(file);
+
+    // the first open writes the index
+    uint64_t start = now_ns();
+    cleanup_history(init_history(path));
+    printf("%-32s %12.1f\n", "history/1M index rebuild", (double)(now_ns() - start));
+
+    for (int r = 0; r < RUNS; r++) {
+        start = now_ns();
+        history_t *history = init_history(path);
+        open_runs[r] = (double)(now_ns() - start);
+        if (history == NULL || history_len(history) < HISTORY_ENTRIES) {
+            fprintf(stderr, "init_history: entries missing\n");
+            exit(1);
+        }
+
+        size_t total = 0;
+        size_t len;
+        start = now_ns();
+        for (int i = 0; i < HISTORY_OPS; i++) {
+            size_t entry = next_random(&state) % history_len(history);
+            total += get_history(history, entry, &len) != NULL ? len : 0;
+        }
+        lookup_runs[r] = (double)(now_ns() - start) / HISTORY_OPS;
+        if (total == 0) {
+            fprintf(stderr, "get_history: no entries\n");
+            exit(1);
+        }
+
+        start = now_ns();
+        for (int i = 0; i < HISTORY_ADDS; i++) {
+            add_history(history, "/bin/echo appended", 18);
+        }
+        add_runs[r] = (double)(now_ns() - start) / HISTORY_ADDS;
+        cleanup_history(history);
+    }
+
+    report("history/1M init_history", open_runs);
+    report("history/1M get_history", lookup_runs);
+    report("history/1M add_history", add_runs);
+    bench_history_search(path);
+
+    unlink(path);
+    unlink(index_path);
+    rmdir(dir);
+}
+
+/*
+ * times tab completion in a directory of COMPLETION_FILES files: reading it
+ * the first time, completing a prefix that ten files have once it is cached,
+ * and completing after a file was created, which reads only its event
+ */
+static void bench_completion() {
+    char dir[] = "/tmp/33bench.XXXXXX";
+    char path[64];
+    char prefix[64];
+    double cached_runs[RUNS];
+    double update_runs[RUNS];
+    int added = 0;
+
+    if (mkdtemp(dir) == NULL) {
+        perror("mkdtemp");
+        exit(1);
+    }
+    for (int i = 0; i < COMPLETION_FILES; i++) {
+        sprintf(path, "%s/file%06d", dir, i);
+        close(open(path, O_CREAT | O_WRONLY, 0644));
+    }
+    completion_t *completion = init_completion();
+    matches_t *matches = init_matches();
+    int prefix_len = sprintf(prefix, "%s/file01234", dir);
+
+    uint64_t start = now_ns();
+    complete_path(completion, prefix, (size_t)prefix_len, 0, matches);
+    printf("%-32s %12.1f\n", "completion/100k first read", (double)(now_ns() - start));
+    if (num_matches(matches) != 10) {
+        fprintf(stderr, "complete_path: %zu matches\n", num_matches(matches));
+        exit(1);
+    }
+
+    for (int r = 0; r < RUNS; r++) {
+        start = now_ns();
+        for (int i = 0; i < COMPLETION_OPS; i++) {
+            clear_matches(matches);
+            complete_path(completion, prefix, (size_t)prefix_len, 0, matches);
+        }
+        cached_runs[r] = (double)(now_ns() - start) / COMPLETION_OPS;
+
+        // the file is only timed being picked up, not being created
+        double total = 0;
+        for (int i = 0; i < COMPLETION_ADDS; i++, added++) {
+            sprintf(path, "%s/new%06d", dir, added);
+            close(open(path, O_CREAT | O_WRONLY, 0644));
+            clear_matches(matches);
+            start = now_ns();
+            complete_path(completion, path, strlen(path), 0, matches);
+            total += (double)(now_ns() - start);
+            if (num_matches(matches) != 1) {
+                fprintf(stderr, "complete_path: %s not found\n", path);
+                exit(1);
+            }
+        }
+        update_runs[r] = total / COMPLETION_ADDS;
+    }
+    report("completion/100k cached", cached_runs);
+    report("completion/100k after create", update_runs);
+
+    cleanup_matches(matches);
+    cleanup_completion(completion);
+    for (int i = 0; i < COMPLETION_FILES; i++) {
+        sprintf(path, "%s/file%06d", dir, i);
+        unlink(path);
+    }
+    for (int i = 0; i < added; i++) {
+        sprintf(path, "%s/new%06d", dir, i);
+        unlink(path);
+    }
+    rmdir(dir);
+}
+
+/*
+ * times pathname expansion in a directory of GLOB_FILES files: reading it the
+ * first time, expanding a pattern that ten files match and one that all of
+ * them match once its listing is cached, and parsing a line that globs all
+ * of them, which builds the whole argument list
+ */
+static void bench_glob() {
+    char dir[] = "/tmp/33bench.XXXXXX";
+    char path[64];
+    char narrow[64];
+    char wide[64];
+    char line[96];
+    char **paths;
+    double narrow_runs[RUNS];
+    double wide_runs[RUNS];
+    double parse_runs[RUNS];
+
+    if (mkdtemp(dir) == NULL) {
+        perror("mkdtemp");
+        exit(1);
+    }
+    for (int i = 0; i < GLOB_FILES; i++) {
+        sprintf(path, "%s/file%06d.c", dir, i);
+        close(open(path, O_CREAT | O_WRONLY, 0644));
+    }
+    pathexp_t *pathexp = init_pathexp();
+    arena_t *arena = init_arena(ARENA_SIZE);
+    vars_t *vars = init_vars();
+    sprintf(narrow, "%s/file01234?.c", dir);
+    sprintf(wide, "%s/*.c", dir);
+
+    // the listing isn't trusted while the files were just created
+    sleep(1);
+    uint64_t start = now_ns();
+    size_t num = expand_pattern(pathexp, narrow, arena, &paths);
+    printf("%-32s %12.1f\n", "glob/100k first read", (double)(now_ns() - start));
+    if (num != 10) {
+        fprintf(stderr, "expand_pattern: %zu paths\n", num);
+        exit(1);
+    }
+
+    for (int r = 0; r < RUNS; r++) {
+        start = now_ns();
+        for (int i = 0; i < GLOB_OPS; i++) {
+            reset_arena(arena);
+            expand_pattern(pathexp, narrow, arena, &paths);
+        }
+        narrow_runs[r] = (double)(now_ns() - start) / GLOB_OPS;
+
+        reset_arena(arena);
+        start = now_ns();
+        num = expand_pattern(pathexp, wide, arena, &paths);
+        wide_runs[r] = (double)(now_ns() - start);
+        if (num != GLOB_FILES) {
+            fprintf(stderr, "expand_pattern: %zu paths\n", num);
+            exit(1);
+        }
+
+        pipeline_t pipeline;
+        reset_arena(arena);
+        sprintf(line, "/bin/echo %s", wide);
+        start = now_ns();
+        if (parse(line, arena, vars, pathexp, NULL, &pipeline) != 0 ||
+            pipeline.commands[0].counter != GLOB_FILES + 1) {
+            fprintf(stderr, "parse: glob not expanded\n");
+            exit(1);
+        }
+        parse_runs[r] = (double)(now_ns() - start);
+    }
+    report("glob/100k cached, 10 match", narrow_runs);
+    report("glob/100k cached, all match", wide_runs);
+    report("glob/100k parse echo *", parse_runs);
+
+    cleanup_vars(vars);
+    cleanup_arena(arena);
+    cleanup_pathexp(pathexp);
+    for (int i = 0; i < GLOB_FILES; i++) {
+        sprintf(path, "%s/file%06d.c", dir, i);
+        unlink(path);
+    }
+    rmdir(dir);
+}
+
+/*
+ * creates WALK_FANOUT directories in dir, each with WALK_FANOUT of its
+ * own, with WALK_FILES files in every one of those
+ */
+static void build_tree(const char *dir) {
+    char path[128];
+    for (int i = 0; i < WALK_FANOUT; i++) {
+        sprintf(path, "%s/d%02d", dir, i);
+        mkdir(path, 0755);
+        for (int j = 0; j < WALK_FANOUT; j++) {
+            sprintf(path, "%s/d%02d/e%02d", dir, i, j);
+            mkdir(path, 0755);
+            for (int k = 0; k < WALK_FILES; k++) {
+                sprintf(path, "%s/d%02d/e%02d/f%03d.%c", dir, i, j, k, k % 2 ? 'c' : 'h');
+                close(open(path, O_CREAT | O_WRONLY, 0644));
+            }
+        }
+    }
+}
+
+/* removes what build_tree() created */
+static void remove_tree(const char *dir) {
+    char path[128];
+    for (int i = 0; i < WALK_FANOUT; i++) {
+        for (int j = 0; j < WALK_FANOUT; j++) {
+            for (int k = 0; k < WALK_FILES; k++) {
+                sprintf(path, "%s/d%02d/e%02d/f%03d.%c", dir, i, j, k, k % 2 ? 'c' : 'h');
+                unlink(path);
+            }
+            sprintf(path, "%s/d%02d/e%02d", dir, i, j);
+            rmdir(path);
+        }
+        sprintf(path, "%s/d%02d", dir, i);
+        rmdir(path);
+    }
+    rmdir(dir);
+}
+
+/*
+ * times walking a tree of WALK_FANOUT * WALK_FANOUT directories with
+ * WALK_FILES files each, on one thread and on one for every processor, and
+ * expanding a ** pattern that half of the files match
+ */
+static void bench_walk() {
+    char dir[] = "/tmp/33bench.XXXXXX";
+    char pattern[64];
+    char **paths;
+    double one_runs[RUNS];
+    double all_runs[RUNS];
+    double glob_runs[RUNS];
+    size_t files = WALK_FANOUT * WALK_FANOUT * WALK_FILES;
+    size_t entries = WALK_FANOUT + WALK_FANOUT * WALK_FANOUT + files;
+
+    if (mkdtemp(dir) == NULL) {
+        perror("mkdtemp");
+        exit(1);
+    }
+    build_tree(dir);
+    pathexp_t *pathexp = init_pathexp();
+    arena_t *arena = init_arena(ARENA_SIZE);
+    sprintf(pattern, "%s/**/*.c", dir);
+
+    walk_t walk;
+    memset(&walk, 0, sizeof(walk));
+    walk.types = WALK_ANY;
+    walk.min_depth = 1;
+    walk.max_depth = -1;
+    for (int r = 0; r < RUNS; r++) {
+        walk.threads = 1;
+        uint64_t start = now_ns();
+        ssize_t num = walk_tree(dir, &walk, &paths);
+        one_runs[r] = (double)(now_ns() - start);
+        free(paths);
+
+        walk.threads = 0;
+        start = now_ns();
+        ssize_t num_all = walk_tree(dir, &walk, &paths);
+        all_runs[r] = (double)(now_ns() - start);
+        free(paths);
+        if (num != (ssize_t)entries || num_all != (ssize_t)entries) {
+            fprintf(stderr, "walk_tree: %zd and %zd paths\n", num, num_all);
+            exit(1);
+        }
+
+        reset_arena(arena);
+        start = now_ns();
+        size_t num_glob = expand_pattern(pathexp, pattern, arena, &paths);
+        glob_runs[r] = (double)(now_ns() - start);
+        if (num_glob != files / 2) {
+            fprintf(stderr, "expand_pattern: %zu paths\n", num_glob);
+            exit(1);
+        }
+    }
+    report("walk/16k one thread", one_runs);
+    report("walk/16k all processors", all_runs);
+    report("walk/16k glob **/*.c", glob_runs);
+
+    cleanup_arena(arena);
+    cleanup_pathexp(pathexp);
+    remove_tree(dir);
+}
+
+int main() {
+    printf("%-32s %12s %10s %12s\n", "benchmark", "ns/op", "stddev", "min");
+    bench_parser();
+    for (size_t i = 0; i < sizeof(job_counts) / sizeof(job_counts[0]); i++) {
+        bench_job_table(job_counts[i]);
+    }
+    for (size_t i = 0; i < sizeof(env_counts) / sizeof(env_counts[0]); i++) {
+        bench_env(env_counts[i]);
+    }
+    bench_history();
+    bench_completion();
+    bench_glob();
+    bench_walk();
+    return 0;
+}
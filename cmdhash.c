@@ -0,0 +1,385 @@
+#include "./cmdhash.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define INITIAL_BUCKETS 64
+#define DEFAULT_PATH "/usr/local/bin:/usr/bin:/bin"
+
+// one directory of PATH, generation goes up every time its mtime changes
+struct path_dir {
+    char *path;
+    int fd;  // O_PATH handle of the directory, -1 if it doesn't exist
+    int relative;  // doesn't start with /, so it moves with the working directory
+    struct timespec mtime;
+    unsigned long generation;
+};
+
+// a remembered command, path is NULL if it wasn't found anywhere in PATH
+struct cmd_entry {
+    char *name;
+    char *path;
+    int dir;  // index of the directory it was found in
+    int fd;   // O_PATH handle of the executable, -1 if not kept
+    unsigned long generation;
+    int hits;
+};
+typedef struct cmd_entry cmd_entry_t;
+
+// buckets is an open addressing table, entries are never removed one by one
+// so there are no tombstones, clear_cmd_hash() empties the whole table
+struct cmd_hash {
+    cmd_entry_t **buckets;
+    size_t num_buckets;
+    size_t num_entries;
+    struct path_dir *dirs;
+    int num_dirs;
+    char *path_var;               // PATH value that dirs was built from
+    int first_relative;           // index of the first relative directory, num_dirs if none
+    unsigned long generation;     // goes up when any directory changes
+    int keep_fds;
+};
+
+/* FNV-1a hash of a command name */
+static size_t hash_name(const char *name) {
+    uint64_t hash = 14695981039346656037ULL;
+    while (*name) {
+        hash ^= (unsigned char)*name++;
+        hash *= 1099511628211ULL;
+    }
+    return (size_t)hash;
+}
+
+/* frees a single entry and closes its handle */
+static void free_entry(cmd_entry_t *entry) {
+    if (entry->fd >= 0) {
+        close(entry->fd);
+    }
+    free(entry->name);
+    free(entry->path);
+    free(entry);
+}
+
+/* closes and frees the PATH directories */
+static void free_dirs(cmd_hash_t *cmd_hash) {
+    for (int i = 0; i < cmd_hash->num_dirs; i++) {
+        if (cmd_hash->dirs[i].fd >= 0) {
+            close(cmd_hash->dirs[i].fd);
+        }
+        free(cmd_hash->dirs[i].path);
+    }
+    free(cmd_hash->dirs);
+    cmd_hash->dirs = NULL;
+    cmd_hash->num_dirs = 0;
+    cmd_hash->first_relative = 0;
+}
+
+/*
+ * opens a directory of PATH and records its mtime, a relative directory is
+ * never opened, since a handle would keep pointing into the old working
+ * directory after a cd
+ */
+static void open_dir(struct path_dir *dir) {
+    struct stat st;
+    if (dir->relative) {
+        dir->fd = -1;
+        return;
+    }
+    dir->fd = open(dir->path, O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (dir->fd >= 0 && fstat(dir->fd, &st) == 0) {
+        dir->mtime = st.st_mtim;
+    } else {
+        memset(&dir->mtime, 0, sizeof(dir->mtime));
+    }
+}
+
+/*
+ * splits PATH into directories if it changed since the last lookup,
+ * forgetting every command that was resolved with the old PATH
+ */
+static void sync_path(cmd_hash_t *cmd_hash) {
+    const char *path_var = getenv("PATH");
+    if (path_var == NULL) {
+        path_var = DEFAULT_PATH;
+    }
+    if (cmd_hash->path_var != NULL && !strcmp(cmd_hash->path_var, path_var)) {
+        return;
+    }
+
+    clear_cmd_hash(cmd_hash);
+    free_dirs(cmd_hash);
+    free(cmd_hash->path_var);
+    cmd_hash->path_var = strdup(path_var);
+
+    int count = 1;
+    for (const char *c = path_var; *c; c++) {
+        if (*c == ':') {
+            count++;
+        }
+    }
+    cmd_hash->dirs =
+        (struct path_dir *)calloc((size_t)count, sizeof(struct path_dir));
+
+    cmd_hash->first_relative = count;
+    const char *start = path_var;
+    for (int i = 0; i < count; i++) {
+        const char *end = strchr(start, ':');
+        size_t len = end == NULL ? strlen(start) : (size_t)(end - start);
+        struct path_dir *dir = &cmd_hash->dirs[i];
+
+        // an empty entry in PATH means the current directory
+        dir->path = len == 0 ? strdup(".") : strndup(start, len);
+        dir->relative = dir->path[0] != '/';
+        dir->generation = 0;
+        open_dir(dir);
+        if (dir->relative && i < cmd_hash->first_relative) {
+            cmd_hash->first_relative = i;
+        }
+        start = end == NULL ? start + len : end + 1;
+    }
+    cmd_hash->num_dirs = count;
+}
+
+/*
+ * checks whether a directory changed since it was last looked at, bumping its
+ * generation if it did, returns the directory's generation
+ */
+static unsigned long check_dir(cmd_hash_t *cmd_hash, int index) {
+    struct path_dir *dir = &cmd_hash->dirs[index];
+    struct stat st;
+    int changed;
+
+    if (dir->relative) {
+        return dir->generation;
+    } else if (dir->fd < 0) {
+        // the directory may have been created since
+        open_dir(dir);
+        changed = dir->fd >= 0;
+    } else if (fstat(dir->fd, &st) != 0) {
+        changed = 1;
+    } else {
+        changed = st.st_mtim.tv_sec != dir->mtime.tv_sec ||
+                  st.st_mtim.tv_nsec != dir->mtime.tv_nsec;
+        dir->mtime = st.st_mtim;
+    }
+
+    if (changed) {
+        dir->generation++;
+        cmd_hash->generation++;
+    }
+    return dir->generation;
+}
+
+/*
+ * walks PATH to find the command, filling in the entry's path, directory and
+ * handle, the entry is left negative if no directory has it
+ */
+static void resolve_entry(cmd_hash_t *cmd_hash, cmd_entry_t *entry) {
+    struct stat st;
+
+    if (entry->fd >= 0) {
+        close(entry->fd);
+        entry->fd = -1;
+    }
+    free(entry->path);
+    entry->path = NULL;
+    entry->dir = -1;
+
+    size_t name_len = strlen(entry->name);
+    for (int i = 0; i < cmd_hash->num_dirs; i++) {
+        struct path_dir *dir = &cmd_hash->dirs[i];
+        if (dir->fd < 0 && !dir->relative) {
+            continue;
+        }
+
+        size_t dir_len = strlen(dir->path);
+        char *path = (char *)malloc(dir_len + name_len + 2);
+        memcpy(path, dir->path, dir_len);
+        path[dir_len] = '/';
+        memcpy(path + dir_len + 1, entry->name, name_len + 1);
+
+        // a relative directory is looked in from wherever the shell is now
+        int at = dir->relative ? AT_FDCWD : dir->fd;
+        const char *file = dir->relative ? path : entry->name;
+        if (fstatat(at, file, &st, 0) != 0 || !S_ISREG(st.st_mode) ||
+            faccessat(at, file, X_OK, 0) != 0) {
+            free(path);
+            continue;
+        }
+
+        entry->path = path;
+        entry->dir = i;
+        entry->generation = dir->generation;
+
+        if (cmd_hash->keep_fds && !dir->relative) {
+            entry->fd = openat(dir->fd, entry->name, O_PATH | O_CLOEXEC);
+        }
+        return;
+    }
+    entry->generation = cmd_hash->generation;
+}
+
+/* doubles the number of buckets once the table is half full */
+static void grow_table(cmd_hash_t *cmd_hash) {
+    size_t old_size = cmd_hash->num_buckets;
+    cmd_entry_t **old = cmd_hash->buckets;
+
+    cmd_hash->num_buckets = old_size * 2;
+    cmd_hash->buckets =
+        (cmd_entry_t **)calloc(cmd_hash->num_buckets, sizeof(cmd_entry_t *));
+    for (size_t i = 0; i < old_size; i++) {
+        if (old[i] == NULL) {
+            continue;
+        }
+        size_t slot = hash_name(old[i]->name) & (cmd_hash->num_buckets - 1);
+        while (cmd_hash->buckets[slot] != NULL) {
+            slot = (slot + 1) & (cmd_hash->num_buckets - 1);
+        }
+        cmd_hash->buckets[slot] = old[i];
+    }
+    free(old);
+}
+
+/* initializes the command hash table, returns pointer */
+cmd_hash_t *init_cmd_hash() {
+    cmd_hash_t *cmd_hash = (cmd_hash_t *)malloc(sizeof(cmd_hash_t));
+    cmd_hash->num_buckets = INITIAL_BUCKETS;
+    cmd_hash->buckets =
+        (cmd_entry_t **)calloc(INITIAL_BUCKETS, sizeof(cmd_entry_t *));
+    cmd_hash->num_entries = 0;
+    cmd_hash->dirs = NULL;
+    cmd_hash->num_dirs = 0;
+    cmd_hash->first_relative = 0;
+    cmd_hash->path_var = NULL;
+    cmd_hash->generation = 0;
+    cmd_hash->keep_fds = 0;
+    return cmd_hash;
+}
+
+/*
+ * cleans up the command hash table and closes any executable handles
+ * Note: this function will free the cmd_hash pointer
+ * DO NOT use the pointer after this function is called
+ */
+void cleanup_cmd_hash(cmd_hash_t *cmd_hash) {
+    if (cmd_hash == NULL) {
+        return;
+    }
+    clear_cmd_hash(cmd_hash);
+    free_dirs(cmd_hash);
+    free(cmd_hash->buckets);
+    free(cmd_hash->path_var);
+    free(cmd_hash);
+}
+
+/*
+ * keeps an O_PATH handle open for every command that is found, if keep_fds is
+ * non-zero, so that it can be executed without resolving its path again
+ */
+void set_cmd_hash_fds(cmd_hash_t *cmd_hash, int keep_fds) {
+    if (cmd_hash->keep_fds != keep_fds) {
+        clear_cmd_hash(cmd_hash);
+        cmd_hash->keep_fds = keep_fds;
+    }
+}
+
+/*
+ * looks up a command name in PATH, using the hash table when possible
+ * returns the full path on success, NULL if the command is not in PATH
+ * fd is set to the command's O_PATH handle, or -1 if there is none
+ */
+char *lookup_command(cmd_hash_t *cmd_hash, const char *name, int *fd) {
+    *fd = -1;
+    if (cmd_hash == NULL || name == NULL || *name == '\0') {
+        return NULL;
+    }
+    sync_path(cmd_hash);
+
+    size_t mask = cmd_hash->num_buckets - 1;
+    size_t slot = hash_name(name) & mask;
+    cmd_entry_t *entry;
+    while ((entry = cmd_hash->buckets[slot]) != NULL) {
+        if (!strcmp(entry->name, name)) {
+            break;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    if (entry == NULL) {
+        entry = (cmd_entry_t *)malloc(sizeof(cmd_entry_t));
+        entry->name = strdup(name);
+        entry->path = NULL;
+        entry->fd = -1;
+        entry->hits = 0;
+        resolve_entry(cmd_hash, entry);
+
+        cmd_hash->buckets[slot] = entry;
+        cmd_hash->num_entries++;
+        if (cmd_hash->num_entries * 2 > cmd_hash->num_buckets) {
+            grow_table(cmd_hash);
+        }
+    } else if (entry->path == NULL ? cmd_hash->first_relative < cmd_hash->num_dirs
+                                   : entry->dir >= cmd_hash->first_relative) {
+        // a relative directory of PATH may have a different command after every
+        // cd, so nothing it could have shadowed or found is trusted
+        resolve_entry(cmd_hash, entry);
+    } else if (entry->path != NULL) {
+        // found commands only go stale when their own directory changes
+        if (check_dir(cmd_hash, entry->dir) != entry->generation) {
+            resolve_entry(cmd_hash, entry);
+        }
+    } else {
+        // missing commands go stale when any directory changes
+        for (int i = 0; i < cmd_hash->num_dirs; i++) {
+            check_dir(cmd_hash, i);
+        }
+        if (cmd_hash->generation != entry->generation) {
+            resolve_entry(cmd_hash, entry);
+        }
+    }
+
+    if (entry->path == NULL) {
+        return NULL;
+    }
+    entry->hits++;
+    *fd = entry->fd;
+    return entry->path;
+}
+
+/* forgets every command, the next lookups search PATH again */
+void clear_cmd_hash(cmd_hash_t *cmd_hash) {
+    if (cmd_hash == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < cmd_hash->num_buckets; i++) {
+        if (cmd_hash->buckets[i] != NULL) {
+            free_entry(cmd_hash->buckets[i]);
+            cmd_hash->buckets[i] = NULL;
+        }
+    }
+    cmd_hash->num_entries = 0;
+}
+
+/* hash command, prints out the remembered commands and their hit counts */
+void print_cmd_hash(cmd_hash_t *cmd_hash) {
+    if (cmd_hash == NULL) {
+        return;
+    }
+    if (cmd_hash->num_entries == 0) {
+        printf("hash: hash table empty\n");
+        return;
+    }
+
+    printf("hits\tcommand\n");
+    for (size_t i = 0; i < cmd_hash->num_buckets; i++) {
+        cmd_entry_t *entry = cmd_hash->buckets[i];
+        // negative entries are only there to fail fast, don't list them
+        if (entry != NULL && entry->path != NULL) {
+            printf("%4d\t%s\n", entry->hits, entry->path);
+        }
+    }
+}
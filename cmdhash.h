@@ -0,0 +1,34 @@
+#ifndef CMDHASH_H_
+#define CMDHASH_H_
+
+typedef struct cmd_hash cmd_hash_t;
+
+/* initializes the command hash table, returns pointer */
+cmd_hash_t *init_cmd_hash();
+/*
+ * cleans up the command hash table and closes any executable handles
+ * Note: this function will free the cmd_hash pointer
+ * DO NOT use the pointer after this function is called
+ */
+void cleanup_cmd_hash(cmd_hash_t *cmd_hash);
+
+/*
+ * keeps an O_PATH handle open for every command that is found, if keep_fds is
+ * non-zero, so that it can be executed without resolving its path again
+ */
+void set_cmd_hash_fds(cmd_hash_t *cmd_hash, int keep_fds);
+
+/*
+ * looks up a command name in PATH, using the hash table when possible
+ * returns the full path on success, NULL if the command is not in PATH
+ * fd is set to the command's O_PATH handle, or -1 if there is none
+ */
+char *lookup_command(cmd_hash_t *cmd_hash, const char *name, int *fd);
+
+/* forgets every command, the next lookups search PATH again */
+void clear_cmd_hash(cmd_hash_t *cmd_hash);
+
+/* hash command, prints out the remembered commands and their hit counts */
+void print_cmd_hash(cmd_hash_t *cmd_hash);
+
+#endif  // CMDHASH_H_
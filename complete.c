@@ -0,0 +1,654 @@
+#include "./complete.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "./arena.h"
+
+#define DEFAULT_PATH "/usr/local/bin:/usr/bin:/bin"
+#define MAX_VISITED 32     // directories outside PATH that are kept
+#define INITIAL_DIRS 16
+#define NAMES_SIZE 4096    // first block of the arena of a directory's trie
+#define EVENTS_SIZE 4096   // bytes of inotify events read at once
+#define INITIAL_MATCHES 64
+#define MATCHES_SIZE 4096  // first block of the arena of the matches
+#define WATCH_EVENTS (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB)
+
+// what a name in a directory is, 0 if the directory doesn't have it
+#define NAME_FILE 1
+#define NAME_DIR 2
+#define NAME_EXEC 4  // only known for the directories of PATH
+
+// a node of the radix trie of the names in a directory, the labels on the way
+// from the root spell the name that ends at a node, nodes are never freed one
+// by one, a name that goes away only has its kind cleared
+typedef struct trie_node {
+    const char *label;
+    size_t label_len;
+    struct trie_node *child;  // first child, children are sorted by label
+    struct trie_node *next;   // next sibling
+    int kind;                 // the name that ends here, 0 if none does
+} trie_node_t;
+
+// a directory that has been read, its trie is kept up to date from its inotify
+// watch, or read again when its mtime changes if it couldn't be watched
+typedef struct dir_cache {
+    dev_t dev;
+    ino_t ino;
+    int fd;  // the directory, open for reading
+    int wd;  // its inotify watch, -1 if it has none
+    struct timespec mtime;  // as of the last read
+    int stale;     // non-zero if its names have to be read again
+    int execs;     // non-zero if executables were looked for in the last read
+    int in_path;   // non-zero for a directory of PATH, which is never dropped
+    unsigned long used;  // when it was last completed in
+    arena_t *arena;      // the nodes and labels of the trie
+    trie_node_t root;
+} dir_cache_t;
+
+// directories are read the first time a completion needs them, and after
+// that only the events of their watches are read, so a completion never reads
+// a whole directory again unless the kernel dropped its events
+struct completion {
+    int inotify_fd;  // -1 if there is no inotify
+    dir_cache_t **dirs;
+    size_t num_dirs;
+    size_t max_dirs;
+    char *path_var;  // PATH value that path_dirs was built from
+    dir_cache_t **path_dirs;  // NULL for directories that can't be read
+    size_t num_path_dirs;
+    int path_relative;  // non-zero if a directory of PATH doesn't start with a /
+    unsigned long clock;
+};
+
+struct match {
+    const char *word;
+    size_t len;
+};
+
+// the words are copied into the arena, which is reset when the list is cleared
+struct matches {
+    struct match *list;
+    size_t num;
+    size_t max;
+    arena_t *arena;
+};
+
+// the names of a trie being added to the matches, word is the directory part
+// of the completion followed by the name being put together
+typedef struct search {
+    dir_cache_t *dir;
+    matches_t *matches;
+    char word[PATH_MAX + NAME_MAX + 2];
+    size_t base;      // where the name starts in word
+    int commands;     // non-zero to add only executables, without a /
+    int executables;  // non-zero to add only directories and executables
+    int hidden;       // non-zero to add names that start with a . too
+} search_t;
+
+/*
+ * initializes the index that completions are found in, nothing is read until
+ * the first completion, returns pointer
+ */
+completion_t *init_completion() {
+    completion_t *completion = (completion_t *)calloc(1, sizeof(completion_t));
+    completion->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    return completion;
+}
+
+/* closes a directory and frees its trie */
+static void free_dir(dir_cache_t *dir) {
+    close(dir->fd);
+    cleanup_arena(dir->arena);
+    free(dir);
+}
+
+/*
+ * cleans up the index, closing its directories and its inotify instance
+ * Note: this function will free the completion pointer
+ * DO NOT use the pointer after this function is called
+ */
+void cleanup_completion(completion_t *completion) {
+    if (completion == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < completion->num_dirs; i++) {
+        free_dir(completion->dirs[i]);
+    }
+    if (completion->inotify_fd >= 0) {
+        close(completion->inotify_fd);
+    }
+    free(completion->dirs);
+    free(completion->path_dirs);
+    free(completion->path_var);
+    free(completion);
+}
+
+/* makes a node for a label, which isn't copied */
+static trie_node_t *new_node(arena_t *arena, const char *label, size_t len,
+                             int kind) {
+    trie_node_t *node = (trie_node_t *)arena_alloc(arena, sizeof(trie_node_t));
+    node->label = label;
+    node->label_len = len;
+    node->child = NULL;
+    node->next = NULL;
+    node->kind = kind;
+    return node;
+}
+
+/* sets what a name of a directory is, kind 0 removes it */
+static void set_name(dir_cache_t *dir, const char *name, size_t len, int kind) {
+    trie_node_t *node = &dir->root;
+
+    while (len > 0) {
+        trie_node_t **link = &node->child;
+        while (*link != NULL && (unsigned char)(*link)->label[0] < (unsigned char)name[0]) {
+            link = &(*link)->next;
+        }
+        trie_node_t *child = *link;
+        if (child == NULL || child->label[0] != name[0]) {
+            if (kind == 0) {
+                return;
+            }
+            char *label = (char *)arena_alloc(dir->arena, len);
+            memcpy(label, name, len);
+            trie_node_t *added = new_node(dir->arena, label, len, kind);
+            added->next = child;
+            *link = added;
+            return;
+        }
+
+        size_t common = 1;
+        while (common < child->label_len && common < len &&
+               child->label[common] == name[common]) {
+            common++;
+        }
+        if (common < child->label_len) {
+            if (kind == 0) {
+                return;
+            }
+            // the child splits where the name leaves its label
+            trie_node_t *rest = new_node(dir->arena, child->label + common,
+                                         child->label_len - common, child->kind);
+            rest->child = child->child;
+            child->child = rest;
+            child->label_len = common;
+            child->kind = 0;
+        }
+        node = child;
+        name += common;
+        len -= common;
+    }
+    node->kind = kind;
+}
+
+/*
+ * finds out what a name of a directory is, type is its d_type, DT_UNKNOWN if
+ * it isn't known, executables are only looked for in PATH
+ */
+static int classify(dir_cache_t *dir, const char *name, unsigned char type) {
+    struct stat st;
+    if (type == DT_UNKNOWN || type == DT_LNK) {
+        // a link that leads nowhere is still a name
+        if (fstatat(dir->fd, name, &st, 0) != 0) {
+            return NAME_FILE;
+        }
+        type = S_ISDIR(st.st_mode) ? DT_DIR : DT_REG;
+    }
+    if (type == DT_DIR) {
+        return NAME_DIR;
+    }
+    if (dir->in_path && faccessat(dir->fd, name, X_OK, 0) == 0) {
+        return NAME_FILE | NAME_EXEC;
+    }
+    return NAME_FILE;
+}
+
+/* reads every name of a directory into a new trie */
+static void read_dir(dir_cache_t *dir) {
+    struct stat st;
+    struct dirent *entry;
+
+    reset_arena(dir->arena);
+    memset(&dir->root, 0, sizeof(dir->root));
+    dir->stale = 0;
+    dir->execs = dir->in_path;
+    // the mtime goes first, so a change while reading is noticed next time
+    if (fstat(dir->fd, &st) == 0) {
+        dir->mtime = st.st_mtim;
+    }
+
+    int fd = dup(dir->fd);
+    DIR *stream = fd < 0 ? NULL : fdopendir(fd);
+    if (stream == NULL) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return;
+    }
+    rewinddir(stream);
+    while ((entry = readdir(stream)) != NULL) {
+        const char *name = entry->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+            continue;
+        }
+        set_name(dir, name, strlen(name), classify(dir, name, entry->d_type));
+    }
+    closedir(stream);
+}
+
+/* reads a directory again if it changed in a way its events didn't tell */
+static void update_dir(dir_cache_t *dir) {
+    struct stat st;
+    if (dir->wd < 0 && !dir->stale &&
+        (fstat(dir->fd, &st) != 0 || st.st_mtim.tv_sec != dir->mtime.tv_sec ||
+         st.st_mtim.tv_nsec != dir->mtime.tv_nsec)) {
+        dir->stale = 1;
+    }
+    if (dir->stale) {
+        read_dir(dir);
+    }
+}
+
+/* drops the directory outside PATH that was completed in least recently */
+static void drop_oldest(completion_t *completion) {
+    size_t oldest = completion->num_dirs;
+    size_t visited = 0;
+    for (size_t i = 0; i < completion->num_dirs; i++) {
+        dir_cache_t *dir = completion->dirs[i];
+        if (!dir->in_path) {
+            visited++;
+            if (oldest == completion->num_dirs ||
+                dir->used < completion->dirs[oldest]->used) {
+                oldest = i;
+            }
+        }
+    }
+    if (visited < MAX_VISITED) {
+        return;
+    }
+    dir_cache_t *dir = completion->dirs[oldest];
+    if (dir->wd >= 0) {
+        inotify_rm_watch(completion->inotify_fd, dir->wd);
+    }
+    free_dir(dir);
+    completion->dirs[oldest] = completion->dirs[--completion->num_dirs];
+}
+
+/*
+ * finds a directory, by its device and inode so that every path to it gets the
+ * same one, and starts watching it if it is new
+ * returns the directory, NULL if it can't be read
+ */
+static dir_cache_t *find_dir(completion_t *completion, const char *path) {
+    struct stat st;
+    int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+    for (size_t i = 0; i < completion->num_dirs; i++) {
+        dir_cache_t *dir = completion->dirs[i];
+        if (dir->dev == st.st_dev && dir->ino == st.st_ino) {
+            close(fd);
+            dir->used = ++completion->clock;
+            return dir;
+        }
+    }
+
+    drop_oldest(completion);
+    dir_cache_t *dir = (dir_cache_t *)calloc(1, sizeof(dir_cache_t));
+    dir->dev = st.st_dev;
+    dir->ino = st.st_ino;
+    dir->fd = fd;
+    dir->wd = completion->inotify_fd < 0
+                  ? -1
+                  : inotify_add_watch(completion->inotify_fd, path, WATCH_EVENTS);
+    dir->stale = 1;
+    dir->used = ++completion->clock;
+    dir->arena = init_arena(NAMES_SIZE);
+
+    if (completion->num_dirs == completion->max_dirs) {
+        completion->max_dirs =
+            completion->max_dirs == 0 ? INITIAL_DIRS : completion->max_dirs * 2;
+        completion->dirs = (dir_cache_t **)realloc(
+            completion->dirs, completion->max_dirs * sizeof(dir_cache_t *));
+    }
+    completion->dirs[completion->num_dirs++] = dir;
+    return dir;
+}
+
+/* applies an inotify event to the trie of the directory it is for */
+static void handle_event(completion_t *completion, const struct inotify_event *event) {
+    // events were dropped, so anything may have changed
+    if (event->mask & IN_Q_OVERFLOW) {
+        for (size_t i = 0; i < completion->num_dirs; i++) {
+            completion->dirs[i]->stale = 1;
+        }
+        return;
+    }
+
+    dir_cache_t *dir = NULL;
+    for (size_t i = 0; i < completion->num_dirs && dir == NULL; i++) {
+        if (completion->dirs[i]->wd == event->wd) {
+            dir = completion->dirs[i];
+        }
+    }
+    if (dir == NULL) {
+        return;
+    }
+    // the directory was removed, or its file system unmounted, its mtime is
+    // all that is left to go by
+    if (event->mask & IN_IGNORED) {
+        dir->wd = -1;
+        dir->stale = 1;
+        return;
+    }
+    if (event->len == 0 || dir->stale) {
+        return;
+    }
+
+    size_t len = strlen(event->name);
+    if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+        set_name(dir, event->name, len, 0);
+    } else {
+        set_name(dir, event->name, len, classify(dir, event->name, DT_UNKNOWN));
+    }
+}
+
+/* applies every event that came since the last completion */
+static void read_events(completion_t *completion) {
+    char buffer[EVENTS_SIZE]
+        __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t n;
+
+    if (completion->inotify_fd < 0) {
+        return;
+    }
+    while ((n = read(completion->inotify_fd, buffer, sizeof(buffer))) > 0) {
+        const char *at = buffer;
+        while (at < buffer + n) {
+            const struct inotify_event *event = (const struct inotify_event *)at;
+            handle_event(completion, event);
+            at += sizeof(struct inotify_event) + event->len;
+        }
+    }
+}
+
+/*
+ * finds the directories of PATH again if it changed since the last completion,
+ * or if any of them is relative, since that one follows the working directory
+ */
+static void sync_path(completion_t *completion) {
+    const char *path_var = getenv("PATH");
+    if (path_var == NULL) {
+        path_var = DEFAULT_PATH;
+    }
+    if (completion->path_var != NULL && !strcmp(completion->path_var, path_var) &&
+        !completion->path_relative) {
+        return;
+    }
+
+    // the old directories are only kept if they are visited
+    for (size_t i = 0; i < completion->num_path_dirs; i++) {
+        if (completion->path_dirs[i] != NULL) {
+            completion->path_dirs[i]->in_path = 0;
+        }
+    }
+    free(completion->path_var);
+    completion->path_var = strdup(path_var);
+
+    size_t count = 1;
+    for (const char *c = path_var; *c; c++) {
+        if (*c == ':') {
+            count++;
+        }
+    }
+    completion->path_dirs =
+        (dir_cache_t **)realloc(completion->path_dirs, count * sizeof(dir_cache_t *));
+    completion->num_path_dirs = count;
+    completion->path_relative = 0;
+
+    const char *start = path_var;
+    for (size_t i = 0; i < count; i++) {
+        const char *end = strchr(start, ':');
+        size_t len = end == NULL ? strlen(start) : (size_t)(end - start);
+        // an empty entry in PATH means the current directory
+        char *path = len == 0 ? strdup(".") : strndup(start, len);
+        completion->path_relative |= path[0] != '/';
+        dir_cache_t *dir = find_dir(completion, path);
+        free(path);
+
+        // a directory that is in PATH twice is only searched once
+        if (dir != NULL && dir->in_path) {
+            dir = NULL;
+        }
+        if (dir != NULL) {
+            dir->in_path = 1;
+            // it was read before it was in PATH, without its executables
+            if (!dir->execs) {
+                dir->stale = 1;
+            }
+        }
+        completion->path_dirs[i] = dir;
+        start = end == NULL ? start + len : end + 1;
+    }
+}
+
+/* adds the name that is in word, len bytes with its directory part, if it fits */
+static void add_name(search_t *search, size_t len, int kind) {
+    const char *name = search->word + search->base;
+    if (name[0] == '.' && !search->hidden) {
+        return;
+    }
+    if (search->commands) {
+        if ((kind & NAME_EXEC) && !(kind & NAME_DIR)) {
+            add_match(search->matches, search->word, len);
+        }
+        return;
+    }
+    if (kind & NAME_DIR) {
+        search->word[len] = '/';
+        add_match(search->matches, search->word, len + 1);
+        return;
+    }
+    if (search->executables) {
+        search->word[len] = '\0';
+        if (faccessat(search->dir->fd, name, X_OK, 0) != 0) {
+            return;
+        }
+    }
+    add_match(search->matches, search->word, len);
+}
+
+/* adds the name that ends at a node, whose label is in word, and every one below it */
+static void add_below(search_t *search, const trie_node_t *node, size_t len) {
+    if (node->kind != 0) {
+        add_name(search, len, node->kind);
+    }
+    for (const trie_node_t *child = node->child; child != NULL; child = child->next) {
+        if (len + child->label_len + 1 < sizeof(search->word)) {
+            memcpy(search->word + len, child->label, child->label_len);
+            add_below(search, child, len + child->label_len);
+        }
+    }
+}
+
+/* adds every name of the search's directory that starts with prefix */
+static void search_names(search_t *search, const char *prefix, size_t len) {
+    const trie_node_t *node = &search->dir->root;
+    size_t at = search->base;
+
+    while (len > 0) {
+        const trie_node_t *child = node->child;
+        while (child != NULL && child->label[0] != prefix[0]) {
+            child = child->next;
+        }
+        if (child == NULL) {
+            return;
+        }
+        size_t n = child->label_len < len ? child->label_len : len;
+        if (memcmp(child->label, prefix, n) != 0 ||
+            at + child->label_len + 1 >= sizeof(search->word)) {
+            return;
+        }
+        memcpy(search->word + at, child->label, child->label_len);
+        at += child->label_len;
+        prefix += n;
+        len -= n;
+        node = child;
+    }
+    add_below(search, node, at);
+}
+
+/* adds the executables in PATH whose names start with prefix to matches */
+void complete_command(completion_t *completion, const char *prefix, size_t len,
+                      matches_t *matches) {
+    search_t search;
+
+    read_events(completion);
+    sync_path(completion);
+    search.matches = matches;
+    search.base = 0;
+    search.commands = 1;
+    search.executables = 1;
+    search.hidden = len > 0 && prefix[0] == '.';
+    for (size_t i = 0; i < completion->num_path_dirs; i++) {
+        if (completion->path_dirs[i] != NULL) {
+            search.dir = completion->path_dirs[i];
+            update_dir(search.dir);
+            search_names(&search, prefix, len);
+        }
+    }
+}
+
+/*
+ * adds the paths that start with prefix to matches, directories end with a /,
+ * only directories and executables are added if executables is non-zero
+ */
+void complete_path(completion_t *completion, const char *prefix, size_t len,
+                   int executables, matches_t *matches) {
+    search_t search;
+
+    read_events(completion);
+    // the directory part of the prefix is where the names are looked for
+    const char *slash = (const char *)memrchr(prefix, '/', len);
+    search.base = slash == NULL ? 0 : (size_t)(slash - prefix) + 1;
+    if (search.base >= PATH_MAX) {
+        return;
+    }
+    memcpy(search.word, prefix, search.base);
+    search.word[search.base] = '\0';
+    search.dir = find_dir(completion, search.base == 0 ? "." : search.word);
+    if (search.dir == NULL) {
+        return;
+    }
+    update_dir(search.dir);
+
+    search.matches = matches;
+    search.commands = 0;
+    search.executables = executables;
+    search.hidden = search.base < len && prefix[search.base] == '.';
+    search_names(&search, prefix + search.base, len - search.base);
+}
+
+/* initializes an empty list of matches, returns pointer */
+matches_t *init_matches() {
+    matches_t *matches = (matches_t *)calloc(1, sizeof(matches_t));
+    matches->arena = init_arena(MATCHES_SIZE);
+    return matches;
+}
+
+/*
+ * cleans up the list of matches
+ * Note: this function will free the matches pointer
+ * DO NOT use the pointer after this function is called
+ */
+void cleanup_matches(matches_t *matches) {
+    cleanup_arena(matches->arena);
+    free(matches->list);
+    free(matches);
+}
+
+/* empties the list, the matches it had are no longer valid */
+void clear_matches(matches_t *matches) {
+    matches->num = 0;
+    reset_arena(matches->arena);
+}
+
+/* checks for the characters that the parser doesn't keep as they are */
+static int needs_escape(char c) {
+    switch (c) {
+        case ' ': case '\t': case '\n':
+        case '|': case '&': case '<': case '>':
+        case '\'': case '"': case '\\': case '$':
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/*
+ * adds a word to the list, with a backslash before every character the parser
+ * would take as something other than part of the word
+ */
+void add_match(matches_t *matches, const char *word, size_t len) {
+    size_t escaped = len;
+    for (size_t i = 0; i < len; i++) {
+        escaped += (size_t)needs_escape(word[i]);
+    }
+    char *copy = (char *)arena_alloc(matches->arena, escaped + 1);
+    size_t out = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (needs_escape(word[i])) {
+            copy[out++] = '\\';
+        }
+        copy[out++] = word[i];
+    }
+    copy[out] = '\0';
+
+    if (matches->num == matches->max) {
+        matches->max = matches->max == 0 ? INITIAL_MATCHES : matches->max * 2;
+        matches->list = (struct match *)realloc(
+            matches->list, matches->max * sizeof(struct match));
+    }
+    matches->list[matches->num].word = copy;
+    matches->list[matches->num].len = out;
+    matches->num++;
+}
+
+/* orders matches by their words, for qsort() */
+static int compare_matches(const void *a, const void *b) {
+    return strcmp(((const struct match *)a)->word, ((const struct match *)b)->word);
+}
+
+/* sorts the list, dropping any word that is in it twice */
+void sort_matches(matches_t *matches) {
+    if (matches->num == 0) {
+        return;
+    }
+    qsort(matches->list, matches->num, sizeof(struct match), compare_matches);
+    size_t kept = 1;
+    for (size_t i = 1; i < matches->num; i++) {
+        if (strcmp(matches->list[i].word, matches->list[kept - 1].word) != 0) {
+            matches->list[kept++] = matches->list[i];
+        }
+    }
+    matches->num = kept;
+}
+
+/* gets the number of matches */
+size_t num_matches(matches_t *matches) { return matches->num; }
+
+/* gets a match, null terminated, sets *len to its length, returns pointer */
+const char *get_match(matches_t *matches, size_t i, size_t *len) {
+    *len = matches->list[i].len;
+    return matches->list[i].word;
+}
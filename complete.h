@@ -0,0 +1,59 @@
+#ifndef COMPLETE_H_
+#define COMPLETE_H_
+
+#include <stddef.h>
+
+typedef struct completion completion_t;
+typedef struct matches matches_t;
+
+/*
+ * initializes the index that completions are found in, nothing is read until
+ * the first completion, returns pointer
+ */
+completion_t *init_completion();
+/*
+ * cleans up the index, closing its directories and its inotify instance
+ * Note: this function will free the completion pointer
+ * DO NOT use the pointer after this function is called
+ */
+void cleanup_completion(completion_t *completion);
+
+/* adds the executables in PATH whose names start with prefix to matches */
+void complete_command(completion_t *completion, const char *prefix, size_t len,
+                      matches_t *matches);
+
+/*
+ * adds the paths that start with prefix to matches, directories end with a /,
+ * only directories and executables are added if executables is non-zero
+ */
+void complete_path(completion_t *completion, const char *prefix, size_t len,
+                   int executables, matches_t *matches);
+
+/* initializes an empty list of matches, returns pointer */
+matches_t *init_matches();
+/*
+ * cleans up the list of matches
+ * Note: this function will free the matches pointer
+ * DO NOT use the pointer after this function is called
+ */
+void cleanup_matches(matches_t *matches);
+
+/* empties the list, the matches it had are no longer valid */
+void clear_matches(matches_t *matches);
+
+/*
+ * adds a word to the list, with a backslash before every character the parser
+ * would take as something other than part of the word
+ */
+void add_match(matches_t *matches, const char *word, size_t len);
+
+/* sorts the list, dropping any word that is in it twice */
+void sort_matches(matches_t *matches);
+
+/* gets the number of matches */
+size_t num_matches(matches_t *matches);
+
+/* gets a match, null terminated, sets *len to its length, returns pointer */
+const char *get_match(matches_t *matches, size_t i, size_t *len);
+
+#endif  // COMPLETE_H_
@@ -0,0 +1,219 @@
+#!/usr/bin/env python3
+"""
+End-to-end benchmark of the shell, run with make bench-e2e.
+
+Feeds generated scripts that run the shell_2_tests programs to a shell and to
+the demo shell, and reports for each:
+
+  - commands/sec for every workload, with the script on stdin like a file
+  - launch latency: from writing a line to the shell until the command's
+    first output, the line runs mypid, which prints its PID at once
+  - reap latency: from that output until the shell answers the next line,
+    so the command has exited and the shell has waited for it
+
+Both latencies are measured from outside, so the demo shell is measured the
+same way. Every shell runs under cs0330_shell_2_harness, like the tests run
+it, which gives it the terminal the demo shell needs. The speedup is how many
+times better the shell does than the demo shell. For our shell, the workloads
+also run with SH33_STATS set, and its own launch, wait and reap percentiles
+are printed as well.
+"""
+import argparse
+import json
+import os
+import select
+import subprocess
+import sys
+import tempfile
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+HARNESS = os.path.join(HERE, "cs0330_shell_2_harness")
+PROGRAMS = os.path.join(HERE, "shell_2_tests", "shell_2_tests_quick", "programs")
+SENTINEL = "cd\n"  # a built-in with no arguments, which only prints an error
+SENTINEL_OUTPUT = b"syntax error"
+TIMEOUT = 10.0
+
+
+def program(name):
+    return os.path.join(PROGRAMS, name)
+
+
+def workload_fg(lines):
+    """foreground commands that exit at once, alternating two programs"""
+    script = []
+    for i in range(lines):
+        if i % 2 == 0:
+            script.append("%s 0 %d" % (program("exit_status"), i % 4))
+        else:
+            script.append(program("mypid"))
+    return script
+
+
+def workload_bg(lines, burst=20):
+    """bursts of background jobs, each burst followed by a foreground one"""
+    script = []
+    while len(script) < lines:
+        for _ in range(burst - 1):
+            script.append("%s 0 &" % program("myspin"))
+        script.append("%s 0 0" % program("exit_status"))
+    return script[:lines]
+
+
+def workload_redir(lines):
+    """commands that append to, truncate and read back files"""
+    script = []
+    for i in range(lines):
+        kind = i % 4
+        if kind == 0:
+            script.append("%s out.txt %s" % (program("33sh_append_file"),
+                                             program("mypid")))
+        elif kind == 1:
+            script.append("%s >> out.txt" % program("mypid"))
+        elif kind == 2:
+            script.append("/bin/cat < out.txt > copy.txt")
+        else:
+            script.append("%s > last.txt" % program("mypid"))
+    return script
+
+
+WORKLOADS = [("fg", workload_fg), ("bg", workload_bg), ("redir", workload_redir)]
+
+
+def run_script(shell, script, runs, env):
+    """runs the script on stdin of the shell, returns the best commands/sec"""
+    best = 0.0
+    with tempfile.TemporaryDirectory() as cwd:
+        path = os.path.join(cwd, "script.txt")
+        with open(path, "w") as f:
+            f.write("\n".join(script) + "\n")
+        for _ in range(runs):
+            with open(path) as stdin:
+                start = time.perf_counter()
+                subprocess.run([HARNESS, shell], stdin=stdin,
+                               stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL, cwd=cwd, env=env,
+                               check=False)
+                elapsed = time.perf_counter() - start
+            best = max(best, len(script) / elapsed)
+    return best
+
+
+class Session:
+    """a shell driven one line at a time, with its stdout and stderr merged"""
+
+    def __init__(self, shell):
+        self.proc = subprocess.Popen([HARNESS, shell], stdin=subprocess.PIPE,
+                                     stdout=subprocess.PIPE,
+                                     stderr=subprocess.STDOUT, bufsize=0)
+        self.output = b""
+
+    def send(self, line):
+        self.proc.stdin.write(line.encode())
+
+    def wait_for(self, found):
+        """reads until found(output) is true, then clears the output"""
+        deadline = time.perf_counter() + TIMEOUT
+        fd = self.proc.stdout.fileno()
+        while not found(self.output):
+            left = deadline - time.perf_counter()
+            if left <= 0 or not select.select([fd], [], [], left)[0]:
+                raise RuntimeError("shell stopped answering, got %r" % self.output)
+            data = os.read(fd, 4096)
+            if not data:
+                raise RuntimeError("shell exited, got %r" % self.output)
+            self.output += data
+        self.output = b""
+
+    def close(self):
+        self.proc.stdin.close()
+        self.proc.wait()
+
+
+def has_pid(output):
+    return any(line.strip().isdigit() for line in output.split(b"\n")[:-1])
+
+
+def has_sentinel(output):
+    return SENTINEL_OUTPUT in output
+
+
+def measure_latency(shell, samples, warmup=20):
+    """returns the launch and reap latencies of every sample, in seconds"""
+    session = Session(shell)
+    launch = []
+    reap = []
+    try:
+        for i in range(warmup + samples):
+            start = time.perf_counter()
+            session.send(program("mypid") + "\n")
+            session.wait_for(has_pid)
+            output = time.perf_counter()
+            session.send(SENTINEL)
+            session.wait_for(has_sentinel)
+            done = time.perf_counter()
+            if i >= warmup:
+                launch.append(output - start)
+                reap.append(done - output)
+    finally:
+        session.close()
+    return launch, reap
+
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+def internal_stats(shell, scripts):
+    """runs the workloads with SH33_STATS set, returns the shell's own stats"""
+    with tempfile.NamedTemporaryFile(suffix=".json") as out:
+        env = dict(os.environ, SH33_STATS=out.name)
+        run_script(shell, [line for script in scripts for line in script], 1, env)
+        with open(out.name) as f:
+            return json.load(f)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--shell", default=os.path.join(HERE, "33noprompt"))
+    parser.add_argument("--baseline",
+                        default=os.path.join(HERE, "cs0330_noprompt_shell_2_demo"))
+    parser.add_argument("--lines", type=int, default=2000,
+                        help="lines in every workload script")
+    parser.add_argument("--runs", type=int, default=3,
+                        help="runs of every script, the best one counts")
+    parser.add_argument("--samples", type=int, default=500,
+                        help="commands the latencies are measured on")
+    args = parser.parse_args()
+
+    shells = [("shell", args.shell), ("baseline", args.baseline)]
+    scripts = [(name, make(args.lines)) for name, make in WORKLOADS]
+    env = dict(os.environ)
+    env.pop("SH33_STATS", None)
+
+    print("%-10s %-8s %14s %14s %8s" % ("workload", "", "shell", "baseline", "speedup"))
+    for name, script in scripts:
+        rates = [run_script(shell, script, args.runs, env) for _, shell in shells]
+        print("%-10s %-8s %14.1f %14.1f %7.2fx" %
+              (name, "cmds/s", rates[0], rates[1], rates[0] / rates[1]))
+
+    latencies = [measure_latency(shell, args.samples) for _, shell in shells]
+    for i, label in enumerate(["launch", "reap"]):
+        for p in [50, 99]:
+            us = [percentile(latency[i], p) * 1e6 for latency in latencies]
+            print("%-10s %-8s %14.1f %14.1f %7.2fx" %
+                  (label, "p%d us" % p, us[0], us[1], us[1] / us[0]))
+
+    stats = internal_stats(args.shell, [script for _, script in scripts])
+    print("\n%s's own stats over every workload (SH33_STATS):" %
+          os.path.basename(args.shell))
+    print("%-12s %10s %12s %12s" % ("phase", "count", "p50 us", "p99 us"))
+    for phase in ["launch", "wait", "reap"]:
+        print("%-12s %10d %12.1f %12.1f" %
+              (phase, stats[phase]["count"], stats[phase]["p50_ns"] / 1e3,
+               stats[phase]["p99_ns"] / 1e3))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
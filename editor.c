@@ -0,0 +1,896 @@
+#include "./editor.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#define INPUT_SIZE 4096  // most bytes of keys read at once
+#define INITIAL_TEXT 256
+#define DEFAULT_WIDTH 80
+#define MAX_ESCAPE 16    // longest escape sequence that is waited for
+#define SEARCH_PROMPT "(reverse-i-search)`"
+#define FAILED_PROMPT "(failed reverse-i-search)`"
+#define CONTROL(c) ((c) & 0x1f)
+#define DELETE 127
+#define MAX_LISTED 256   // most matches a completion lists
+
+// keys that come as escape sequences, numbered after the bytes
+enum {
+    KEY_UP = 256,
+    KEY_DOWN,
+    KEY_RIGHT,
+    KEY_LEFT,
+    KEY_HOME,
+    KEY_END,
+    KEY_DELETE,
+    KEY_WORD_LEFT,
+    KEY_WORD_RIGHT,
+    KEY_ESCAPE,
+    KEY_NONE
+};
+
+// a string that grows by doubling, always null terminated once it has grown
+typedef struct text {
+    char *data;
+    size_t len;
+    size_t size;
+} text_t;
+
+// the screen is kept as the text that is on it, from the start of the prompt,
+// and a key only writes what changed: the cursor moves to the first byte that
+// differs, the rest is written from there and anything left of the old text
+// is cleared, all of it with one write
+struct editor {
+    int in_fd;
+    int out_fd;
+    struct termios cooked;  // the settings the terminal had before raw mode
+    int raw;                // non-zero while the terminal is in raw mode
+    history_t *history;
+    history_search_t *search;
+    completer_t complete;
+    matches_t *matches;  // what the last completion found
+    const char *prompt;
+    text_t line;      // the line being edited
+    size_t cursor;    // byte of the line the cursor is on
+    size_t entry;     // history entry shown, history_len() for the new line
+    text_t saved;     // the new line, while history is browsed
+    int searching;    // non-zero during a reverse incremental search
+    text_t needle;
+    long match;       // entry the search found, -1 if none yet
+    int failed;       // non-zero if no older entry has the needle
+    text_t shown;     // what is on the screen
+    size_t shown_plain;  // bytes of shown before the dimmed suggestion
+    text_t next;      // what should be on the screen
+    size_t column;    // the terminal's cursor, in columns from the prompt
+    size_t width;     // columns of the terminal
+    text_t out;       // the next write
+    char input[INPUT_SIZE];
+    size_t input_len;  // bytes of input not handled yet
+    int partial;       // non-zero if they are only the start of a key
+    int last_key;      // the key handled before this one
+};
+
+/* makes room for len more bytes and a null */
+static void reserve(text_t *text, size_t len) {
+    if (text->len + len + 1 <= text->size) {
+        return;
+    }
+    while (text->len + len + 1 > text->size) {
+        text->size = text->size == 0 ? INITIAL_TEXT : text->size * 2;
+    }
+    text->data = (char *)realloc(text->data, text->size);
+}
+
+/* appends len bytes */
+static void append(text_t *text, const char *s, size_t len) {
+    reserve(text, len);
+    memcpy(text->data + text->len, s, len);
+    text->len += len;
+    text->data[text->len] = '\0';
+}
+
+/* appends a null terminated string */
+static void append_str(text_t *text, const char *s) { append(text, s, strlen(s)); }
+
+/* appends the escape sequence that moves the cursor n times in a direction */
+static void append_move(text_t *text, size_t n, char direction) {
+    char code[32];
+    int len = snprintf(code, sizeof(code), "\x1b[%zu%c", n, direction);
+    append(text, code, (size_t)len);
+}
+
+/* returns non-zero if the byte continues a UTF-8 character */
+static int continues(char c) { return ((unsigned char)c & 0xc0) == 0x80; }
+
+/* returns non-zero if the byte is inserted as it is */
+static int printable(char c) {
+    return (unsigned char)c >= 0x20 && (unsigned char)c != DELETE;
+}
+
+/* counts the columns of len bytes, every character takes one */
+static size_t columns(const char *s, size_t len) {
+    size_t count = 0;
+    for (size_t i = 0; i < len; i++) {
+        count += !continues(s[i]);
+    }
+    return count;
+}
+
+/* writes everything in out */
+static void flush_output(editor_t *editor) {
+    size_t done = 0;
+    while (done < editor->out.len) {
+        ssize_t written = write(editor->out_fd, editor->out.data + done,
+                                editor->out.len - done);
+        if (written < 0) {
+            break;
+        }
+        done += (size_t)written;
+    }
+    editor->out.len = 0;
+}
+
+/* puts the terminal in raw mode, keeping its settings to give them back */
+static void raw_mode(editor_t *editor) {
+    struct termios raw;
+    if (editor->raw || tcgetattr(editor->in_fd, &editor->cooked) != 0) {
+        return;
+    }
+    raw = editor->cooked;
+    // keys come one at a time and aren't echoed, ^C and ^Z are keys too,
+    // output processing stays on so a \n printed by anything still starts a line
+    raw.c_iflag &= ~(tcflag_t)(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+    raw.c_cflag |= CS8;
+    raw.c_lflag &= ~(tcflag_t)(ECHO | ICANON | IEXTEN | ISIG);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    if (tcsetattr(editor->in_fd, TCSADRAIN, &raw) == 0) {
+        editor->raw = 1;
+    }
+}
+
+/*
+ * initializes a line editor on a terminal, lines are browsed and searched in
+ * history and search, and tab completes words with complete, any of which may
+ * be NULL, returns pointer
+ */
+editor_t *init_editor(int in_fd, int out_fd, history_t *history,
+                      history_search_t *search, completer_t complete) {
+    editor_t *editor = (editor_t *)calloc(1, sizeof(editor_t));
+    editor->in_fd = in_fd;
+    editor->out_fd = out_fd;
+    editor->history = history;
+    editor->search = search;
+    editor->complete = complete;
+    if (complete != NULL) {
+        editor->matches = init_matches();
+    }
+    editor->width = DEFAULT_WIDTH;
+    editor->match = -1;
+    // every text has a buffer, so none is ever NULL
+    text_t *texts[] = {&editor->line, &editor->saved, &editor->needle,
+                       &editor->shown, &editor->next, &editor->out};
+    for (size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); i++) {
+        reserve(texts[i], 0);
+        texts[i]->data[0] = '\0';
+    }
+    return editor;
+}
+
+/*
+ * cleans up the line editor, giving the terminal its settings back
+ * Note: this function will free the editor pointer
+ * DO NOT use the pointer after this function is called
+ */
+void cleanup_editor(editor_t *editor) {
+    if (editor == NULL) {
+        return;
+    }
+    editor_stop(editor);
+    free(editor->line.data);
+    free(editor->saved.data);
+    free(editor->needle.data);
+    free(editor->shown.data);
+    free(editor->next.data);
+    free(editor->out.data);
+    if (editor->matches != NULL) {
+        cleanup_matches(editor->matches);
+    }
+    free(editor);
+}
+
+/* moves the terminal's cursor to a column, counted from the prompt */
+static void move_to(editor_t *editor, size_t column) {
+    size_t from_row = editor->column / editor->width;
+    size_t to_row = column / editor->width;
+    size_t from = editor->column % editor->width;
+    size_t to = column % editor->width;
+
+    if (to_row < from_row) {
+        append_move(&editor->out, from_row - to_row, 'A');
+    } else if (to_row > from_row) {
+        append_move(&editor->out, to_row - from_row, 'B');
+    }
+    if (to < from) {
+        append_move(&editor->out, from - to, 'D');
+    } else if (to > from) {
+        append_move(&editor->out, to - from, 'C');
+    }
+    editor->column = column;
+}
+
+/*
+ * changes the screen from shown to next, whose bytes from plain on are
+ * dimmed, and puts the cursor on byte cursor of next
+ */
+static void draw(editor_t *editor, size_t plain, size_t cursor) {
+    text_t *shown = &editor->shown;
+    text_t *next = &editor->next;
+    size_t limit = shown->len < next->len ? shown->len : next->len;
+    size_t same = 0;
+    while (same < limit && shown->data[same] == next->data[same]) {
+        same++;
+    }
+    // where the dimmed part starts moved, so it is written again from there
+    if (plain != editor->shown_plain) {
+        size_t start = plain < editor->shown_plain ? plain : editor->shown_plain;
+        same = same < start ? same : start;
+    }
+    // a character is written whole
+    while (same > 0 && ((same < next->len && continues(next->data[same])) ||
+                        (same < shown->len && continues(shown->data[same])))) {
+        same--;
+    }
+
+    size_t old_end = columns(shown->data, shown->len);
+    size_t new_end = columns(next->data, next->len);
+    move_to(editor, columns(next->data, same));
+    if (same < next->len) {
+        if (same < plain) {
+            append(&editor->out, next->data + same, plain - same);
+        }
+        size_t dim = same > plain ? same : plain;
+        if (dim < next->len) {
+            append_str(&editor->out, "\x1b[2m");
+            append(&editor->out, next->data + dim, next->len - dim);
+            append_str(&editor->out, "\x1b[0m");
+        }
+        editor->column = new_end;
+        // after the last column the cursor waits for another character
+        // before it wraps, so it is moved to the next line by hand
+        if (new_end % editor->width == 0) {
+            append_str(&editor->out, "\r\n");
+        }
+    }
+    if (old_end > new_end) {
+        append_str(&editor->out, "\x1b[J");
+    }
+    move_to(editor, columns(next->data, cursor));
+
+    text_t old = *shown;
+    *shown = *next;
+    *next = old;
+    editor->shown_plain = plain;
+}
+
+/*
+ * finds the newest history entry that the line is the start of, if the
+ * cursor is at the end of the line
+ * returns the entry, NULL if there is none, and sets *len to its length
+ */
+static const char *suggestion(editor_t *editor, size_t *len) {
+    if (editor->search == NULL || editor->line.len == 0 ||
+        editor->cursor != editor->line.len) {
+        return NULL;
+    }
+    long entry = search_history_prefix(editor->search, editor->line.data,
+                                       editor->line.len,
+                                       history_len(editor->history));
+    return entry < 0 ? NULL : get_history(editor->history, (size_t)entry, len);
+}
+
+/*
+ * works out what should be on the screen and draws it, with the suggestion
+ * if with_suggestion is non-zero
+ */
+static void refresh(editor_t *editor, int with_suggestion) {
+    text_t *next = &editor->next;
+    size_t cursor;
+    size_t plain;
+    size_t len = 0;
+    const char *found;
+
+    next->len = 0;
+    if (editor->searching) {
+        append_str(next, editor->failed ? FAILED_PROMPT : SEARCH_PROMPT);
+        append(next, editor->needle.data, editor->needle.len);
+        append_str(next, "': ");
+        cursor = next->len;
+        if (editor->match >= 0) {
+            found = get_history(editor->history, (size_t)editor->match, &len);
+            const char *at = (const char *)memmem(found, len, editor->needle.data,
+                                                  editor->needle.len);
+            cursor += at != NULL ? (size_t)(at - found) : 0;
+            append(next, found, len);
+        }
+        plain = next->len;
+    } else {
+        append_str(next, editor->prompt);
+        cursor = next->len + editor->cursor;
+        append(next, editor->line.data, editor->line.len);
+        plain = next->len;
+        found = with_suggestion ? suggestion(editor, &len) : NULL;
+        if (found != NULL) {
+            append(next, found + editor->line.len, len - editor->line.len);
+        }
+    }
+    draw(editor, plain, cursor);
+}
+
+/*
+ * moves below the line, leaving it on the screen as it is without the
+ * suggestion, and with mark after it
+ */
+static void leave(editor_t *editor, const char *mark) {
+    refresh(editor, 0);
+    move_to(editor, columns(editor->shown.data, editor->shown_plain));
+    append_str(&editor->out, "\x1b[J");
+    append_str(&editor->out, mark);
+    // the line may have just wrapped to an empty row
+    if (*mark != '\0' || editor->column % editor->width != 0) {
+        append_str(&editor->out, "\r\n");
+    }
+    editor->shown.len = 0;
+    editor->shown_plain = 0;
+    editor->column = 0;
+}
+
+/* replaces the line, with the cursor at its end */
+static void set_line(editor_t *editor, const char *s, size_t len) {
+    editor->line.len = 0;
+    append(&editor->line, s, len);
+    editor->cursor = len;
+}
+
+/* inserts bytes at the cursor */
+static void insert(editor_t *editor, const char *s, size_t len) {
+    text_t *line = &editor->line;
+    reserve(line, len);
+    memmove(line->data + editor->cursor + len, line->data + editor->cursor,
+            line->len - editor->cursor + 1);
+    memcpy(line->data + editor->cursor, s, len);
+    line->len += len;
+    editor->cursor += len;
+}
+
+/* deletes the bytes from start to end, the cursor goes to start */
+static void delete_range(editor_t *editor, size_t start, size_t end) {
+    text_t *line = &editor->line;
+    memmove(line->data + start, line->data + end, line->len - end + 1);
+    line->len -= end - start;
+    editor->cursor = start;
+}
+
+/* finds the start of the character before pos */
+static size_t char_before(editor_t *editor, size_t pos) {
+    while (pos > 0 && continues(editor->line.data[--pos])) {
+    }
+    return pos;
+}
+
+/* finds the start of the character after the one at pos */
+static size_t char_after(editor_t *editor, size_t pos) {
+    if (pos < editor->line.len) {
+        pos++;
+    }
+    while (pos < editor->line.len && continues(editor->line.data[pos])) {
+        pos++;
+    }
+    return pos;
+}
+
+/* finds the start of the word before pos */
+static size_t word_before(editor_t *editor, size_t pos) {
+    while (pos > 0 && editor->line.data[pos - 1] == ' ') {
+        pos--;
+    }
+    while (pos > 0 && editor->line.data[pos - 1] != ' ') {
+        pos--;
+    }
+    return pos;
+}
+
+/* finds the end of the word after pos */
+static size_t word_after(editor_t *editor, size_t pos) {
+    while (pos < editor->line.len && editor->line.data[pos] == ' ') {
+        pos++;
+    }
+    while (pos < editor->line.len && editor->line.data[pos] != ' ') {
+        pos++;
+    }
+    return pos;
+}
+
+/* shows a history entry instead of the line, keeping the new line aside */
+static void browse(editor_t *editor, size_t entry) {
+    size_t total = history_len(editor->history);
+    if (editor->entry == total) {
+        editor->saved.len = 0;
+        append(&editor->saved, editor->line.data, editor->line.len);
+    }
+    editor->entry = entry;
+    if (entry == total) {
+        set_line(editor, editor->saved.data, editor->saved.len);
+    } else {
+        size_t len;
+        const char *line = get_history(editor->history, entry, &len);
+        set_line(editor, line != NULL ? line : "", line != NULL ? len : 0);
+    }
+}
+
+/* finds the newest entry with the needle before entry number before */
+static void find_older(editor_t *editor, size_t before) {
+    if (editor->needle.len == 0) {
+        editor->match = -1;
+        editor->failed = 0;
+        return;
+    }
+    long found = search_history(editor->search, editor->needle.data,
+                                editor->needle.len, before);
+    editor->failed = found < 0;
+    if (found >= 0) {
+        editor->match = found;
+    }
+}
+
+/*
+ * handles a key during a search, returns non-zero if it was used, 0 if it
+ * ends the search, with the entry found as the line, and is handled as usual
+ */
+static int search_key(editor_t *editor, int key) {
+    size_t total = history_len(editor->history);
+    switch (key) {
+        case CONTROL('R'):
+            find_older(editor, editor->match >= 0 ? (size_t)editor->match : total);
+            return 1;
+        case CONTROL('H'):
+        case DELETE:
+            while (editor->needle.len > 0 &&
+                   continues(editor->needle.data[--editor->needle.len])) {
+            }
+            find_older(editor, total);
+            return 1;
+        case CONTROL('G'):
+        case CONTROL('C'):
+        case KEY_ESCAPE:
+            editor->searching = 0;
+            return 1;
+        default:
+            if (editor->match >= 0) {
+                size_t len;
+                const char *line =
+                    get_history(editor->history, (size_t)editor->match, &len);
+                set_line(editor, line, len);
+            }
+            editor->searching = 0;
+            return 0;
+    }
+}
+
+/* gets the part of a match that is listed, its last component */
+static const char *listed_name(const char *match, size_t len) {
+    // a directory's / is part of its name
+    size_t end = len > 1 && match[len - 1] == '/' ? len - 1 : len;
+    const char *slash = (const char *)memrchr(match, '/', end);
+    return slash != NULL ? slash + 1 : match;
+}
+
+/* lists the matches below the line, in columns sorted downwards like ls does */
+static void list_matches(editor_t *editor) {
+    size_t num = num_matches(editor->matches);
+    size_t listed = num < MAX_LISTED ? num : MAX_LISTED;
+    size_t widest = 0;
+    size_t len;
+
+    leave(editor, "");
+    for (size_t i = 0; i < listed; i++) {
+        const char *match = get_match(editor->matches, i, &len);
+        const char *name = listed_name(match, len);
+        size_t width = columns(name, len - (size_t)(name - match));
+        widest = width > widest ? width : widest;
+    }
+    size_t per_row = editor->width / (widest + 2);
+    per_row = per_row == 0 ? 1 : per_row;
+    size_t rows = (listed + per_row - 1) / per_row;
+
+    for (size_t row = 0; row < rows; row++) {
+        for (size_t i = row; i < listed; i += rows) {
+            const char *match = get_match(editor->matches, i, &len);
+            const char *name = listed_name(match, len);
+            size_t name_len = len - (size_t)(name - match);
+            append(&editor->out, name, name_len);
+            if (i + rows < listed) {
+                for (size_t pad = columns(name, name_len); pad < widest + 2; pad++) {
+                    append(&editor->out, " ", 1);
+                }
+            }
+        }
+        append_str(&editor->out, "\r\n");
+    }
+    if (listed < num) {
+        char more[64];
+        int more_len = snprintf(more, sizeof(more), "(%zu more)\r\n", num - listed);
+        append(&editor->out, more, (size_t)more_len);
+    }
+}
+
+/*
+ * completes the word before the cursor as far as all of its matches agree, a
+ * word with only one match gets a space after it unless it is a directory,
+ * a second tab that can't complete any further lists the matches
+ */
+static void complete(editor_t *editor) {
+    size_t first_len;
+    size_t len;
+
+    clear_matches(editor->matches);
+    size_t start = editor->complete(editor->line.data, editor->cursor, editor->matches);
+    sort_matches(editor->matches);
+    size_t num = num_matches(editor->matches);
+    if (num == 0) {
+        append_str(&editor->out, "\a");
+        return;
+    }
+
+    const char *first = get_match(editor->matches, 0, &first_len);
+    size_t common = first_len;
+    for (size_t i = 1; i < num; i++) {
+        const char *match = get_match(editor->matches, i, &len);
+        size_t same = 0;
+        while (same < common && same < len && match[same] == first[same]) {
+            same++;
+        }
+        common = same;
+    }
+    // a character is only taken whole, and a backslash with what it escapes
+    while (common < first_len && common > 0 && continues(first[common])) {
+        common--;
+    }
+    size_t backslashes = 0;
+    while (backslashes < common && first[common - backslashes - 1] == '\\') {
+        backslashes++;
+    }
+    common -= backslashes % 2;
+
+    size_t word_len = editor->cursor - start;
+    if (num == 1) {
+        delete_range(editor, start, editor->cursor);
+        insert(editor, first, first_len);
+        if (first[first_len - 1] != '/') {
+            insert(editor, " ", 1);
+        }
+    } else if (common != word_len ||
+               memcmp(first, editor->line.data + start, common) != 0) {
+        delete_range(editor, start, editor->cursor);
+        insert(editor, first, common);
+    } else if (editor->last_key == '\t') {
+        list_matches(editor);
+    } else {
+        append_str(&editor->out, "\a");
+    }
+}
+
+/* handles a key that isn't text, returns what editor_read() returns */
+static int handle_key(editor_t *editor, int key) {
+    size_t total = editor->history != NULL ? history_len(editor->history) : 0;
+    size_t len;
+    const char *found;
+
+    if (editor->searching && search_key(editor, key)) {
+        return EDITOR_MORE;
+    }
+    switch (key) {
+        case '\r':
+        case '\n':
+            leave(editor, "");
+            return EDITOR_LINE;
+        case CONTROL('D'):
+            if (editor->line.len == 0) {
+                leave(editor, "");
+                return EDITOR_EOF;
+            }
+            delete_range(editor, editor->cursor, char_after(editor, editor->cursor));
+            break;
+        case KEY_DELETE:
+            delete_range(editor, editor->cursor, char_after(editor, editor->cursor));
+            break;
+        case CONTROL('H'):
+        case DELETE:
+            delete_range(editor, char_before(editor, editor->cursor), editor->cursor);
+            break;
+        case KEY_LEFT:
+        case CONTROL('B'):
+            editor->cursor = char_before(editor, editor->cursor);
+            break;
+        case KEY_RIGHT:
+        case CONTROL('F'):
+        case KEY_END:
+        case CONTROL('E'):
+            // at the end of the line they take the suggestion
+            found = suggestion(editor, &len);
+            if (found != NULL) {
+                append(&editor->line, found + editor->line.len, len - editor->line.len);
+                editor->cursor = editor->line.len;
+            } else if (key == KEY_END || key == CONTROL('E')) {
+                editor->cursor = editor->line.len;
+            } else {
+                editor->cursor = char_after(editor, editor->cursor);
+            }
+            break;
+        case KEY_HOME:
+        case CONTROL('A'):
+            editor->cursor = 0;
+            break;
+        case KEY_WORD_LEFT:
+            editor->cursor = word_before(editor, editor->cursor);
+            break;
+        case KEY_WORD_RIGHT:
+            editor->cursor = word_after(editor, editor->cursor);
+            break;
+        case CONTROL('K'):
+            delete_range(editor, editor->cursor, editor->line.len);
+            break;
+        case CONTROL('U'):
+            delete_range(editor, 0, editor->cursor);
+            break;
+        case CONTROL('W'):
+            delete_range(editor, word_before(editor, editor->cursor), editor->cursor);
+            break;
+        case KEY_UP:
+        case CONTROL('P'):
+            if (editor->history != NULL && editor->entry > 0) {
+                browse(editor, editor->entry - 1);
+            }
+            break;
+        case KEY_DOWN:
+        case CONTROL('N'):
+            if (editor->history != NULL && editor->entry < total) {
+                browse(editor, editor->entry + 1);
+            }
+            break;
+        case CONTROL('R'):
+            if (editor->search != NULL) {
+                editor->searching = 1;
+                editor->needle.len = 0;
+                editor->match = -1;
+                editor->failed = 0;
+            }
+            break;
+        case '\t':
+            if (editor->complete != NULL) {
+                complete(editor);
+            }
+            break;
+        case CONTROL('L'):
+            append_str(&editor->out, "\x1b[H\x1b[2J");
+            editor->shown.len = 0;
+            editor->shown_plain = 0;
+            editor->column = 0;
+            break;
+        case CONTROL('C'):
+            // the line is dropped, and a new one starts below it
+            leave(editor, "^C");
+            set_line(editor, "", 0);
+            editor->entry = total;
+            break;
+        default:
+            break;
+    }
+    return EDITOR_MORE;
+}
+
+/*
+ * decodes the escape sequence of a key, sets *key to it, KEY_NONE if it is
+ * one that isn't handled, returns the length of the sequence, 0 if only its
+ * start has been read
+ */
+static size_t decode_escape(const char *s, size_t n, int *key) {
+    *key = KEY_NONE;
+    if (n == 1) {
+        *key = KEY_ESCAPE;
+        return 1;
+    }
+    // alt and a key
+    if (s[1] != '[' && s[1] != 'O') {
+        *key = s[1] == 'b' ? KEY_WORD_LEFT : s[1] == 'f' ? KEY_WORD_RIGHT : KEY_NONE;
+        return 2;
+    }
+
+    // CSI: numbers separated by ; and a final byte
+    int numbers[2] = {0, 0};
+    int count = 0;
+    size_t i = 2;
+    while (i < n && i < MAX_ESCAPE && ((s[i] >= '0' && s[i] <= '9') || s[i] == ';')) {
+        if (s[i] == ';') {
+            count++;
+        } else if (count < 2) {
+            numbers[count] = numbers[count] * 10 + (s[i] - '0');
+        }
+        i++;
+    }
+    if (i == n) {
+        return i < MAX_ESCAPE ? 0 : i;
+    }
+
+    // ctrl and an arrow moves by words
+    int ctrl = count > 0 && numbers[1] == 5;
+    switch (s[i]) {
+        case 'A': *key = KEY_UP; break;
+        case 'B': *key = KEY_DOWN; break;
+        case 'C': *key = ctrl ? KEY_WORD_RIGHT : KEY_RIGHT; break;
+        case 'D': *key = ctrl ? KEY_WORD_LEFT : KEY_LEFT; break;
+        case 'H': *key = KEY_HOME; break;
+        case 'F': *key = KEY_END; break;
+        case '~':
+            if (numbers[0] == 1 || numbers[0] == 7) {
+                *key = KEY_HOME;
+            } else if (numbers[0] == 4 || numbers[0] == 8) {
+                *key = KEY_END;
+            } else if (numbers[0] == 3) {
+                *key = KEY_DELETE;
+            }
+            break;
+        default:
+            break;
+    }
+    return i + 1;
+}
+
+/*
+ * handles the key at the start of n bytes of input, a run of text is
+ * inserted at once, sets *ret to what editor_read() returns
+ * returns the bytes used, 0 if only the start of a key has been read
+ */
+static size_t handle_input(editor_t *editor, const char *s, size_t n, int *ret) {
+    int key = (unsigned char)s[0];
+    size_t used = 1;
+
+    if (printable(s[0])) {
+        while (used < n && printable(s[used])) {
+            used++;
+        }
+        if (editor->searching) {
+            append(&editor->needle, s, used);
+            find_older(editor, editor->match >= 0 ? (size_t)editor->match + 1
+                                                  : history_len(editor->history));
+        } else {
+            insert(editor, s, used);
+        }
+        editor->last_key = (unsigned char)s[used - 1];
+        return used;
+    }
+
+    if (key == 0x1b) {
+        used = decode_escape(s, n, &key);
+        if (used == 0) {
+            return 0;
+        }
+    }
+    *ret = handle_key(editor, key);
+    editor->last_key = key;
+    return used;
+}
+
+/*
+ * starts editing a new line, puts the terminal in raw mode and shows the
+ * prompt, which must stay valid until the line is entered
+ */
+void editor_start(editor_t *editor, const char *prompt) {
+    struct winsize size;
+
+    // anything printed with stdio goes first
+    fflush(stdout);
+    raw_mode(editor);
+    editor->width = ioctl(editor->out_fd, TIOCGWINSZ, &size) == 0 && size.ws_col > 0
+                        ? size.ws_col
+                        : DEFAULT_WIDTH;
+    editor->prompt = prompt;
+    set_line(editor, "", 0);
+    editor->entry = editor->history != NULL ? history_len(editor->history) : 0;
+    editor->searching = 0;
+    editor->shown.len = 0;
+    editor->shown_plain = 0;
+    editor->column = 0;
+    refresh(editor, 1);
+    flush_output(editor);
+}
+
+/*
+ * gives the terminal back the settings it had before editor_start(), so the
+ * commands of the line get it as they expect it
+ */
+void editor_stop(editor_t *editor) {
+    if (editor->raw) {
+        tcsetattr(editor->in_fd, TCSADRAIN, &editor->cooked);
+        editor->raw = 0;
+    }
+}
+
+/*
+ * reads the keys that are available, or keys left over from the last read,
+ * and shows what they changed with one write
+ * returns EDITOR_LINE once a line is entered, EDITOR_MORE if it isn't yet,
+ * EDITOR_EOF if the input ended
+ */
+int editor_read(editor_t *editor) {
+    int ret = EDITOR_MORE;
+    size_t done = 0;
+
+    if (!editor_pending(editor)) {
+        ssize_t n = read(editor->in_fd, editor->input + editor->input_len,
+                         INPUT_SIZE - editor->input_len);
+        if (n < 0 && (errno == EINTR || errno == EAGAIN)) {
+            return EDITOR_MORE;
+        }
+        if (n <= 0) {
+            return EDITOR_EOF;
+        }
+        editor->input_len += (size_t)n;
+    }
+
+    // everything that was read is handled before the screen is drawn once,
+    // unless a line ends first, the rest is kept for the next line
+    editor->partial = 0;
+    while (done < editor->input_len && ret == EDITOR_MORE) {
+        size_t used = handle_input(editor, editor->input + done,
+                                   editor->input_len - done, &ret);
+        if (used == 0) {
+            editor->partial = 1;
+            break;
+        }
+        done += used;
+    }
+    memmove(editor->input, editor->input + done, editor->input_len - done);
+    editor->input_len -= done;
+
+    if (ret == EDITOR_MORE) {
+        refresh(editor, 1);
+    }
+    flush_output(editor);
+    return ret;
+}
+
+/*
+ * returns non-zero if keys left over from the last read are waiting, so they
+ * are read before waiting for input
+ */
+int editor_pending(editor_t *editor) {
+    return editor->input_len > 0 && !editor->partial;
+}
+
+/*
+ * gets the line that was entered, null terminated, len is set to its length
+ * the line stays valid until the next editor_start()
+ */
+char *editor_line(editor_t *editor, size_t *len) {
+    *len = editor->line.len;
+    return editor->line.data;
+}
+
+/* moves below the line being edited, so something else can be printed */
+void editor_hide(editor_t *editor) {
+    if (editor->shown.len > 0) {
+        leave(editor, "");
+        flush_output(editor);
+    }
+}
+
+/* shows the prompt and the line being edited again after editor_hide() */
+void editor_show(editor_t *editor) {
+    fflush(stdout);
+    refresh(editor, 1);
+    flush_output(editor);
+}
@@ -0,0 +1,74 @@
+#ifndef EDITOR_H_
+#define EDITOR_H_
+
+#include <stddef.h>
+#include "./complete.h"
+#include "./histsearch.h"
+#include "./history.h"
+
+#define EDITOR_EOF -1   // editor_read(): the input ended
+#define EDITOR_MORE 0   // editor_read(): the line isn't finished yet
+#define EDITOR_LINE 1   // editor_read(): a line was entered
+
+typedef struct editor editor_t;
+
+/*
+ * finds what the word that ends at the end of line, len bytes long, can be
+ * completed to, adds every word it can become to matches, returns where the
+ * word starts in line
+ */
+typedef size_t (*completer_t)(const char *line, size_t len, matches_t *matches);
+
+/*
+ * initializes a line editor on a terminal, lines are browsed and searched in
+ * history and search, and tab completes words with complete, any of which may
+ * be NULL, returns pointer
+ */
+editor_t *init_editor(int in_fd, int out_fd, history_t *history,
+                      history_search_t *search, completer_t complete);
+/*
+ * cleans up the line editor, giving the terminal its settings back
+ * Note: this function will free the editor pointer
+ * DO NOT use the pointer after this function is called
+ */
+void cleanup_editor(editor_t *editor);
+
+/*
+ * starts editing a new line, puts the terminal in raw mode and shows the
+ * prompt, which must stay valid until the line is entered
+ */
+void editor_start(editor_t *editor, const char *prompt);
+
+/*
+ * gives the terminal back the settings it had before editor_start(), so the
+ * commands of the line get it as they expect it
+ */
+void editor_stop(editor_t *editor);
+
+/*
+ * reads the keys that are available, or keys left over from the last read,
+ * and shows what they changed with one write
+ * returns EDITOR_LINE once a line is entered, EDITOR_MORE if it isn't yet,
+ * EDITOR_EOF if the input ended
+ */
+int editor_read(editor_t *editor);
+
+/*
+ * returns non-zero if keys left over from the last read are waiting, so they
+ * are read before waiting for input
+ */
+int editor_pending(editor_t *editor);
+
+/*
+ * gets the line that was entered, null terminated, len is set to its length
+ * the line stays valid until the next editor_start()
+ */
+char *editor_line(editor_t *editor, size_t *len);
+
+/* moves below the line being edited, so something else can be printed */
+void editor_hide(editor_t *editor);
+
+/* shows the prompt and the line being edited again after editor_hide() */
+void editor_show(editor_t *editor);
+
+#endif  // EDITOR_H_
@@ -0,0 +1,345 @@
+#include "./history.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "./arena.h"
+
+#define INDEX_MAGIC "33SHIDX1"  // the header of the index
+#define HEADER_SIZE 8
+#define REBUILD_BATCH 4096  // offsets written at once when rebuilding the index
+#define INITIAL_ADDED 64
+#define LINES_SIZE 4096     // first block of the lines arena
+
+// a line added since the history was opened
+struct added {
+    const char *line;
+    size_t len;
+};
+
+// the history file is every line followed by a newline, the index is a header
+// and the offset of every line in the file as a native uint64_t, so opening
+// the history only maps both files and finding an entry parses nothing
+// lines added later are appended to both files and also kept in memory, the
+// mappings stay as they were when the history was opened
+struct history {
+    int fd;  // the history file, its lock guards both files
+    int index_fd;
+    char *data;  // the history file, mapped read only
+    size_t data_size;
+    void *index_map;  // the index, mapped
+    size_t index_size;
+    const uint64_t *offsets;  // where the lines are in data, after the header
+    size_t num_mapped;
+    struct added *added;
+    size_t num_added;
+    size_t max_added;
+    arena_t *lines;  // the added lines
+};
+
+/* writes all of buffer, returns 0 on success, -1 on failure */
+static int write_all(int fd, const void *buffer, size_t len) {
+    const char *next = (const char *)buffer;
+    while (len > 0) {
+        ssize_t written = write(fd, next, len);
+        if (written < 0) {
+            return -1;
+        }
+        next += written;
+        len -= (size_t)written;
+    }
+    return 0;
+}
+
+/* maps the index as it is now, returns 0 on success, -1 on failure */
+static int map_index(history_t *history) {
+    struct stat index_stat;
+    if (fstat(history->index_fd, &index_stat) != 0) {
+        return -1;
+    }
+    history->index_size = (size_t)index_stat.st_size;
+    if (history->index_size < HEADER_SIZE) {
+        return 0;
+    }
+    history->index_map = mmap(NULL, history->index_size, PROT_READ, MAP_SHARED,
+                              history->index_fd, 0);
+    if (history->index_map == MAP_FAILED) {
+        history->index_map = NULL;
+        return -1;
+    }
+    history->offsets =
+        (const uint64_t *)((const char *)history->index_map + HEADER_SIZE);
+    history->num_mapped = (history->index_size - HEADER_SIZE) / sizeof(uint64_t);
+    return 0;
+}
+
+/* unmaps the index */
+static void unmap_index(history_t *history) {
+    if (history->index_map != NULL) {
+        munmap(history->index_map, history->index_size);
+    }
+    history->index_map = NULL;
+    history->offsets = NULL;
+    history->num_mapped = 0;
+}
+
+/*
+ * checks that the index was written for the history file, its last offset
+ * has to be the start of a line, returns non-zero if it was
+ */
+static int index_matches(history_t *history) {
+    if (history->index_map == NULL ||
+        (history->index_size - HEADER_SIZE) % sizeof(uint64_t) != 0 ||
+        memcmp(history->index_map, INDEX_MAGIC, HEADER_SIZE) != 0) {
+        return 0;
+    }
+    if (history->num_mapped == 0) {
+        return history->data_size == 0;
+    }
+    uint64_t last = history->offsets[history->num_mapped - 1];
+    return last < history->data_size &&
+           (last == 0 || history->data[last - 1] == '\n');
+}
+
+/*
+ * returns where the first line the index doesn't have starts, the size of the
+ * history file if it has them all
+ */
+static size_t unindexed(history_t *history) {
+    if (history->num_mapped == 0) {
+        return 0;
+    }
+    uint64_t last = history->offsets[history->num_mapped - 1];
+    const char *newline = (const char *)memchr(history->data + last, '\n',
+                                               history->data_size - last);
+    return newline == NULL ? history->data_size
+                           : (size_t)(newline - history->data) + 1;
+}
+
+/*
+ * appends the offset of every line of the history file from start on to the
+ * index, returns 0 on success, -1 on failure
+ */
+static int index_lines(history_t *history, size_t start) {
+    uint64_t batch[REBUILD_BATCH];
+    size_t n = 0;
+
+    while (start < history->data_size) {
+        batch[n++] = start;
+        if (n == REBUILD_BATCH) {
+            if (write_all(history->index_fd, batch, sizeof(batch)) != 0) {
+                return -1;
+            }
+            n = 0;
+        }
+        const char *newline = (const char *)memchr(
+            history->data + start, '\n', history->data_size - start);
+        if (newline == NULL) {
+            break;
+        }
+        start = (size_t)(newline - history->data) + 1;
+    }
+    return write_all(history->index_fd, batch, n * sizeof(uint64_t));
+}
+
+/*
+ * writes the index again from the history file, for a history file that has
+ * none yet or one that doesn't match it, returns 0 on success, -1 on failure
+ */
+static int rebuild_index(history_t *history) {
+    if (ftruncate(history->index_fd, 0) != 0 ||
+        write_all(history->index_fd, INDEX_MAGIC, HEADER_SIZE) != 0) {
+        return -1;
+    }
+    return index_lines(history, 0);
+}
+
+/*
+ * maps the history file and its index, rebuilding the index first if it
+ * doesn't match, or indexing the lines at the end of the file it doesn't have,
+ * which a crash between the two writes of append_line() or another program
+ * appending to the file leaves behind, must be called with the lock held
+ * returns 0 on success, -1 on failure
+ */
+static int map_history(history_t *history) {
+    struct stat data_stat;
+    if (fstat(history->fd, &data_stat) != 0) {
+        return -1;
+    }
+    history->data_size = (size_t)data_stat.st_size;
+    if (history->data_size > 0) {
+        void *data = mmap(NULL, history->data_size, PROT_READ, MAP_SHARED,
+                          history->fd, 0);
+        if (data == MAP_FAILED) {
+            return -1;
+        }
+        history->data = (char *)data;
+    }
+
+    if (map_index(history) != 0 || !index_matches(history)) {
+        unmap_index(history);
+        if (rebuild_index(history) != 0 || map_index(history) != 0) {
+            return -1;
+        }
+    } else {
+        size_t tail = unindexed(history);
+        if (tail < history->data_size) {
+            unmap_index(history);
+            if (index_lines(history, tail) != 0 || map_index(history) != 0) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+/*
+ * opens the history file at path and its index at path.idx, creating them if
+ * they don't exist, the entries already in the file are mapped, not read
+ * returns pointer, NULL if the history file can't be opened
+ */
+history_t *init_history(const char *path) {
+    size_t path_len = strlen(path);
+    char *index_path = (char *)malloc(path_len + sizeof(".idx"));
+    memcpy(index_path, path, path_len);
+    memcpy(index_path + path_len, ".idx", sizeof(".idx"));
+
+    history_t *history = (history_t *)calloc(1, sizeof(history_t));
+    history->fd = open(path, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    history->index_fd =
+        open(index_path, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    free(index_path);
+    history->lines = init_arena(LINES_SIZE);
+    if (history->fd < 0 || history->index_fd < 0) {
+        cleanup_history(history);
+        return NULL;
+    }
+
+    // another shell may be appending, or rebuilding the index
+    flock(history->fd, LOCK_EX);
+    int ret = map_history(history);
+    flock(history->fd, LOCK_UN);
+    if (ret != 0) {
+        cleanup_history(history);
+        return NULL;
+    }
+    return history;
+}
+
+/*
+ * cleans up the history, the entries stay in the file
+ * Note: this function will free the history pointer
+ * DO NOT use the pointer after this function is called
+ */
+void cleanup_history(history_t *history) {
+    if (history == NULL) {
+        return;
+    }
+    unmap_index(history);
+    if (history->data != NULL) {
+        munmap(history->data, history->data_size);
+    }
+    if (history->fd >= 0) {
+        close(history->fd);
+    }
+    if (history->index_fd >= 0) {
+        close(history->index_fd);
+    }
+    free(history->added);
+    cleanup_arena(history->lines);
+    free(history);
+}
+
+/*
+ * appends a line, with its newline, to the history file and its offset to the
+ * index, must be called with the lock held, returns 0 on success, -1 on failure
+ */
+static int append_line(history_t *history, const char *line, size_t len) {
+    struct stat data_stat;
+    if (fstat(history->fd, &data_stat) != 0) {
+        return -1;
+    }
+    uint64_t offset = (uint64_t)data_stat.st_size;
+
+    // a line cut short by a crash gets its newline, so it isn't joined to this
+    char last = '\n';
+    if (offset > 0 && pread(history->fd, &last, 1, (off_t)offset - 1) != 1) {
+        return -1;
+    }
+    if (last != '\n') {
+        if (write_all(history->fd, "\n", 1) != 0) {
+            return -1;
+        }
+        offset++;
+    }
+
+    if (write_all(history->fd, line, len) != 0) {
+        return -1;
+    }
+    return write_all(history->index_fd, &offset, sizeof(offset));
+}
+
+/*
+ * appends a line, which must not have a newline, to the history file and to
+ * the history, returns 0 on success, -1 if it couldn't be written to the file
+ */
+int add_history(history_t *history, const char *line, size_t len) {
+    // kept with its newline, so it goes to the file in one write
+    char *copy = (char *)arena_alloc(history->lines, len + 1);
+    memcpy(copy, line, len);
+    copy[len] = '\n';
+
+    if (history->num_added == history->max_added) {
+        history->max_added =
+            history->max_added == 0 ? INITIAL_ADDED : history->max_added * 2;
+        history->added = (struct added *)realloc(
+            history->added, history->max_added * sizeof(struct added));
+    }
+    history->added[history->num_added].line = copy;
+    history->added[history->num_added].len = len;
+    history->num_added++;
+
+    // every shell appending to the file takes the lock, so a line and its
+    // offset always go in together
+    if (flock(history->fd, LOCK_EX) != 0) {
+        return -1;
+    }
+    int ret = append_line(history, copy, len + 1);
+    flock(history->fd, LOCK_UN);
+    return ret;
+}
+
+/* gets the number of entries, the oldest one is 0 */
+size_t history_len(history_t *history) {
+    return history->num_mapped + history->num_added;
+}
+
+/*
+ * gets an entry, sets *len to its length, returns pointer, which is not null
+ * terminated, NULL if there is no such entry
+ * the entry stays valid until the history is cleaned up
+ */
+const char *get_history(history_t *history, size_t i, size_t *len) {
+    if (i < history->num_mapped) {
+        size_t start = history->offsets[i];
+        if (start >= history->data_size) {
+            return NULL;
+        }
+        const char *line = history->data + start;
+        const char *newline =
+            (const char *)memchr(line, '\n', history->data_size - start);
+        *len = newline != NULL ? (size_t)(newline - line)
+                               : history->data_size - start;
+        return line;
+    }
+    i -= history->num_mapped;
+    if (i >= history->num_added) {
+        return NULL;
+    }
+    *len = history->added[i].len;
+    return history->added[i].line;
+}
@@ -0,0 +1,37 @@
+#ifndef HISTORY_H_
+#define HISTORY_H_
+
+#include <stddef.h>
+
+typedef struct history history_t;
+
+/*
+ * opens the history file at path and its index at path.idx, creating them if
+ * they don't exist, the entries already in the file are mapped, not read
+ * returns pointer, NULL if the history file can't be opened
+ */
+history_t *init_history(const char *path);
+/*
+ * cleans up the history, the entries stay in the file
+ * Note: this function will free the history pointer
+ * DO NOT use the pointer after this function is called
+ */
+void cleanup_history(history_t *history);
+
+/*
+ * appends a line, which must not have a newline, to the history file and to
+ * the history, returns 0 on success, -1 if it couldn't be written to the file
+ */
+int add_history(history_t *history, const char *line, size_t len);
+
+/* gets the number of entries, the oldest one is 0 */
+size_t history_len(history_t *history);
+
+/*
+ * gets an entry, sets *len to its length, returns pointer, which is not null
+ * terminated, NULL if there is no such entry
+ * the entry stays valid until the history is cleaned up
+ */
+const char *get_history(history_t *history, size_t i, size_t *len);
+
+#endif  // HISTORY_H_
@@ -0,0 +1,215 @@
+#include "./histsearch.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BLOCK_ENTRIES 64       // entries that share a signature
+#define SEGMENT_BLOCKS 64      // blocks in a segment, one bit of a word each
+#define SIGNATURE_BITS 4096    // bits in a signature, a power of two
+#define SIGNATURE_SHIFT 52     // 64 - log2(SIGNATURE_BITS)
+#define MAX_QUERY_GRAMS 32     // most grams of a needle that are looked up
+#define INITIAL_SEGMENTS 16
+
+// the signature of a block is every gram of its entries hashed to one of
+// SIGNATURE_BITS bits, the grams are the trigrams of an entry and its first
+// one and two bytes, anchored to the start
+// the signatures of the SEGMENT_BLOCKS blocks of a segment are stored bit
+// sliced: rows[bit] has bit b set if block b has that bit in its signature,
+// so the blocks that may hold a needle are the AND of one word per gram
+typedef struct segment {
+    uint64_t rows[SIGNATURE_BITS];
+} segment_t;
+
+// segments grow as the history does, entries are indexed in order and never
+// removed, so adding an entry only sets bits
+struct history_search {
+    history_t *history;
+    segment_t **segments;
+    size_t num_segments;
+    size_t max_segments;
+    size_t num_indexed;  // entries indexed so far, the oldest ones
+};
+
+/* hashes a gram, packed into an integer, to a bit of a signature */
+static size_t hash_gram(uint32_t gram) {
+    return (size_t)(((uint64_t)gram * 0x9e3779b97f4a7c15ULL) >> SIGNATURE_SHIFT);
+}
+
+/* packs a trigram */
+static uint32_t trigram(const char *s) {
+    return (uint32_t)(unsigned char)s[0] | (uint32_t)(unsigned char)s[1] << 8 |
+           (uint32_t)(unsigned char)s[2] << 16;
+}
+
+/* packs the anchored gram of the first len bytes, 1 or 2, of an entry */
+static uint32_t anchored(const char *s, size_t len) {
+    uint32_t gram = (uint32_t)(unsigned char)s[0];
+    if (len == 2) {
+        gram |= (uint32_t)(unsigned char)s[1] << 8;
+    }
+    return gram | (uint32_t)len << 24;
+}
+
+/*
+ * initializes a search index over a history, nothing is indexed until the
+ * first search, returns pointer
+ */
+history_search_t *init_history_search(history_t *history) {
+    history_search_t *search =
+        (history_search_t *)calloc(1, sizeof(history_search_t));
+    search->history = history;
+    return search;
+}
+
+/*
+ * cleans up the search index, the history is left alone
+ * Note: this function will free the search pointer
+ * DO NOT use the pointer after this function is called
+ */
+void cleanup_history_search(history_search_t *search) {
+    if (search == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < search->num_segments; i++) {
+        free(search->segments[i]);
+    }
+    free(search->segments);
+    free(search);
+}
+
+/* sets the bits of every gram of an entry in the signature of its block */
+static void index_entry(history_search_t *search, size_t entry) {
+    size_t len;
+    const char *line = get_history(search->history, entry, &len);
+    size_t block = entry / BLOCK_ENTRIES;
+    size_t segment = block / SEGMENT_BLOCKS;
+
+    if (segment == search->num_segments) {
+        if (search->num_segments == search->max_segments) {
+            search->max_segments = search->max_segments == 0
+                                       ? INITIAL_SEGMENTS
+                                       : search->max_segments * 2;
+            search->segments = (segment_t **)realloc(
+                search->segments, search->max_segments * sizeof(segment_t *));
+        }
+        search->segments[search->num_segments++] =
+            (segment_t *)calloc(1, sizeof(segment_t));
+    }
+    if (line == NULL || len == 0) {
+        return;
+    }
+
+    uint64_t *rows = search->segments[segment]->rows;
+    uint64_t bit = 1ULL << (block % SEGMENT_BLOCKS);
+    rows[hash_gram(anchored(line, 1))] |= bit;
+    if (len >= 2) {
+        rows[hash_gram(anchored(line, 2))] |= bit;
+    }
+    for (size_t i = 0; i + 3 <= len; i++) {
+        rows[hash_gram(trigram(line + i))] |= bit;
+    }
+}
+
+/* indexes the entries added to the history since the last search */
+static void update_index(history_search_t *search) {
+    size_t total = history_len(search->history);
+    while (search->num_indexed < total) {
+        index_entry(search, search->num_indexed++);
+    }
+}
+
+/* checks an entry, returns non-zero if it matches the needle */
+static int matches(history_search_t *search, size_t entry, const char *needle,
+                   size_t len, int prefix) {
+    size_t line_len;
+    const char *line = get_history(search->history, entry, &line_len);
+    if (line == NULL) {
+        return 0;
+    }
+    if (prefix) {
+        return line_len > len && !memcmp(line, needle, len);
+    }
+    return memmem(line, line_len, needle, len) != NULL;
+}
+
+/*
+ * finds the newest entry before entry number before that matches, checking
+ * only the blocks whose signature has the bit of every gram
+ * returns the entry number, -1 if no entry matches
+ */
+static long find(history_search_t *search, const char *needle, size_t len,
+                 size_t before, int prefix) {
+    size_t grams[MAX_QUERY_GRAMS];
+    size_t num_grams = 0;
+
+    update_index(search);
+    if (before > search->num_indexed) {
+        before = search->num_indexed;
+    }
+
+    if (prefix && len > 0) {
+        grams[num_grams++] = hash_gram(anchored(needle, len < 2 ? len : 2));
+    }
+    // from the end, what was typed last tells entries apart best, and a
+    // long needle's first trigrams matter less once the rest are in
+    for (size_t i = len >= 3 ? len - 2 : 0; i-- > 0 && num_grams < MAX_QUERY_GRAMS;) {
+        grams[num_grams++] = hash_gram(trigram(needle + i));
+    }
+
+    // a needle too short for any gram matches most entries anyway
+    if (num_grams == 0) {
+        for (size_t entry = before; entry-- > 0;) {
+            if (matches(search, entry, needle, len, prefix)) {
+                return (long)entry;
+            }
+        }
+        return -1;
+    }
+
+    size_t last_block = before == 0 ? 0 : (before - 1) / BLOCK_ENTRIES;
+    for (size_t segment = before == 0 ? 0 : last_block / SEGMENT_BLOCKS + 1;
+         segment-- > 0;) {
+        const uint64_t *rows = search->segments[segment]->rows;
+        uint64_t candidates = ~0ULL;
+        for (size_t i = 0; i < num_grams && candidates != 0; i++) {
+            candidates &= rows[grams[i]];
+        }
+
+        // newest block first
+        while (candidates != 0) {
+            int bit = 63 - __builtin_clzll(candidates);
+            candidates &= ~(1ULL << bit);
+            size_t first = (segment * SEGMENT_BLOCKS + (size_t)bit) * BLOCK_ENTRIES;
+            size_t end = first + BLOCK_ENTRIES < before ? first + BLOCK_ENTRIES
+                                                        : before;
+            for (size_t entry = end; entry-- > first;) {
+                if (matches(search, entry, needle, len, prefix)) {
+                    return (long)entry;
+                }
+            }
+        }
+    }
+    return -1;
+}
+
+/*
+ * finds the newest entry before entry number before that contains needle,
+ * like a reverse incremental search does, searching again before the entry
+ * it found gets the next older one, entries added to the history since the
+ * last search are indexed first
+ * returns the entry number, -1 if no entry matches
+ */
+long search_history(history_search_t *search, const char *needle, size_t len,
+                    size_t before) {
+    return find(search, needle, len, before, 0);
+}
+
+/*
+ * finds the newest entry before entry number before that starts with prefix
+ * and is longer than it, which is what an autosuggestion completes a line to
+ * returns the entry number, -1 if no entry matches
+ */
+long search_history_prefix(history_search_t *search, const char *prefix,
+                           size_t len, size_t before) {
+    return find(search, prefix, len, before, 1);
+}
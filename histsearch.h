@@ -0,0 +1,39 @@
+#ifndef HISTSEARCH_H_
+#define HISTSEARCH_H_
+
+#include <stddef.h>
+#include "./history.h"
+
+typedef struct history_search history_search_t;
+
+/*
+ * initializes a search index over a history, nothing is indexed until the
+ * first search, returns pointer
+ */
+history_search_t *init_history_search(history_t *history);
+/*
+ * cleans up the search index, the history is left alone
+ * Note: this function will free the search pointer
+ * DO NOT use the pointer after this function is called
+ */
+void cleanup_history_search(history_search_t *search);
+
+/*
+ * finds the newest entry before entry number before that contains needle,
+ * like a reverse incremental search does, searching again before the entry
+ * it found gets the next older one, entries added to the history since the
+ * last search are indexed first
+ * returns the entry number, -1 if no entry matches
+ */
+long search_history(history_search_t *search, const char *needle, size_t len,
+                    size_t before);
+
+/*
+ * finds the newest entry before entry number before that starts with prefix
+ * and is longer than it, which is what an autosuggestion completes a line to
+ * returns the entry number, -1 if no entry matches
+ */
+long search_history_prefix(history_search_t *search, const char *prefix,
+                           size_t len, size_t before);
+
+#endif  // HISTSEARCH_H_
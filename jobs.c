@@ -1,31 +1,248 @@
 #include "./jobs.h"
 #include <signal.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+
+#define INITIAL_PROCESSES 4
+#define INITIAL_SLOTS 64  // a multiple of 64, so the bitmap is whole words
+#define INITIAL_PID_BUCKETS 128
+#define WORD_BITS 64
+
+// one process of a job, status is the last status waitpid() returned for it
+struct job_process {
+    pid_t pid;
+    process_state_t state;
+    int status;
+};
+typedef struct job_process job_process_t;
 
+// pid is the job's first process and its process group
+// state is worked out from the processes, reported is the state the user was
+// last told about
 struct job_element {
     int jid;
     pid_t pid;
     process_state_t state;
+    process_state_t reported;
     char *command;
-    struct job_element *next;
+    job_process_t *processes;
+    int num_processes;
+    int max_processes;
+    struct rusage usage;      // summed over the processes that terminated
+    struct timespec started;  // CLOCK_MONOTONIC time the job was added
 };
 typedef struct job_element job_element_t;
 
-// head is the head of the list
-// current is the current element being iterated over
+// where a process lives, the JID of its job and its index in the job's
+// processes, pid is 0 for an empty bucket
+struct pid_entry {
+    pid_t pid;
+    int jid;
+    int index;
+};
+typedef struct pid_entry pid_entry_t;
+
+// slots[jid] is the job with that JID, NULL if the JID is free, slot 0 is
+// never used; bit jid of used is set if the JID is taken
+// pids is an open addressing table from every process of every job to its
+// job, with linear probing and no tombstones
+// current is the JID get_next_pid() looks at next
 struct job_list {
-    job_element_t *head;
-    job_element_t *current;
+    job_element_t **slots;
+    uint64_t *used;
+    int num_slots;
+    int max_jid;
+    int current;
+    pid_entry_t *pids;
+    size_t num_pid_buckets;
+    size_t num_pids;
     pid_t shell_pid;
 };
 
+/* multiplicative hash of a PID */
+static size_t hash_pid(pid_t pid) {
+    return (size_t)((uint32_t)pid * 2654435761U);
+}
+
+/* finds the bucket of a PID, returns NULL if the PID isn't in any job */
+static pid_entry_t *find_pid(job_list_t *job_list, pid_t pid) {
+    size_t mask = job_list->num_pid_buckets - 1;
+    size_t slot = hash_pid(pid) & mask;
+    while (job_list->pids[slot].pid != 0) {
+        if (job_list->pids[slot].pid == pid) {
+            return &job_list->pids[slot];
+        }
+        slot = (slot + 1) & mask;
+    }
+    return NULL;
+}
+
+/* puts a PID in the table without checking its size */
+static void place_pid(job_list_t *job_list, pid_entry_t entry) {
+    size_t mask = job_list->num_pid_buckets - 1;
+    size_t slot = hash_pid(entry.pid) & mask;
+    while (job_list->pids[slot].pid != 0 &&
+           job_list->pids[slot].pid != entry.pid) {
+        slot = (slot + 1) & mask;
+    }
+    if (job_list->pids[slot].pid == 0) {
+        job_list->num_pids++;
+    }
+    job_list->pids[slot] = entry;
+}
+
+/* adds a process to the PID table, doubling it once it is half full */
+static void insert_pid(job_list_t *job_list, pid_t pid, int jid, int index) {
+    if ((job_list->num_pids + 1) * 2 > job_list->num_pid_buckets) {
+        pid_entry_t *old = job_list->pids;
+        size_t old_size = job_list->num_pid_buckets;
+
+        job_list->num_pid_buckets = old_size * 2;
+        job_list->pids = (pid_entry_t *)calloc(job_list->num_pid_buckets,
+                                               sizeof(pid_entry_t));
+        job_list->num_pids = 0;
+        for (size_t i = 0; i < old_size; i++) {
+            if (old[i].pid != 0) {
+                place_pid(job_list, old[i]);
+            }
+        }
+        free(old);
+    }
+
+    pid_entry_t entry = {pid, jid, index};
+    place_pid(job_list, entry);
+}
+
+/*
+ * removes a process of the job with the given JID from the PID table, shifting
+ * back the entries after it so that no probe sequence is broken, the PID is
+ * left alone if it was reused by another job
+ */
+static void delete_pid(job_list_t *job_list, pid_t pid, int jid) {
+    pid_entry_t *entry = find_pid(job_list, pid);
+    if (entry == NULL || entry->jid != jid) {
+        return;
+    }
+
+    size_t mask = job_list->num_pid_buckets - 1;
+    size_t hole = (size_t)(entry - job_list->pids);
+    size_t next = hole;
+    job_list->pids[hole].pid = 0;
+    job_list->num_pids--;
+
+    while (1) {
+        next = (next + 1) & mask;
+        if (job_list->pids[next].pid == 0) {
+            return;
+        }
+
+        // an entry can only move back if its home bucket isn't between the
+        // hole and where it is now
+        size_t home = hash_pid(job_list->pids[next].pid) & mask;
+        int stays = hole <= next ? (hole < home && home <= next)
+                                 : (hole < home || home <= next);
+        if (!stays) {
+            job_list->pids[hole] = job_list->pids[next];
+            job_list->pids[next].pid = 0;
+            hole = next;
+        }
+    }
+}
+
+/* grows the slots and the bitmap until jid fits, doubling them */
+static void ensure_slots(job_list_t *job_list, int jid) {
+    if (jid < job_list->num_slots) {
+        return;
+    }
+
+    int num_slots = job_list->num_slots;
+    while (jid >= num_slots) {
+        num_slots *= 2;
+    }
+    job_list->slots = (job_element_t **)realloc(
+        job_list->slots, sizeof(job_element_t *) * (size_t)num_slots);
+    job_list->used = (uint64_t *)realloc(
+        job_list->used, sizeof(uint64_t) * (size_t)(num_slots / WORD_BITS));
+
+    memset(job_list->slots + job_list->num_slots, 0,
+           sizeof(job_element_t *) * (size_t)(num_slots - job_list->num_slots));
+    memset(job_list->used + job_list->num_slots / WORD_BITS, 0,
+           sizeof(uint64_t) *
+               (size_t)((num_slots - job_list->num_slots) / WORD_BITS));
+    job_list->num_slots = num_slots;
+}
+
+/*
+ * works out a job's state from its processes: TERMINATED once all of them
+ * are, STOPPED once none of them is running, RUNNING otherwise
+ */
+static void update_state(job_element_t *job) {
+    int stopped = 0;
+    for (int i = 0; i < job->num_processes; i++) {
+        if (job->processes[i].state == RUNNING) {
+            job->state = RUNNING;
+            return;
+        }
+        if (job->processes[i].state == STOPPED) {
+            stopped = 1;
+        }
+    }
+    job->state = stopped ? STOPPED : TERMINATED;
+}
+
+/* finds the job with the given JID, returns NULL if there is none */
+static job_element_t *find_job_jid(job_list_t *job_list, int jid) {
+    if (jid <= 0 || jid >= job_list->num_slots) {
+        return NULL;
+    }
+    return job_list->slots[jid];
+}
+
+/*
+ * finds the process with the given PID in any job, setting job to the job it
+ * belongs to, returns NULL if there is none
+ */
+static job_process_t *find_process(job_list_t *job_list, pid_t pid,
+                                   job_element_t **job) {
+    pid_entry_t *entry = find_pid(job_list, pid);
+    if (entry == NULL) {
+        return NULL;
+    }
+    *job = job_list->slots[entry->jid];
+    return &(*job)->processes[entry->index];
+}
+
+/* frees a job element and everything it owns */
+static void free_job(job_element_t *job) {
+    if (job->command != NULL) {
+        free(job->command);
+        job->command = NULL;
+    }
+    free(job->processes);
+    free(job);
+}
+
 /* initializes job list, returns pointer */
 job_list_t *init_job_list() {
     job_list_t *job_list = (job_list_t *)malloc(sizeof(job_list_t));
-    job_list->head = NULL;
-    job_list->current = NULL;
+    job_list->slots =
+        (job_element_t **)calloc(INITIAL_SLOTS, sizeof(job_element_t *));
+    job_list->used =
+        (uint64_t *)calloc(INITIAL_SLOTS / WORD_BITS, sizeof(uint64_t));
+    job_list->used[0] = 1;  // JIDs start at 1
+    job_list->num_slots = INITIAL_SLOTS;
+    job_list->max_jid = 0;
+    job_list->current = 1;
+    job_list->pids =
+        (pid_entry_t *)calloc(INITIAL_PID_BUCKETS, sizeof(pid_entry_t));
+    job_list->num_pid_buckets = INITIAL_PID_BUCKETS;
+    job_list->num_pids = 0;
     job_list->shell_pid = getpid();
     return job_list;
 }
@@ -40,9 +257,11 @@ void cleanup_job_list(job_list_t *job_list) {
         return;
     }
 
-    job_element_t *cur = job_list->head;
-    while (cur != NULL) {
-        job_element_t *nextElement = cur->next;
+    for (int i = 1; i <= job_list->max_jid; i++) {
+        job_element_t *cur = job_list->slots[i];
+        if (cur == NULL) {
+            continue;
+        }
 
         // if we are cleaning up the shell's job list and not a child's
         if (getpid() == job_list->shell_pid) {
@@ -52,27 +271,50 @@ void cleanup_job_list(job_list_t *job_list) {
             }
         }
 
-        if (cur->command != NULL) {
-            free(cur->command);
-            cur->command = NULL;
-        }
-
-        free(cur);
-        cur = nextElement;
+        free_job(cur);
     }
 
-    job_list->head = NULL;
-    job_list->current = NULL;
+    free(job_list->slots);
+    free(job_list->used);
+    free(job_list->pids);
+    job_list->slots = NULL;
+    job_list->used = NULL;
+    job_list->pids = NULL;
     job_list->shell_pid = 0;
 
     free(job_list);
 }
 
-/* adds new job to list, returns 0 on success, -1 on failure */
+/* gets the lowest JID that isn't in use, returns the JID on success, -1 on failure */
+int get_next_jid(job_list_t *job_list) {
+    if (job_list == NULL) {
+        return -1;
+    }
+
+    int num_words = job_list->num_slots / WORD_BITS;
+    for (int i = 0; i < num_words; i++) {
+        if (job_list->used[i] != UINT64_MAX) {
+            return i * WORD_BITS + __builtin_ctzll(~job_list->used[i]);
+        }
+    }
+    // every slot is taken, add_job() grows the table
+    return job_list->num_slots;
+}
+
+/*
+ * adds new job to list, in the slot of its JID
+ * returns 0 on success, -1 on failure or if the JID is taken
+ */
 int add_job(job_list_t *job_list, int jid, pid_t pid, process_state_t state,
             char *command) {
     if (job_list == NULL || (state != RUNNING && state != STOPPED) ||
-        command == NULL) {
+        command == NULL || jid <= 0) {
+        return -1;
+    }
+
+    // each JID belongs to one job at a time
+    ensure_slots(job_list, jid);
+    if (job_list->slots[jid] != NULL) {
         return -1;
     }
 
@@ -82,26 +324,65 @@ int add_job(job_list_t *job_list, int jid, pid_t pid, process_state_t state,
 
     // allocate new char*'s and copy buffers in to protect our code
     new->state = state;
+    new->reported = state;
+
+    // the first process of the job
+    new->processes =
+        (job_process_t *)malloc(sizeof(job_process_t) * INITIAL_PROCESSES);
+    new->max_processes = INITIAL_PROCESSES;
+    new->num_processes = 1;
+    new->processes[0].pid = pid;
+    new->processes[0].state = state;
+    new->processes[0].status = 0;
+
+    memset(&new->usage, 0, sizeof(new->usage));
+    clock_gettime(CLOCK_MONOTONIC, &new->started);
 
     size_t cmdlen = strlen(command);
     new->command = (char *)malloc(sizeof(char) * (cmdlen + 1));
     memcpy(new->command, command, cmdlen);
     new->command[cmdlen] = 0;
-    new->next = NULL;
 
-    if (job_list->head == NULL) {
-        // add to head
-        job_list->head = new;
-        job_list->current = new;
-    } else {
-        // add to tail
-        job_element_t *cur = job_list->head;
-        while (cur->next != NULL) {
-            cur = cur->next;
-        }
-        cur->next = new;
+    // the job goes in its JID's slot
+    job_list->slots[jid] = new;
+    job_list->used[jid / WORD_BITS] |= (uint64_t)1 << (jid % WORD_BITS);
+    if (jid > job_list->max_jid) {
+        job_list->max_jid = jid;
+    }
+    insert_pid(job_list, pid, jid, 0);
+
+    return 0;
+}
+
+/*
+ * adds another process to a job, given job's JID
+ * the PID given to add_job() is the job's first process
+ * returns 0 on success, -1 on failure
+ */
+int add_job_process(job_list_t *job_list, int jid, pid_t pid,
+                    process_state_t state) {
+    if (job_list == NULL || (state != RUNNING && state != STOPPED)) {
+        return -1;
+    }
+
+    job_element_t *job = find_job_jid(job_list, jid);
+    if (job == NULL) {
+        return -1;
     }
 
+    if (job->num_processes == job->max_processes) {
+        job->max_processes *= 2;
+        job->processes = (job_process_t *)realloc(
+            job->processes,
+            sizeof(job_process_t) * (size_t)job->max_processes);
+    }
+    job_process_t *process = &job->processes[job->num_processes];
+    process->pid = pid;
+    process->state = state;
+    process->status = 0;
+    insert_pid(job_list, pid, jid, job->num_processes);
+    job->num_processes++;
+    update_state(job);
     return 0;
 }
 
@@ -112,148 +393,224 @@ int remove_job_jid(job_list_t *job_list, int jid) {
         return -1;
     }
 
-    job_element_t *prev = NULL;
-    job_element_t *cur = job_list->head;
-    while (cur != NULL) {
-        if (cur->jid == jid) {
-            if (prev != NULL) {
-                prev->next = cur->next;
-            }
-            if (job_list->head == cur) {
-                job_list->head = cur->next;
-            }
-            if (job_list->current == cur) {
-                job_list->current = cur->next;
-            }
-
-            if (cur->command != NULL) {
-                free(cur->command);
-                cur->command = NULL;
-            }
-
-            free(cur);
-            cur = NULL;
-
-            return 0;
-        }
+    job_element_t *job = find_job_jid(job_list, jid);
+    if (job == NULL) {
+        return -1;
+    }
 
-        prev = cur;
-        cur = cur->next;
+    for (int i = 0; i < job->num_processes; i++) {
+        delete_pid(job_list, job->processes[i].pid, jid);
+    }
+    job_list->slots[jid] = NULL;
+    job_list->used[jid / WORD_BITS] &= ~((uint64_t)1 << (jid % WORD_BITS));
+    while (job_list->max_jid > 0 &&
+           job_list->slots[job_list->max_jid] == NULL) {
+        job_list->max_jid--;
     }
 
-    return -1;
+    free_job(job);
+    return 0;
 }
 
-/* removes job from list, given job's PID,
+/* removes job from list, given the PID of any of its processes,
     returns 0 on success, -1 on failure */
 int remove_job_pid(job_list_t *job_list, pid_t pid) {
     if (job_list == NULL) {
         return -1;
     }
 
-    job_element_t *prev = NULL;
-    job_element_t *cur = job_list->head;
-    while (cur != NULL) {
-        if (cur->pid == pid) {
-            if (prev != NULL) {
-                prev->next = cur->next;
-            }
-            if (job_list->head == cur) {
-                job_list->head = cur->next;
-            }
-            if (job_list->current == cur) {
-                job_list->current = cur->next;
-            }
+    job_element_t *job;
+    if (find_process(job_list, pid, &job) == NULL) {
+        return -1;
+    }
+    return remove_job_jid(job_list, job->jid);
+}
 
-            if (cur->command != NULL) {
-                free(cur->command);
-                cur->command = NULL;
-            }
-            free(cur);
-            cur = NULL;
+/*
+ * updates the state of every process of a job that hasn't terminated,
+ * given job's JID, returns 0 on success, -1 on failure
+ */
+int update_job_jid(job_list_t *job_list, int jid, process_state_t state) {
+    if (job_list == NULL) {
+        return -1;
+    }
+
+    job_element_t *job = find_job_jid(job_list, jid);
+    if (job == NULL) {
+        return -1;
+    }
 
-            return 0;
+    for (int i = 0; i < job->num_processes; i++) {
+        if (job->processes[i].state != TERMINATED) {
+            job->processes[i].state = state;
         }
+    }
+    update_state(job);
+    return 0;
+}
+
+/*
+ * updates the state of one process of a job, given the process's PID,
+ * returns 0 on success, -1 on failure
+ */
+int update_job_pid(job_list_t *job_list, pid_t pid, process_state_t state) {
+    if (job_list == NULL) {
+        return -1;
+    }
 
-        prev = cur;
-        cur = cur->next;
+    job_element_t *job;
+    job_process_t *process = find_process(job_list, pid, &job);
+    if (process == NULL) {
+        return -1;
     }
 
-    return -1;
+    process->state = state;
+    update_state(job);
+    return 0;
 }
 
-/* updates job's state, given job's JID, returns 0 on success, -1 on failure */
-int update_job_jid(job_list_t *job_list, int jid, process_state_t state) {
+/* adds the resources one process used to the job's total */
+static void add_usage(struct rusage *total, const struct rusage *usage) {
+    timeradd(&total->ru_utime, &usage->ru_utime, &total->ru_utime);
+    timeradd(&total->ru_stime, &usage->ru_stime, &total->ru_stime);
+    // the job needed as much memory as its biggest process
+    if (usage->ru_maxrss > total->ru_maxrss) {
+        total->ru_maxrss = usage->ru_maxrss;
+    }
+    total->ru_minflt += usage->ru_minflt;
+    total->ru_majflt += usage->ru_majflt;
+    total->ru_inblock += usage->ru_inblock;
+    total->ru_oublock += usage->ru_oublock;
+    total->ru_nvcsw += usage->ru_nvcsw;
+    total->ru_nivcsw += usage->ru_nivcsw;
+}
+
+/*
+ * records a status returned by wait4() for one process of a job, given the
+ * process's PID, and adds the resources it used to the job once it has
+ * terminated, usage may be NULL
+ * returns the job's state on success, -1 on failure
+ * a job is TERMINATED once all of its processes are, STOPPED once none of them
+ * is running, and RUNNING otherwise
+ */
+int update_job_status(job_list_t *job_list, pid_t pid, int wstatus,
+                      const struct rusage *usage) {
     if (job_list == NULL) {
         return -1;
     }
 
-    job_element_t *cur = job_list->head;
-    while (cur != NULL) {
-        if (cur->jid == jid) {
-            cur->state = state;
-            return 0;
+    job_element_t *job;
+    job_process_t *process = find_process(job_list, pid, &job);
+    if (process == NULL) {
+        return -1;
+    }
+
+    if (WIFSTOPPED(wstatus)) {
+        process->state = STOPPED;
+    } else if (WIFCONTINUED(wstatus)) {
+        process->state = RUNNING;
+    } else {
+        process->state = TERMINATED;
+        // a stopped process reports what it used so far, only count it once
+        if (usage != NULL) {
+            add_usage(&job->usage, usage);
         }
+        // once reaped, the kernel may give the PID to a new job while the
+        // rest of this one is still running
+        delete_pid(job_list, pid, job->jid);
+    }
+    process->status = wstatus;
+    update_state(job);
+    return (int)job->state;
+}
 
-        cur = cur->next;
+/* gets state of job, given job's JID, returns the state on success, -1 on failure */
+int get_job_state(job_list_t *job_list, int jid) {
+    if (job_list == NULL) {
+        return -1;
     }
 
-    return -1;
+    job_element_t *job = find_job_jid(job_list, jid);
+    return job == NULL ? -1 : (int)job->state;
 }
 
-/* updates job's state, given job's PID, returns 0 on success, -1 on failure */
-int update_job_pid(job_list_t *job_list, pid_t pid, process_state_t state) {
+/*
+ * gets the waitpid() status of the job's last process, which is the status of
+ * the whole job, given job's JID, returns the status on success, -1 on failure
+ */
+int get_job_status(job_list_t *job_list, int jid) {
     if (job_list == NULL) {
         return -1;
     }
 
-    job_element_t *cur = job_list->head;
-    while (cur != NULL) {
-        if (cur->pid == pid) {
-            cur->state = state;
-            return 0;
-        }
+    job_element_t *job = find_job_jid(job_list, jid);
+    if (job == NULL) {
+        return -1;
+    }
+    return job->processes[job->num_processes - 1].status;
+}
 
-        cur = cur->next;
+/*
+ * gets the resources used by the job's terminated processes, given job's JID,
+ * returns 0 on success, -1 on failure
+ */
+int get_job_usage(job_list_t *job_list, int jid, struct rusage *usage) {
+    if (job_list == NULL) {
+        return -1;
     }
 
-    return -1;
+    job_element_t *job = find_job_jid(job_list, jid);
+    if (job == NULL) {
+        return -1;
+    }
+    *usage = job->usage;
+    return 0;
 }
 
-/* gets PID of job, given job's JID, returns PID on success, -1 on failure */
-pid_t get_job_pid(job_list_t *job_list, int jid) {
+/*
+ * marks the job's current state as reported to the user, given job's JID,
+ * returns the state if it changed since it was last reported, -1 otherwise
+ */
+int report_job_state(job_list_t *job_list, int jid) {
     if (job_list == NULL) {
         return -1;
     }
 
-    job_element_t *cur = job_list->head;
-    while (cur != NULL) {
-        if (cur->jid == jid) {
-            return cur->pid;
-        }
+    job_element_t *job = find_job_jid(job_list, jid);
+    if (job == NULL || job->reported == job->state) {
+        return -1;
+    }
+    job->reported = job->state;
+    return (int)job->state;
+}
 
-        cur = cur->next;
+/*
+ * gets PID of job, which is its first process and its process group,
+ * given job's JID, returns PID on success, -1 on failure
+ */
+pid_t get_job_pid(job_list_t *job_list, int jid) {
+    if (job_list == NULL) {
+        return -1;
     }
 
-    return -1;
+    job_element_t *job = find_job_jid(job_list, jid);
+    return job == NULL ? -1 : job->pid;
 }
 
-/* gets JID of job, given job's PID, returns JID on success, -1 on failure */
+/*
+ * gets JID of job, given the PID of any of its processes that hasn't been
+ * reaped yet, returns JID on success, -1 on failure
+ */
 int get_job_jid(job_list_t *job_list, pid_t pid) {
     if (job_list == NULL) {
         return -1;
     }
 
-    job_element_t *cur = job_list->head;
-    while (cur != NULL) {
-        if (cur->pid == pid) {
-            return cur->jid;
-        }
-
-        cur = cur->next;
+    job_element_t *job;
+    if (find_process(job_list, pid, &job) == NULL) {
+        return -1;
     }
-
-    return -1;
+    return job->jid;
 }
 
 /*
@@ -263,35 +620,89 @@ int get_job_jid(job_list_t *job_list, pid_t pid) {
  * after which it will start at the head of the list again
  */
 pid_t get_next_pid(job_list_t *job_list) {  // circular iterator
+    int jid = get_next_job_jid(job_list);
+    return jid == -1 ? -1 : job_list->slots[jid]->pid;
+}
+
+/*
+ * gets next JID in list, the same way get_next_pid() gets the next PID
+ * returns the JID if there is one, -1 if the end of the list has been reached
+ */
+int get_next_job_jid(job_list_t *job_list) {  // circular iterator
     if (job_list == NULL) {
         return -1;
     }
 
-    if (job_list->current == NULL) {
-        job_list->current = job_list->head;
+    while (job_list->current <= job_list->max_jid &&
+           job_list->slots[job_list->current] == NULL) {
+        job_list->current++;
+    }
+
+    if (job_list->current > job_list->max_jid) {
+        job_list->current = 1;
         return -1;
     } else {
-        pid_t pid = job_list->current->pid;
-        job_list->current = job_list->current->next;
-        return pid;
+        return job_list->current++;
+    }
+}
+
+/* prints the processes of a job and what they used, for jobs -l */
+static int print_job_long(job_element_t *job) {
+    for (int i = 0; i < job->num_processes; i++) {
+        job_process_t *process = &job->processes[i];
+        int ret;
+        if (process->state == RUNNING) {
+            ret = printf("    %d Running\n", process->pid);
+        } else if (process->state == STOPPED) {
+            ret = printf("    %d Stopped\n", process->pid);
+        } else if (WIFSIGNALED(process->status)) {
+            ret = printf("    %d Signal %d\n", process->pid,
+                         WTERMSIG(process->status));
+        } else {
+            ret = printf("    %d Exit %d\n", process->pid,
+                         WEXITSTATUS(process->status));
+        }
+        if (ret < 0) {
+            return -1;
+        }
     }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double elapsed = (double)(now.tv_sec - job->started.tv_sec) +
+                     (double)(now.tv_nsec - job->started.tv_nsec) / 1e9;
+    struct rusage *usage = &job->usage;
+    return printf(
+        "    elapsed %.3fs user %ld.%03lds sys %ld.%03lds maxrss %ldKB "
+        "faults %ld/%ld switches %ld/%ld\n",
+        elapsed, (long)usage->ru_utime.tv_sec,
+        (long)usage->ru_utime.tv_usec / 1000, (long)usage->ru_stime.tv_sec,
+        (long)usage->ru_stime.tv_usec / 1000, usage->ru_maxrss,
+        usage->ru_minflt, usage->ru_majflt, usage->ru_nvcsw,
+        usage->ru_nivcsw);
 }
 
-/* jobs command, prints out the jobs list */
-void jobs(job_list_t *job_list) {
+/*
+ * jobs command, prints out the jobs list, with every process of every job and
+ * the resources used by the ones that terminated if long_format is non-zero
+ */
+void jobs(job_list_t *job_list, int long_format) {
     if (job_list == NULL) {
         return;
     }
 
-    job_element_t *cur = job_list->head;
-    while (cur != NULL) {
+    for (int i = 1; i <= job_list->max_jid; i++) {
+        job_element_t *cur = job_list->slots[i];
+        if (cur == NULL) {
+            continue;
+        }
         char *state_string = cur->state == RUNNING ? "Running" : "Stopped";
         if (printf("[%d] (%d) %s %s\n", cur->jid, cur->pid, state_string,
-                   cur->command) < 0) {
+                   cur->command) < 0 ||
+            (long_format && print_job_long(cur) < 0)) {
             fprintf(stderr, "error printing jobs list\n");
             cleanup_job_list(job_list);
             exit(1);
         }
-        cur = cur->next;
     }
 }
@@ -1,10 +1,11 @@
 #ifndef JOBS_H_
 #define JOBS_H_
 
+#include <sys/resource.h>
 #include <sys/types.h>
 #include <unistd.h>
 
-typedef enum { RUNNING, STOPPED } process_state_t;
+typedef enum { RUNNING, STOPPED, TERMINATED } process_state_t;
 
 typedef struct job_list job_list_t;
 
@@ -17,25 +18,79 @@ job_list_t *init_job_list();
  */
 void cleanup_job_list(job_list_t *job_list);
 
-/* adds new job to list, returns 0 on success, -1 on failure */
+/* gets the lowest JID that isn't in use, returns the JID on success, -1 on failure */
+int get_next_jid(job_list_t *job_list);
+
+/*
+ * adds new job to list, in the slot of its JID
+ * returns 0 on success, -1 on failure or if the JID is taken
+ */
 int add_job(job_list_t *job_list, int jid, pid_t pid, process_state_t state,
             char *command);
 
+/*
+ * adds another process to a job, given job's JID
+ * the PID given to add_job() is the job's first process
+ * returns 0 on success, -1 on failure
+ */
+int add_job_process(job_list_t *job_list, int jid, pid_t pid,
+                    process_state_t state);
+
 /* removes job from list, given job's JID,
         returns 0 on success, -1 on failure */
 int remove_job_jid(job_list_t *job_list, int jid);
-/* removes job from list, given job's PID,
+/* removes job from list, given the PID of any of its processes,
         returns 0 on success, -1 on failure */
 int remove_job_pid(job_list_t *job_list, pid_t pid);
 
-/* updates job's state, given job's JID, returns 0 on success, -1 on failure */
+/*
+ * updates the state of every process of a job that hasn't terminated,
+ * given job's JID, returns 0 on success, -1 on failure
+ */
 int update_job_jid(job_list_t *job_list, int jid, process_state_t state);
-/* updates job's state, given job's PID, returns 0 on success, -1 on failure */
+/*
+ * updates the state of one process of a job, given the process's PID,
+ * returns 0 on success, -1 on failure
+ */
 int update_job_pid(job_list_t *job_list, pid_t pid, process_state_t state);
+/*
+ * records a status returned by wait4() for one process of a job, given the
+ * process's PID, and adds the resources it used to the job once it has
+ * terminated, usage may be NULL
+ * returns the job's state on success, -1 on failure
+ * a job is TERMINATED once all of its processes are, STOPPED once none of them
+ * is running, and RUNNING otherwise
+ */
+int update_job_status(job_list_t *job_list, pid_t pid, int wstatus,
+                      const struct rusage *usage);
 
-/* gets PID of job, given job's JID, returns PID on success, -1 on failure */
+/* gets state of job, given job's JID, returns the state on success, -1 on failure */
+int get_job_state(job_list_t *job_list, int jid);
+/*
+ * gets the waitpid() status of the job's last process, which is the status of
+ * the whole job, given job's JID, returns the status on success, -1 on failure
+ */
+int get_job_status(job_list_t *job_list, int jid);
+/*
+ * gets the resources used by the job's terminated processes, given job's JID,
+ * returns 0 on success, -1 on failure
+ */
+int get_job_usage(job_list_t *job_list, int jid, struct rusage *usage);
+/*
+ * marks the job's current state as reported to the user, given job's JID,
+ * returns the state if it changed since it was last reported, -1 otherwise
+ */
+int report_job_state(job_list_t *job_list, int jid);
+
+/*
+ * gets PID of job, which is its first process and its process group,
+ * given job's JID, returns PID on success, -1 on failure
+ */
 pid_t get_job_pid(job_list_t *job_list, int jid);
-/* gets JID of job, given job's PID, returns JID on success, -1 on failure */
+/*
+ * gets JID of job, given the PID of any of its processes that hasn't been
+ * reaped yet, returns JID on success, -1 on failure
+ */
 int get_job_jid(job_list_t *job_list, pid_t pid);
 
 /*
@@ -45,8 +100,16 @@ int get_job_jid(job_list_t *job_list, pid_t pid);
  * after which it will start at the head of the list again
  */
 pid_t get_next_pid(job_list_t *job_list);
+/*
+ * gets next JID in list, the same way get_next_pid() gets the next PID
+ * returns the JID if there is one, -1 if the end of the list has been reached
+ */
+int get_next_job_jid(job_list_t *job_list);
 
-/* jobs command, prints out the jobs list */
-void jobs(job_list_t *job_list);
+/*
+ * jobs command, prints out the jobs list, with every process of every job and
+ * the resources used by the ones that terminated if long_format is non-zero
+ */
+void jobs(job_list_t *job_list, int long_format);
 
 #endif  // JOBS_H_
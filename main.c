@@ -0,0 +1,197 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "./reader.h"
+#include "./sh.h"
+
+/**
+ * Gets the next line from the line reader, reading more input until a whole
+ * line is in, for the body of a here-document.
+ *
+ * @param data the line reader on standard input
+ * @param len set to the length of the line
+ * @return the line, NULL at the end of input
+ */
+static char *read_more(void *data, size_t *len) {
+    line_reader_t *reader = (line_reader_t *)data;
+    char *line;
+
+    while ((line = next_line(reader, len)) == NULL) {
+        if (line_reader_done(reader) || wait_for_input() != 0 ||
+            fill_line_reader(reader) < 0) {
+            return NULL;
+        }
+    }
+    return line;
+}
+
+/**
+ * Reads lines as they come and runs them, for input that isn't a terminal,
+ * or a terminal the line editor can't be used on.
+ *
+ * @param reader the line reader on standard input
+ */
+static void read_lines(line_reader_t *reader) {
+    char *line;
+    size_t len;
+
+    // show prompt initially when the program first runs:
+    print_prompt();
+
+    // REPL, keep reading input till there is no more
+    while (!line_reader_done(reader)) {
+        // run every complete line that was read
+        while ((line = next_line(reader, &len)) != NULL) {
+            remember_line(line, len);
+            run_line(line, read_more, reader);
+
+            //reaping, and printing what happened to background jobs since the last prompt
+            reap_children();
+            flush_notifications();
+
+            // shows prompt
+            print_prompt();
+        }
+
+        if (wait_for_input() != 0) {
+            break;
+        }
+        uint64_t start = stats_now(stats);
+        ssize_t filled = fill_line_reader(reader);
+        record_stat(stats, STAT_READ, start);
+        if (filled < 0) {
+            break;
+        }
+    }
+}
+
+/**
+ * Lets the user type the next line of a here-document's body into the line
+ * editor, after a "> " prompt.
+ *
+ * @param data unused
+ * @param len set to the length of the line
+ * @return the line, NULL at the end of input
+ */
+static char *edit_more(void *data, size_t *len) {
+    (void)data;
+    editor_start(editor, HERE_PROMPT);
+    while (editor_pending(editor) || wait_for_input() == 0) {
+        int ret = editor_read(editor);
+        if (ret == EDITOR_EOF) {
+            break;
+        }
+        if (ret == EDITOR_MORE) {
+            continue;
+        }
+        editor_stop(editor);
+        return editor_line(editor, len);
+    }
+    editor_stop(editor);
+    return NULL;
+}
+
+/**
+ * Lets the user type lines into the line editor and runs them. The terminal
+ * is only in raw mode while a line is typed, editor_stop() gives it back
+ * before the line runs, so commands get it as they expect it.
+ */
+static void edit_lines() {
+    char *line;
+    size_t len;
+
+    editor_start(editor, PROMPT_TEXT);
+    while (editor_pending(editor) || wait_for_input() == 0) {
+        uint64_t start = stats_now(stats);
+        int ret = editor_read(editor);
+        record_stat(stats, STAT_READ, start);
+        if (ret == EDITOR_EOF) {
+            break;
+        }
+        if (ret == EDITOR_MORE) {
+            continue;
+        }
+
+        editor_stop(editor);
+        line = editor_line(editor, &len);
+        remember_line(line, len);
+        run_line(line, edit_more, NULL);
+        reap_children();
+        flush_notifications();
+        editor_start(editor, PROMPT_TEXT);
+    }
+    editor_stop(editor);
+}
+
+/**
+ * The main() function is responsible for reading user input through the REPL,
+ * and showing the 33sh prompt. Input is read through a line reader, so a read
+ * that returns several lines runs all of them in order, a line that is split
+ * across reads is put back together, and lines can be any length.
+ *
+ * @return 0 if no error
+ */
+int main() {
+    line_reader_t *reader = init_line_reader(STDIN_FILENO);
+
+    init_ignoring_signal();
+    init_builtins();
+    job_list = init_job_list();
+    line_arena = init_arena(ARENA_SIZE);
+    pathexp = init_pathexp();
+    vars = init_vars();
+    set_number_var("?", 0);
+    set_number_var("$", getpid());
+
+    // the environment becomes exported variables, and from now on environ is
+    // the cached environment they keep up to date
+    import_env(vars, environ);
+    environ = get_envp(vars);
+
+    // the lines of earlier sessions are mapped, not read, so this is quick,
+    // and nothing is indexed for searching until the first search
+    history = open_history();
+    if (history != NULL) {
+        history_search = init_history_search(history);
+    }
+
+    // SH33_LAUNCH=fork switches back to the fork() launch path
+    char *launch = getenv(LAUNCH_ENV);
+    use_spawn = !(launch != NULL && !strcmp(launch, "fork"));
+
+    // SH33_HASH_FDS keeps an O_PATH handle for every command found in PATH
+    cmd_hash = init_cmd_hash();
+    set_cmd_hash_fds(cmd_hash, getenv(HASH_FDS_ENV) != NULL);
+
+    // SH33_NOTIFY prints job changes as soon as they happen
+    notify_now = getenv(NOTIFY_ENV) != NULL;
+
+    // SH33_STATS times every phase of running a command, see write_stats()
+    if (getenv(STATS_ENV) != NULL) {
+        stats = init_stats();
+    }
+    init_events();
+
+    // on a terminal, lines are typed into the line editor, otherwise they are
+    // read as they come
+    editor = open_editor();
+    if (editor != NULL) {
+        edit_lines();
+    } else {
+        read_lines(reader);
+    }
+    cleanup_line_reader(reader);
+    cleanup_job_list(job_list);
+    cleanup_cmd_hash(cmd_hash);
+    cleanup_arena(line_arena);
+    cleanup_pathexp(pathexp);
+    cleanup_editor(editor);
+    cleanup_completion(completion);
+    cleanup_vars(vars);
+    cleanup_history_search(history_search);
+    cleanup_history(history);
+    write_stats();
+    free(notifications);
+    free(capture);
+    return 0;
+}
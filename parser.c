@@ -0,0 +1,702 @@
+#include "./parser.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+
+#define INITIAL_WORDS 8
+#define INITIAL_COMMANDS 4
+#define INITIAL_ASSIGNMENTS 4
+#define MAX_WILDCARDS 32  // unquoted wildcards of a word that are told apart
+
+/* checks for the characters that separate words */
+static int is_blank(char c) { return c == ' ' || c == '\t' || c == '\n'; }
+
+/* checks for the characters that end a word even without a blank before them */
+static int is_operator(char c) {
+    return c == '|' || c == '&' || c == '<' || c == '>';
+}
+
+/*
+ * checks for the characters a word keeps as they are, a switch so that it is
+ * one jump for the plain characters of every word
+ */
+static int is_plain(char c) {
+    switch (c) {
+        case '\0': case ' ': case '\t': case '\n':
+        case '|': case '&': case '<': case '>':
+        case '\'': case '"': case '\\': case '$':
+        case '*': case '?': case '[':
+            return 0;
+        default:
+            return 1;
+    }
+}
+
+// a word being scanned, it is written over the line itself, which works
+// since unquoting only makes it shorter, until an expansion doesn't fit in
+// what has been read of the line so far, then it moves to the arena
+typedef struct word {
+    char *start;
+    char *out;    // where the next character goes
+    char *limit;  // end of its room in the arena, NULL while it is in the line
+    int quoted;   // non-zero if it had quotes or backslashes
+    int expanded; // non-zero if it had expansions
+    size_t wildcards[MAX_WILDCARDS];  // where its unquoted *, ? and [ are
+    int num_wildcards;  // how many it has, which may be more than are kept
+} word_t;
+
+/*
+ * makes room for n more characters in the word, in is how far the line has
+ * been read, the word moves to the arena if it would get ahead of it
+ */
+static void reserve(arena_t *arena, word_t *word, const char *in, size_t n) {
+    if (word->limit == NULL ? word->out + n <= in : word->out + n <= word->limit) {
+        return;
+    }
+    size_t len = (size_t)(word->out - word->start);
+    size_t size = (len + n) * 2;
+    // one more for the null at the end
+    char *start = (char *)arena_alloc(arena, size + 1);
+    memcpy(start, word->start, len);
+    word->start = start;
+    word->out = start + len;
+    word->limit = start + size;
+}
+
+/* appends n characters to the word, in is how far the line has been read */
+static void put(arena_t *arena, word_t *word, const char *in, const char *src,
+                size_t n) {
+    reserve(arena, word, in, n);
+    memcpy(word->out, src, n);
+    word->out += n;
+}
+
+/*
+ * appends the character just read to the word, in is how far the line has
+ * been read, in the line it always fits
+ */
+static void put_char(arena_t *arena, word_t *word, const char *in, char c) {
+    if (word->limit != NULL) {
+        reserve(arena, word, in, 1);
+    }
+    *word->out++ = c;
+}
+
+/*
+ * checks for the parameters whose name is one character that isn't a name, $?,
+ * $$ and $!, and the positional parameters $0 to $9, which are never set
+ */
+static int is_special(char c) {
+    return c == '?' || c == '$' || c == '!' || (c >= '0' && c <= '9');
+}
+
+/*
+ * finds the ) that closes a $( whose command starts at in, skipping the
+ * parentheses, quotes and backslashes in it, returns pointer, NULL if there is none
+ */
+static char *find_close(char *in) {
+    int depth = 1;
+    for (; *in != '\0'; in++) {
+        if (*in == '\\' && in[1] != '\0') {
+            in++;
+        } else if (*in == '\'') {
+            in = strchr(in + 1, '\'');
+            if (in == NULL) {
+                return NULL;
+            }
+        } else if (*in == '"') {
+            for (in++; *in != '"'; in++) {
+                if (*in == '\0') {
+                    return NULL;
+                }
+                if (*in == '\\' && in[1] != '\0') {
+                    in++;
+                }
+            }
+        } else if (*in == '(') {
+            depth++;
+        } else if (*in == ')' && --depth == 0) {
+            return in;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * runs the $(...) at *cursor and puts its output into the word, without the
+ * newlines at its end, the command is copied first since parsing it changes it
+ * returns 0 on success, -1 on a syntax error, in it too, which is printed
+ */
+static int substitute_command(char **cursor, arena_t *arena, substitute_t substitute,
+                              word_t *word) {
+    char *start = *cursor + 2;
+    char *end = find_close(start);
+    char *output;
+    size_t len;
+
+    if (end == NULL) {
+        fprintf(stderr, "syntax error: unterminated command substitution\n");
+        return -1;
+    }
+    if (substitute == NULL) {
+        fprintf(stderr, "syntax error: command substitution isn't supported here\n");
+        return -1;
+    }
+    size_t command_len = (size_t)(end - start);
+    char *command = (char *)arena_alloc(arena, command_len + 1);
+    memcpy(command, start, command_len);
+    command[command_len] = '\0';
+
+    *cursor = end + 1;
+    word->expanded = 1;
+    if (substitute(command, &output, &len) != 0) {
+        return -1;
+    }
+    while (len > 0 && output[len - 1] == '\n') {
+        len--;
+    }
+    if (len > 0) {
+        put(arena, word, *cursor, output, len);
+    }
+    return 0;
+}
+
+/*
+ * expands the parameter or the command substitution at *cursor, which is a
+ * $, into the word, a $ that doesn't start either is kept as it is, an unset
+ * variable is empty
+ * returns 0 on success, -1 on a syntax error, which is printed
+ */
+static int expand(char **cursor, arena_t *arena, vars_t *vars, substitute_t substitute,
+                  word_t *word) {
+    char *in = *cursor + 1;
+    char *name = in;
+    size_t len;
+
+    if (*in == '(') {
+        return substitute_command(cursor, arena, substitute, word);
+    }
+    if (*in == '{') {
+        name = in + 1;
+        len = is_special(*name) ? 1 : var_name_len(name);
+        if (len == 0 || name[len] != '}') {
+            fprintf(stderr, "syntax error: bad substitution\n");
+            return -1;
+        }
+        in = name + len + 1;
+    } else if (is_special(*in)) {
+        len = 1;
+        in++;
+    } else {
+        len = var_name_len(name);
+        in += len;
+    }
+
+    *cursor = in;
+    if (len == 0) {
+        put(arena, word, in, "$", 1);
+        return 0;
+    }
+
+    size_t value_len;
+    const char *value = get_var(vars, name, len, &value_len);
+    if (value != NULL) {
+        put(arena, word, in, value, value_len);
+    }
+    word->expanded = 1;
+    return 0;
+}
+
+/*
+ * unquotes and expands the word that starts at *cursor into word, moving the
+ * characters it keeps to the front, and sets *cursor to the character after
+ * the word, word->out is where the word ends, which is not terminated yet
+ * returns 0 on success, -1 on a syntax error, which is printed
+ */
+static int scan_word(char **cursor, arena_t *arena, vars_t *vars,
+                     substitute_t substitute, word_t *word) {
+    char *in = *cursor;
+    char c;
+    word->start = in;
+    word->limit = NULL;
+    word->quoted = 0;
+    word->expanded = 0;
+    word->num_wildcards = 0;
+
+    // the plain characters before anything is unquoted or expanded are
+    // already where they belong, most words are only those
+    while (is_plain(*in)) {
+        in++;
+    }
+    word->out = in;
+
+    while (*in != '\0' && !is_blank(*in) && !is_operator(*in)) {
+        if (*in == '\'') {
+            // everything up to the closing quote is kept as it is
+            word->quoted = 1;
+            in++;
+            while (*in != '\'') {
+                if (*in == '\0') {
+                    fprintf(stderr, "syntax error: unterminated quote\n");
+                    return -1;
+                }
+                c = *in++;
+                put_char(arena, word, in, c);
+            }
+            in++;
+        } else if (*in == '"') {
+            // a backslash only escapes what still means something in quotes
+            word->quoted = 1;
+            in++;
+            while (*in != '"') {
+                if (*in == '\0') {
+                    fprintf(stderr, "syntax error: unterminated quote\n");
+                    return -1;
+                }
+                if (*in == '$') {
+                    if (expand(&in, arena, vars, substitute, word) != 0) {
+                        return -1;
+                    }
+                    continue;
+                }
+                if (*in == '\\' && (in[1] == '"' || in[1] == '\\' ||
+                                    in[1] == '$' || in[1] == '`')) {
+                    in++;
+                }
+                c = *in++;
+                put_char(arena, word, in, c);
+            }
+            in++;
+        } else if (*in == '\\') {
+            // the next character is kept as it is, a backslash at the end of
+            // the line is dropped
+            word->quoted = 1;
+            in++;
+            if (*in != '\0') {
+                c = *in++;
+                put_char(arena, word, in, c);
+            }
+        } else if (*in == '$') {
+            if (expand(&in, arena, vars, substitute, word) != 0) {
+                return -1;
+            }
+        } else {
+            c = *in++;
+            if (c == '*' || c == '?' || c == '[') {
+                if (word->num_wildcards < MAX_WILDCARDS) {
+                    word->wildcards[word->num_wildcards] = (size_t)(word->out - word->start);
+                }
+                word->num_wildcards++;
+            }
+            put_char(arena, word, in, c);
+        }
+    }
+
+    *cursor = in;
+    return 0;
+}
+
+/*
+ * makes the pattern of a word with unquoted wildcards, which has a backslash
+ * before every *, ?, [ and \ that was quoted or expanded, so that only the
+ * unquoted ones are wildcards, past MAX_WILDCARDS all of them are
+ * returns pointer, the word itself if nothing in it was quoted or expanded
+ */
+static char *make_pattern(arena_t *arena, const word_t *word) {
+    if (!word->quoted && !word->expanded) {
+        return word->start;
+    }
+    size_t len = (size_t)(word->out - word->start);
+    char *pattern = (char *)arena_alloc(arena, len * 2 + 1);
+    size_t out = 0;
+    int next = 0;
+    for (size_t i = 0; i < len; i++) {
+        char c = word->start[i];
+        if (next < word->num_wildcards && next < MAX_WILDCARDS &&
+            word->wildcards[next] == i) {
+            next++;
+        } else if ((c == '*' || c == '?' || c == '[' || c == '\\') &&
+                   (next < MAX_WILDCARDS || c == '\\')) {
+            pattern[out++] = '\\';
+        }
+        pattern[out++] = c;
+    }
+    pattern[out] = '\0';
+    return pattern;
+}
+
+/* starts a new command at the end of the pipeline, returns pointer */
+static command_t *start_command(arena_t *arena, pipeline_t *pipeline,
+                                int *max_commands) {
+    if (pipeline->num_commands == *max_commands) {
+        command_t *commands = (command_t *)arena_alloc(
+            arena, (size_t)*max_commands * 2 * sizeof(command_t));
+        memcpy(commands, pipeline->commands,
+               (size_t)pipeline->num_commands * sizeof(command_t));
+        pipeline->commands = commands;
+        *max_commands *= 2;
+    }
+
+    command_t *command = &pipeline->commands[pipeline->num_commands++];
+    command->tokens =
+        (char **)arena_alloc(arena, INITIAL_WORDS * sizeof(char *));
+    command->argv = NULL;
+    command->counter = 0;
+    command->assignments = NULL;
+    command->num_assignments = 0;
+    command->num_redirections = 0;
+    command->builtin = NULL;
+    command->path = NULL;
+    command->exec_fd = -1;
+    command->envp = NULL;
+    command->pid = -1;
+    return command;
+}
+
+/* appends a word to the command, doubling its tokens array when it is full */
+static void add_word(arena_t *arena, command_t *command, int *max_words,
+                     char *word) {
+    // one spot is always left for the null at the end
+    if (command->counter + 1 == *max_words) {
+        char **tokens = (char **)arena_alloc(
+            arena, (size_t)*max_words * 2 * sizeof(char *));
+        memcpy(tokens, command->tokens,
+               (size_t)command->counter * sizeof(char *));
+        command->tokens = tokens;
+        *max_words *= 2;
+    }
+    command->tokens[command->counter++] = word;
+}
+
+/*
+ * appends the paths a word expanded to to the command, growing its tokens
+ * array once to fit all of them
+ */
+static void add_paths(arena_t *arena, command_t *command, int *max_words,
+                      char **paths, size_t num) {
+    size_t needed = (size_t)command->counter + num + 1;
+    if (needed > (size_t)*max_words) {
+        size_t max = (size_t)*max_words;
+        while (max < needed) {
+            max *= 2;
+        }
+        char **tokens = (char **)arena_alloc(arena, max * sizeof(char *));
+        memcpy(tokens, command->tokens,
+               (size_t)command->counter * sizeof(char *));
+        command->tokens = tokens;
+        *max_words = (int)max;
+    }
+    memcpy(command->tokens + command->counter, paths, num * sizeof(char *));
+    command->counter += (int)num;
+}
+
+/*
+ * appends a NAME=value word to the command's assignments, doubling the array
+ * when it is full
+ */
+static void add_assignment(arena_t *arena, command_t *command,
+                           int *max_assignments, char *word) {
+    if (command->num_assignments == *max_assignments) {
+        int max = *max_assignments == 0 ? INITIAL_ASSIGNMENTS
+                                        : *max_assignments * 2;
+        char **assignments =
+            (char **)arena_alloc(arena, (size_t)max * sizeof(char *));
+        if (command->num_assignments > 0) {
+            memcpy(assignments, command->assignments,
+                   (size_t)command->num_assignments * sizeof(char *));
+        }
+        command->assignments = assignments;
+        *max_assignments = max;
+    }
+    command->assignments[command->num_assignments++] = word;
+}
+
+/*
+ * adds a redirection of fd to the command, its file is filled in by the next
+ * word, returns pointer, NULL if fd is already redirected
+ */
+static redirection_t *add_redirection(command_t *command, int fd, int flags) {
+    for (int i = 0; i < command->num_redirections; i++) {
+        if (command->redirections[i].fd == fd) {
+            fprintf(stderr, fd == 0 ? "syntax error: multiple input files\n"
+                                    : "syntax error: multiple output files\n");
+            return NULL;
+        }
+    }
+
+    redirection_t *redirection =
+        &command->redirections[command->num_redirections++];
+    redirection->fd = fd;
+    redirection->flags = flags;
+    redirection->file = NULL;
+    redirection->here = HERE_NONE;
+    redirection->strip_tabs = 0;
+    redirection->literal = 0;
+    redirection->text = NULL;
+    redirection->text_len = 0;
+    redirection->open_fd = -1;
+    return redirection;
+}
+
+/*
+ * null terminates the command's tokens and builds its argv, where the full
+ * path of the command is replaced by the binary name
+ * returns 0 on success, 1 if the command has no words
+ */
+static int finish_command(arena_t *arena, command_t *command) {
+    command->tokens[command->counter] = NULL;
+    if (command->counter == 0) {
+        return 1;
+    }
+
+    size_t size = (size_t)(command->counter + 1) * sizeof(char *);
+    command->argv = (char **)arena_alloc(arena, size);
+    memcpy(command->argv, command->tokens, size);
+
+    char *last_slash = strrchr(command->tokens[0], '/');
+    if (last_slash != NULL) {
+        command->argv[0] = last_slash + 1;
+    }
+    return 0;
+}
+
+/*
+ * parses a line into a pipeline in a single pass, the words are unquoted and
+ * their $NAME, ${NAME}, $?, $$ and $! are expanded from vars in place, so they
+ * point into the line unless an expansion made them longer, everything else
+ * is allocated from the arena and stays valid until the arena is reset
+ * a word with unquoted *, ? or [...] becomes the paths that match it, found
+ * with pathexp, unless none do or pathexp is NULL
+ * a $(...) is replaced by the output of the command in it, without the
+ * newlines at its end, run by substitute, and is a syntax error if it is NULL
+ * a command may be only NAME=value assignments if it is the whole line
+ * returns 0 if there is a command to run, 1 if the line is empty, 2 if it has
+ * a syntax error, which is printed
+ */
+int parse(char *line, arena_t *arena, vars_t *vars, pathexp_t *pathexp,
+          substitute_t substitute, pipeline_t *pipeline) {
+    int max_commands = INITIAL_COMMANDS;
+    int max_words = INITIAL_WORDS;
+    int max_assignments = 0;
+    pipeline->commands =
+        (command_t *)arena_alloc(arena, INITIAL_COMMANDS * sizeof(command_t));
+    pipeline->num_commands = 0;
+    pipeline->is_bg = 0;
+    pipeline->timed = 0;
+
+    command_t *command = start_command(arena, pipeline, &max_commands);
+    // the redirection waiting for its file, the next word is the file
+    redirection_t *pending = NULL;
+
+    // c is the character at p, kept apart because terminating a word may
+    // overwrite it
+    char *p = line;
+    char c = *p;
+    while (1) {
+        while (is_blank(c)) {
+            c = *++p;
+        }
+        if (c == '\0') {
+            break;
+        }
+
+        if (is_operator(c) && pending != NULL) {
+            if (c == '<' || c == '>') {
+                fprintf(stderr, "Syntax error: file is a redirection symbol\n");
+            } else {
+                fprintf(stderr, "No file name given after redirect\n");
+            }
+            return 2;
+        }
+
+        if (c == '<' && p[1] == '<') {
+            // <<< is a here-string, << and <<- a here-document
+            int string = p[2] == '<';
+            int strip_tabs = !string && p[2] == '-';
+            pending = add_redirection(command, 0, O_RDONLY);
+            if (pending == NULL) {
+                return 2;
+            }
+            pending->here = string ? HERE_STRING : HERE_DOC;
+            pending->strip_tabs = strip_tabs;
+            p += string || strip_tabs ? 3 : 2;
+            c = *p;
+            continue;
+        }
+        if (c == '<' || c == '>') {
+            int append = c == '>' && p[1] == '>';
+            if (c == '<') {
+                pending = add_redirection(command, 0, O_RDONLY);
+            } else if (append) {
+                pending = add_redirection(command, 1,
+                                          O_WRONLY | O_APPEND | O_CREAT);
+            } else {
+                pending =
+                    add_redirection(command, 1, O_WRONLY | O_CREAT | O_TRUNC);
+            }
+            if (pending == NULL) {
+                return 2;
+            }
+            p += append ? 2 : 1;
+            c = *p;
+            continue;
+        }
+
+        if (c == '|') {
+            // a | ends the current command and starts the next one
+            if (finish_command(arena, command) != 0) {
+                fprintf(stderr, "syntax error: empty command in pipeline\n");
+                return 2;
+            }
+            command = start_command(arena, pipeline, &max_commands);
+            max_words = INITIAL_WORDS;
+            max_assignments = 0;
+            c = *++p;
+            continue;
+        }
+
+        if (c == '&') {
+            // the & applies to the whole pipeline, so it has to end the line
+            c = *++p;
+            while (is_blank(c)) {
+                c = *++p;
+            }
+            if (c != '\0') {
+                fprintf(stderr, "syntax error: & must end the line\n");
+                return 2;
+            }
+            pipeline->is_bg = 1;
+            break;
+        }
+
+        // NAME=value before the first word of a command is an assignment
+        int assignment = 0;
+        if (pending == NULL && command->counter == 0) {
+            size_t name_len = var_name_len(p);
+            assignment = name_len > 0 && p[name_len] == '=';
+        }
+
+        word_t word;
+        if (scan_word(&p, arena, vars, substitute, &word) != 0) {
+            return 2;
+        }
+        c = *p;
+        *word.out = '\0';
+
+        if (word.out == word.start && word.expanded && !word.quoted &&
+            (pending == NULL || pending->here == HERE_NONE)) {
+            // an unquoted expansion that is empty leaves no word at all
+            if (pending != NULL) {
+                fprintf(stderr, "syntax error: ambiguous redirect\n");
+                return 2;
+            }
+            continue;
+        }
+
+        // a word with unquoted wildcards is the paths that match it, or
+        // itself if none do
+        size_t num_paths = 0;
+        char **paths = NULL;
+        if (word.num_wildcards > 0 && !assignment && pathexp != NULL &&
+            (pending == NULL || pending->here == HERE_NONE)) {
+            num_paths = expand_pattern(pathexp, make_pattern(arena, &word),
+                                       arena, &paths);
+        }
+
+        if (pending != NULL && pending->here == HERE_STRING) {
+            // the word and a newline
+            size_t len = (size_t)(word.out - word.start);
+            pending->text = (char *)arena_alloc(arena, len + 2);
+            memcpy(pending->text, word.start, len);
+            pending->text[len] = '\n';
+            pending->text[len + 1] = '\0';
+            pending->text_len = len + 1;
+            pending = NULL;
+        } else if (pending != NULL && pending->here == HERE_DOC) {
+            // the body is read up to the delimiter later, and only expanded
+            // if no part of the delimiter was quoted
+            pending->file = word.start;
+            pending->literal = word.quoted;
+            pending = NULL;
+        } else if (pending != NULL) {
+            if (num_paths > 1) {
+                fprintf(stderr, "syntax error: ambiguous redirect\n");
+                return 2;
+            }
+            pending->file = num_paths == 1 ? paths[0] : word.start;
+            pending = NULL;
+        } else if (num_paths > 0) {
+            add_paths(arena, command, &max_words, paths, num_paths);
+        } else if (assignment) {
+            add_assignment(arena, command, &max_assignments, word.start);
+        } else if (pipeline->num_commands == 1 && command->counter == 0 &&
+                   !pipeline->timed && !word.quoted && !word.expanded &&
+                   word.out - word.start == 4 &&
+                   !strncmp(word.start, "time", 4)) {
+            // time before the first command is a keyword, unless it is quoted
+            pipeline->timed = 1;
+        } else {
+            add_word(arena, command, &max_words, word.start);
+        }
+    }
+
+    if (pending != NULL) {
+        fprintf(stderr, "No file name given after redirect\n");
+        return 2;
+    }
+    if (finish_command(arena, command) != 0) {
+        // a line of only assignments sets them in the shell
+        if (pipeline->num_commands == 1 && command->num_assignments > 0) {
+            return 0;
+        }
+        // a line of only whitespace isn't an error
+        if (pipeline->num_commands > 1) {
+            fprintf(stderr, "syntax error: empty command in pipeline\n");
+            return 2;
+        }
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * expands the body of a here-document, len bytes of text, null terminated,
+ * as a word in double quotes is, but a " is kept as it is
+ * *out is set to the expanded body, allocated from arena, and *out_len to its length
+ * returns 0 on success, -1 on a syntax error, which is printed
+ */
+int expand_here(arena_t *arena, vars_t *vars, substitute_t substitute, char *text,
+                size_t len, char **out, size_t *out_len) {
+    char *in = text;
+    char *end = text + len;
+    word_t word;
+
+    // the body is written to the arena from the start, expansions grow it
+    word.start = (char *)arena_alloc(arena, len + 1);
+    word.out = word.start;
+    word.limit = word.start + len;
+    while (in < end) {
+        if (*in == '$') {
+            if (expand(&in, arena, vars, substitute, &word) != 0) {
+                return -1;
+            }
+            continue;
+        }
+        if (*in == '\\' && in + 1 < end) {
+            // a backslash and a newline join two lines
+            if (in[1] == '\n') {
+                in += 2;
+                continue;
+            }
+            if (in[1] == '\\' || in[1] == '$' || in[1] == '`') {
+                in++;
+            }
+        }
+        char c = *in++;
+        put_char(arena, &word, in, c);
+    }
+    *word.out = '\0';
+    *out = word.start;
+    *out_len = (size_t)(word.out - word.start);
+    return 0;
+}
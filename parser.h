@@ -0,0 +1,86 @@
+#ifndef PARSER_H_
+#define PARSER_H_
+
+#include <sys/types.h>
+#include "./arena.h"
+#include "./pathexp.h"
+#include "./vars.h"
+
+#define MAX_REDIRECTIONS 2  // one input and one output
+
+// what stdin reads instead of a file: the lines after the command up to a
+// delimiter (<< or <<-), or a word and a newline (<<<)
+enum { HERE_NONE, HERE_DOC, HERE_STRING };
+
+// a redirection of stdin or stdout to a file, or of stdin to some text
+typedef struct redirection {
+    int fd;      // file descriptor being redirected, 0 or 1
+    int flags;   // flags the file is opened with
+    char *file;  // for a here-document, its delimiter
+    int here;    // HERE_DOC or HERE_STRING if stdin reads text, or HERE_NONE
+    int strip_tabs;  // non-zero for <<-, whose lines lose their leading tabs
+    int literal;     // non-zero if the delimiter was quoted, then nothing is expanded
+    char *text;      // what is read, set by parse() for <<< and later for <<
+    size_t text_len;
+    int open_fd;     // an fd that is installed instead of opening file, or -1
+} redirection_t;
+
+struct builtin;
+
+/*
+ * runs the command of a $(...), null terminated, sets *output to what it
+ * wrote to stdout, len bytes, which stays valid until the next command
+ * substitution, returns 0 on success, -1 if it couldn't be run
+ */
+typedef int (*substitute_t)(char *command, char **output, size_t *len);
+
+// one command of a pipeline, everything in it lives in the line or the arena
+typedef struct command {
+    char **tokens;  // the words of the command, null terminated
+    char **argv;    // the same, but argv[0] is only the binary name
+    int counter;    // number of elements in tokens and argv
+    char **assignments;  // the NAME=value words before the command
+    int num_assignments;
+    redirection_t redirections[MAX_REDIRECTIONS];
+    int num_redirections;
+    const struct builtin *builtin;  // utility run instead of path, or NULL
+    char *path;   // full path of the command, set by handle_commands()
+    int exec_fd;  // O_PATH handle of the command, or -1
+    char **envp;  // environment with the assignments, NULL for the shell's
+    pid_t pid;    // pid of the command once launched, -1 if it wasn't
+} command_t;
+
+// the commands of one line, connected by pipes
+typedef struct pipeline {
+    command_t *commands;
+    int num_commands;
+    int is_bg;  // non-zero if the line ended with &
+    int timed;  // non-zero if the line started with time
+} pipeline_t;
+
+/*
+ * parses a line into a pipeline in a single pass, the words are unquoted and
+ * their $NAME, ${NAME}, $?, $$ and $! are expanded from vars in place, so they
+ * point into the line unless an expansion made them longer, everything else
+ * is allocated from the arena and stays valid until the arena is reset
+ * a word with unquoted *, ? or [...] becomes the paths that match it, found
+ * with pathexp, unless none do or pathexp is NULL
+ * a $(...) is replaced by the output of the command in it, without the
+ * newlines at its end, run by substitute, and is a syntax error if it is NULL
+ * a command may be only NAME=value assignments if it is the whole line
+ * returns 0 if there is a command to run, 1 if the line is empty, 2 if it has
+ * a syntax error, which is printed
+ */
+int parse(char *line, arena_t *arena, vars_t *vars, pathexp_t *pathexp,
+          substitute_t substitute, pipeline_t *pipeline);
+
+/*
+ * expands the body of a here-document, len bytes of text, null terminated,
+ * as a word in double quotes is, but a " is kept as it is
+ * *out is set to the expanded body, allocated from arena, and *out_len to its length
+ * returns 0 on success, -1 on a syntax error, which is printed
+ */
+int expand_here(arena_t *arena, vars_t *vars, substitute_t substitute, char *text,
+                size_t len, char **out, size_t *out_len);
+
+#endif  // PARSER_H_
@@ -0,0 +1,702 @@
+#include "./pathexp.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "./walk.h"
+
+#define MAX_LISTINGS 64       // directory listings that are cached
+#define LISTING_SIZE 4096     // first block of the arena of a listing's names
+#define DENTS_SIZE (1 << 16)  // bytes of directory entries read at once
+#define INITIAL_ENTRIES 64
+#define INITIAL_PATHS 64
+#define PATTERN_SIZE 1024     // first block of the arena of compiled patterns
+#define RACY_NS 1000000000L   // a listing read this soon after its mtime is read again
+#define CLASS_BYTES 32        // one bit for every byte
+
+// the steps of a compiled component, matched in order
+enum { OP_LITERAL, OP_ANY, OP_STAR, OP_CLASS };
+
+typedef struct op {
+    int type;
+    const char *literal;          // OP_LITERAL, the bytes it matches
+    size_t len;
+    const unsigned char *class;   // OP_CLASS, a bit for every byte it matches
+} op_t;
+
+// a component of a pattern, what is between two slashes, compiled into steps,
+// with what every match has to start and end with, and how short it can be,
+// checked first so that most names are turned down by a memcmp()
+typedef struct component {
+    const char *literal;  // the component itself if it has no wildcards, or NULL
+    size_t literal_len;
+    op_t *ops;
+    size_t num_ops;
+    const char *prefix;
+    size_t prefix_len;
+    const char *suffix;
+    size_t suffix_len;
+    size_t min_len;
+    int dot;  // non-zero if it starts with a ., which a hidden name needs
+    int globstar;  // non-zero if it is only **, which matches any number of directories
+} component_t;
+
+typedef struct entry {
+    const char *name;
+    size_t len;
+    unsigned char type;  // d_type, DT_UNKNOWN if the file system doesn't say
+} entry_t;
+
+// the entries of a directory as of its mtime, sorted by name, a listing is
+// read again when the directory's mtime changes, or if it changed too soon
+// before it was read for the mtime to tell a later change apart
+typedef struct listing {
+    dev_t dev;
+    ino_t ino;
+    struct timespec mtime;
+    int valid;  // non-zero once it has been read
+    int racy;   // non-zero if it is read again even if the mtime is the same
+    int busy;   // expansions going through it, it isn't read again or dropped
+    unsigned long used;  // when it was last used, the oldest one is dropped
+    entry_t *entries;
+    size_t num_entries;
+    size_t max_entries;
+    arena_t *names;
+} listing_t;
+
+struct pathexp {
+    listing_t listings[MAX_LISTINGS];
+    unsigned long clock;
+    char *dents;        // the buffer getdents64() reads into
+    arena_t *patterns;  // the compiled components, reset for every expansion
+    char **paths;       // the paths an expansion found, grown by doubling
+    size_t num_paths;
+    size_t max_paths;
+    int trailing;       // non-zero if the pattern ends with a /
+    char path[PATH_MAX];  // the path being put together
+};
+
+/*
+ * initializes pathname expansion, with an empty cache of directory listings,
+ * returns pointer
+ */
+pathexp_t *init_pathexp() {
+    pathexp_t *pathexp = (pathexp_t *)calloc(1, sizeof(pathexp_t));
+    pathexp->dents = (char *)malloc(DENTS_SIZE);
+    pathexp->patterns = init_arena(PATTERN_SIZE);
+    return pathexp;
+}
+
+/*
+ * cleans up pathname expansion and its cached listings
+ * Note: this function will free the pathexp pointer
+ * DO NOT use the pointer after this function is called
+ */
+void cleanup_pathexp(pathexp_t *pathexp) {
+    if (pathexp == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < MAX_LISTINGS; i++) {
+        free(pathexp->listings[i].entries);
+        if (pathexp->listings[i].names != NULL) {
+            cleanup_arena(pathexp->listings[i].names);
+        }
+    }
+    free(pathexp->dents);
+    cleanup_arena(pathexp->patterns);
+    free(pathexp->paths);
+    free(pathexp);
+}
+
+/* appends a step to a component, there is always room for one more */
+static op_t *add_op(component_t *component, int type) {
+    op_t *op = &component->ops[component->num_ops++];
+    op->type = type;
+    op->literal = NULL;
+    op->len = 0;
+    op->class = NULL;
+    return op;
+}
+
+/*
+ * compiles a [...] that starts at s[*i] into a class, moving *i past it
+ * returns the class, NULL if the [ isn't closed, when it is only a [
+ */
+static const unsigned char *compile_class(arena_t *arena, const char *s, size_t n,
+                                          size_t *i) {
+    unsigned char bits[CLASS_BYTES];
+    size_t at = *i + 1;
+    int negate = 0;
+
+    memset(bits, 0, sizeof(bits));
+    if (at < n && (s[at] == '!' || s[at] == '^')) {
+        negate = 1;
+        at++;
+    }
+    // a ] right after the [ is one of the bytes
+    for (size_t first = at; at < n && (s[at] != ']' || at == first); at++) {
+        if (s[at] == '\\' && at + 1 < n) {
+            at++;
+        }
+        unsigned char low = (unsigned char)s[at];
+        unsigned char high = low;
+        if (at + 2 < n && s[at + 1] == '-' && s[at + 2] != ']') {
+            at += 2;
+            if (s[at] == '\\' && at + 1 < n) {
+                at++;
+            }
+            high = (unsigned char)s[at];
+        }
+        for (unsigned c = low; c <= high; c++) {
+            bits[c / 8] |= (unsigned char)(1 << (c % 8));
+        }
+    }
+    if (at >= n) {
+        return NULL;
+    }
+
+    unsigned char *class = (unsigned char *)arena_alloc(arena, CLASS_BYTES);
+    for (size_t b = 0; b < CLASS_BYTES; b++) {
+        class[b] = negate ? (unsigned char)~bits[b] : bits[b];
+    }
+    // a / is never in a name
+    class['/' / 8] &= (unsigned char)~(1 << ('/' % 8));
+    *i = at + 1;
+    return class;
+}
+
+/* compiles the n bytes of a component of a pattern */
+static void compile(arena_t *arena, const char *s, size_t n, component_t *component) {
+    // the literal bytes, unescaped, which the literal steps point into
+    char *bytes = (char *)arena_alloc(arena, n + 1);
+    size_t num_bytes = 0;
+    op_t *literal = NULL;
+    int wild = 0;
+
+    memset(component, 0, sizeof(component_t));
+    component->ops = (op_t *)arena_alloc(arena, (n + 1) * sizeof(op_t));
+    component->globstar = n == 2 && s[0] == '*' && s[1] == '*';
+    for (size_t i = 0; i < n;) {
+        const unsigned char *class = NULL;
+        if (s[i] == '*') {
+            // a run of * is one *
+            if (component->num_ops == 0 ||
+                component->ops[component->num_ops - 1].type != OP_STAR) {
+                add_op(component, OP_STAR);
+            }
+            literal = NULL;
+            wild = 1;
+            i++;
+            continue;
+        }
+        if (s[i] == '?') {
+            add_op(component, OP_ANY);
+            component->min_len++;
+            literal = NULL;
+            wild = 1;
+            i++;
+            continue;
+        }
+        if (s[i] == '[' && (class = compile_class(arena, s, n, &i)) != NULL) {
+            add_op(component, OP_CLASS)->class = class;
+            component->min_len++;
+            literal = NULL;
+            wild = 1;
+            continue;
+        }
+
+        if (s[i] == '\\') {
+            // a backslash at the end is dropped
+            if (++i == n) {
+                break;
+            }
+        }
+        if (literal == NULL) {
+            literal = add_op(component, OP_LITERAL);
+            literal->literal = bytes + num_bytes;
+        }
+        bytes[num_bytes++] = s[i++];
+        literal->len++;
+        component->min_len++;
+    }
+    bytes[num_bytes] = '\0';
+
+    if (!wild) {
+        component->literal = bytes;
+        component->literal_len = num_bytes;
+        return;
+    }
+    op_t *first = &component->ops[0];
+    op_t *last = &component->ops[component->num_ops - 1];
+    if (first->type == OP_LITERAL) {
+        component->prefix = first->literal;
+        component->prefix_len = first->len;
+        component->dot = first->literal[0] == '.';
+    }
+    if (last->type == OP_LITERAL) {
+        component->suffix = last->literal;
+        component->suffix_len = last->len;
+    }
+}
+
+/* finds where the character after the one at i starts */
+static size_t next_char(const char *name, size_t len, size_t i) {
+    i++;
+    while (i < len && ((unsigned char)name[i] & 0xc0) == 0x80) {
+        i++;
+    }
+    return i;
+}
+
+/*
+ * matches a name against a compiled component, a * that fails further on is
+ * tried again one character longer, only the last * ever is, so a name is
+ * matched in time proportional to its length times the pattern's
+ * returns non-zero if it matches
+ */
+static int match(const component_t *component, const char *name, size_t len) {
+    if (len < component->min_len || (name[0] == '.' && !component->dot) ||
+        (component->prefix_len > 0 &&
+         memcmp(name, component->prefix, component->prefix_len) != 0) ||
+        (component->suffix_len > 0 &&
+         memcmp(name + len - component->suffix_len, component->suffix,
+                component->suffix_len) != 0)) {
+        return 0;
+    }
+
+    const op_t *ops = component->ops;
+    size_t num_ops = component->num_ops;
+    size_t op = 0;
+    size_t at = 0;
+    size_t star = num_ops;  // the last * seen, num_ops if none
+    size_t star_at = 0;     // where what it matches ends
+    while (at < len || op < num_ops) {
+        if (op < num_ops) {
+            const op_t *step = &ops[op];
+            if (step->type == OP_STAR) {
+                // a * at the end matches the rest
+                if (op + 1 == num_ops) {
+                    return 1;
+                }
+                star = op++;
+                star_at = at;
+                continue;
+            }
+            if (step->type == OP_LITERAL && at + step->len <= len &&
+                memcmp(name + at, step->literal, step->len) == 0) {
+                at += step->len;
+                op++;
+                continue;
+            }
+            if (step->type == OP_ANY && at < len) {
+                at = next_char(name, len, at);
+                op++;
+                continue;
+            }
+            if (step->type == OP_CLASS && at < len &&
+                (step->class[(unsigned char)name[at] / 8] >> ((unsigned char)name[at] % 8)) & 1) {
+                at++;
+                op++;
+                continue;
+            }
+        }
+        if (star == num_ops || star_at >= len) {
+            return 0;
+        }
+        star_at = next_char(name, len, star_at);
+        at = star_at;
+        op = star + 1;
+    }
+    return 1;
+}
+
+/* orders entries by name, for qsort() */
+static int compare_entries(const void *a, const void *b) {
+    return strcmp(((const entry_t *)a)->name, ((const entry_t *)b)->name);
+}
+
+/*
+ * reads the entries of a directory into a listing, sorted by name, so the
+ * names that start with a pattern's prefix are found with a binary search,
+ * and what a pattern matches comes out already in order
+ * returns 0 on success, -1 on failure
+ */
+static int read_listing(pathexp_t *pathexp, listing_t *listing, const char *path) {
+    struct stat st;
+    struct timespec now;
+    ssize_t n;
+
+    listing->valid = 0;
+    listing->num_entries = 0;
+    if (listing->names == NULL) {
+        listing->names = init_arena(LISTING_SIZE);
+    }
+    reset_arena(listing->names);
+
+    int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    // the mtime goes first, so a change while reading is noticed next time
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    while ((n = getdents64(fd, pathexp->dents, DENTS_SIZE)) > 0) {
+        for (ssize_t offset = 0; offset < n;) {
+            const struct dirent64 *dent = (const struct dirent64 *)(pathexp->dents + offset);
+            offset += dent->d_reclen;
+            const char *name = dent->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+                continue;
+            }
+            if (listing->num_entries == listing->max_entries) {
+                listing->max_entries = listing->max_entries == 0
+                                           ? INITIAL_ENTRIES
+                                           : listing->max_entries * 2;
+                listing->entries = (entry_t *)realloc(
+                    listing->entries, listing->max_entries * sizeof(entry_t));
+            }
+            size_t len = strlen(name);
+            char *copy = (char *)arena_alloc(listing->names, len + 1);
+            memcpy(copy, name, len + 1);
+            entry_t *entry = &listing->entries[listing->num_entries++];
+            entry->name = copy;
+            entry->len = len;
+            entry->type = dent->d_type;
+        }
+    }
+    close(fd);
+    if (n < 0) {
+        return -1;
+    }
+    if (listing->num_entries > 1) {
+        qsort(listing->entries, listing->num_entries, sizeof(entry_t), compare_entries);
+    }
+
+    // a change within the same tick of the file system's clock leaves the
+    // mtime as it is, so a directory that changed just before it was read
+    // isn't trusted until it has been quiet for a while
+    clock_gettime(CLOCK_REALTIME, &now);
+    long age = (long)(now.tv_sec - st.st_mtim.tv_sec) * 1000000000L +
+               (now.tv_nsec - st.st_mtim.tv_nsec);
+    listing->dev = st.st_dev;
+    listing->ino = st.st_ino;
+    listing->mtime = st.st_mtim;
+    listing->racy = age < RACY_NS;
+    listing->valid = 1;
+    return 0;
+}
+
+/*
+ * gets the listing of a directory, from the cache if it hasn't changed since
+ * it was read, returns the listing, NULL if the directory can't be read
+ */
+static listing_t *get_listing(pathexp_t *pathexp, const char *path) {
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        return NULL;
+    }
+
+    listing_t *oldest = NULL;
+    for (size_t i = 0; i < MAX_LISTINGS; i++) {
+        listing_t *listing = &pathexp->listings[i];
+        if (listing->valid && listing->dev == st.st_dev && listing->ino == st.st_ino) {
+            listing->used = ++pathexp->clock;
+            // one that is being gone through is left as it is
+            if (listing->busy ||
+                (!listing->racy && listing->mtime.tv_sec == st.st_mtim.tv_sec &&
+                 listing->mtime.tv_nsec == st.st_mtim.tv_nsec)) {
+                return listing;
+            }
+            return read_listing(pathexp, listing, path) == 0 ? listing : NULL;
+        }
+        if (!listing->busy && (oldest == NULL || !listing->valid ||
+                               (oldest->valid && listing->used < oldest->used))) {
+            oldest = listing;
+        }
+    }
+    if (oldest == NULL) {
+        return NULL;
+    }
+    oldest->used = ++pathexp->clock;
+    return read_listing(pathexp, oldest, path) == 0 ? oldest : NULL;
+}
+
+/* adds the path that is in path, len bytes long, to the paths that were found */
+static void add_path(pathexp_t *pathexp, arena_t *arena, size_t len) {
+    if (pathexp->trailing) {
+        pathexp->path[len++] = '/';
+    }
+    char *copy = (char *)arena_alloc(arena, len + 1);
+    memcpy(copy, pathexp->path, len);
+    copy[len] = '\0';
+
+    if (pathexp->num_paths == pathexp->max_paths) {
+        pathexp->max_paths =
+            pathexp->max_paths == 0 ? INITIAL_PATHS : pathexp->max_paths * 2;
+        pathexp->paths = (char **)realloc(pathexp->paths,
+                                          pathexp->max_paths * sizeof(char *));
+    }
+    pathexp->paths[pathexp->num_paths++] = copy;
+}
+
+/* checks whether the entry whose path is in path is a directory */
+static int is_dir(pathexp_t *pathexp, const entry_t *entry) {
+    struct stat st;
+    if (entry->type != DT_UNKNOWN && entry->type != DT_LNK) {
+        return entry->type == DT_DIR;
+    }
+    return stat(pathexp->path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+static void expand_from(pathexp_t *pathexp, arena_t *arena,
+                        const component_t *components, size_t num, size_t i,
+                        size_t len);
+
+/*
+ * matches a name a walk found against the component after a **, or takes
+ * any name that isn't hidden if there is none, for walk_tree()
+ */
+static int match_walked(void *data, const char *name, size_t len, int type) {
+    const component_t *component = (const component_t *)data;
+    (void)type;
+    if (component == NULL) {
+        return name[0] != '.';
+    }
+    return match_name(component, name, len);
+}
+
+/*
+ * expands a ** at component i, which matches the directory in path and every
+ * one under it that isn't hidden, they are walked in parallel, and when the
+ * ** is last, or only one component follows it, that is matched against the
+ * names as they are found, otherwise the rest of the pattern is expanded in
+ * every directory
+ */
+static void expand_globstar(pathexp_t *pathexp, arena_t *arena,
+                            const component_t *components, size_t num, size_t i,
+                            size_t len) {
+    int last = i + 1 == num;
+    int matched = i + 2 == num && !components[i + 1].globstar;
+    walk_t walk;
+    char **found;
+
+    memset(&walk, 0, sizeof(walk));
+    walk.filter = match_walked;
+    walk.data = matched ? (void *)(uintptr_t)&components[i + 1] : NULL;
+    // links aren't walked through, but one to a directory is one at the end
+    walk.types = !(last || matched) ? WALK_DIR
+                 : pathexp->trailing ? WALK_DIR | WALK_LINK
+                                     : WALK_ANY;
+    walk.min_depth = 1;
+    walk.max_depth = -1;
+
+    pathexp->path[len] = '\0';
+    ssize_t num_found = walk_tree(pathexp->path, &walk, &found);
+    if (num_found < 0) {
+        return;
+    }
+    // ** matching no directory at all, a walk matching names finds those too,
+    // and a ** right after another adds nothing to it
+    if (last && len > 0 && !components[i - 1].globstar) {
+        add_path(pathexp, arena, pathexp->trailing ? len - 1 : len);
+    } else if (!last && !matched) {
+        expand_from(pathexp, arena, components, num, i + 1, len);
+    }
+    for (ssize_t f = 0; f < num_found; f++) {
+        size_t n = strlen(found[f]);
+        struct stat st;
+        if (n + 2 > PATH_MAX ||
+            ((last || matched) && pathexp->trailing &&
+             (stat(found[f], &st) != 0 || !S_ISDIR(st.st_mode)))) {
+            continue;
+        }
+        memcpy(pathexp->path, found[f], n);
+        if (last || matched) {
+            add_path(pathexp, arena, n);
+        } else {
+            pathexp->path[n] = '/';
+            expand_from(pathexp, arena, components, num, i + 1, n + 1);
+        }
+    }
+    free(found);
+}
+
+/*
+ * expands the components from i on, path holds the len bytes of the path the
+ * components before them matched, with a / at the end unless it is empty
+ */
+static void expand_from(pathexp_t *pathexp, arena_t *arena,
+                        const component_t *components, size_t num, size_t i,
+                        size_t len) {
+    const component_t *component = &components[i];
+    int last = i + 1 == num;
+    struct stat st;
+
+    if (component->globstar) {
+        expand_globstar(pathexp, arena, components, num, i, len);
+        return;
+    }
+    // a component without wildcards is taken as it is, only the whole path is
+    // checked at the end
+    if (component->literal != NULL) {
+        if (len + component->literal_len + 2 > PATH_MAX) {
+            return;
+        }
+        memcpy(pathexp->path + len, component->literal, component->literal_len);
+        len += component->literal_len;
+        pathexp->path[len] = '\0';
+        if (!last) {
+            pathexp->path[len] = '/';
+            expand_from(pathexp, arena, components, num, i + 1, len + 1);
+        } else if (lstat(pathexp->path, &st) == 0 &&
+                   (!pathexp->trailing || (stat(pathexp->path, &st) == 0 &&
+                                           S_ISDIR(st.st_mode)))) {
+            add_path(pathexp, arena, len);
+        }
+        return;
+    }
+
+    pathexp->path[len] = '\0';
+    listing_t *listing = get_listing(pathexp, len == 0 ? "." : pathexp->path);
+    if (listing == NULL) {
+        return;
+    }
+    // the names with the component's prefix are the ones from the first that
+    // isn't before it, up to the first that doesn't have it
+    size_t first = 0;
+    size_t end = listing->num_entries;
+    if (component->prefix_len > 0) {
+        while (first < end) {
+            size_t middle = first + (end - first) / 2;
+            if (strncmp(listing->entries[middle].name, component->prefix,
+                        component->prefix_len) < 0) {
+                first = middle + 1;
+            } else {
+                end = middle;
+            }
+        }
+        end = listing->num_entries;
+    }
+
+    listing->busy++;
+    for (size_t e = first; e < end; e++) {
+        const entry_t *entry = &listing->entries[e];
+        if (component->prefix_len > 0 &&
+            strncmp(entry->name, component->prefix, component->prefix_len) != 0) {
+            break;
+        }
+        if (!match(component, entry->name, entry->len) ||
+            len + entry->len + 2 > PATH_MAX) {
+            continue;
+        }
+        memcpy(pathexp->path + len, entry->name, entry->len + 1);
+        if ((!last || pathexp->trailing) && !is_dir(pathexp, entry)) {
+            continue;
+        }
+        if (last) {
+            add_path(pathexp, arena, len + entry->len);
+        } else {
+            pathexp->path[len + entry->len] = '/';
+            expand_from(pathexp, arena, components, num, i + 1, len + entry->len + 1);
+        }
+    }
+    listing->busy--;
+}
+
+/*
+ * compiles a pattern that names are matched against on their own, as find
+ * -name does, where a hidden name needs no . in the pattern, allocated from
+ * arena, returns pointer
+ */
+const name_pattern_t *compile_name_pattern(arena_t *arena, const char *pattern) {
+    component_t *component = (component_t *)arena_alloc(arena, sizeof(component_t));
+    compile(arena, pattern, strlen(pattern), component);
+    component->dot = 1;
+    return component;
+}
+
+/* matches a name, len bytes long, against a compiled pattern, returns non-zero if it matches */
+int match_name(const name_pattern_t *pattern, const char *name, size_t len) {
+    if (pattern->literal != NULL) {
+        return len == pattern->literal_len && memcmp(name, pattern->literal, len) == 0;
+    }
+    return match(pattern, name, len);
+}
+
+/* orders paths, for qsort() */
+static int compare_paths(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/*
+ * expands a pattern of *, ? and [...] into the paths that match it, sorted,
+ * a backslash in the pattern makes the character after it match only itself,
+ * and a component that is only ** matches any number of directories
+ * the paths are allocated from arena, and *paths is set to the array of them,
+ * which stays valid until the next expansion
+ * returns the number of paths, 0 if none match or the pattern has no wildcards
+ */
+size_t expand_pattern(pathexp_t *pathexp, const char *pattern, arena_t *arena,
+                      char ***paths) {
+    size_t len = strlen(pattern);
+    size_t num = 1;
+    int wild = 0;
+    int globstars = 0;
+
+    reset_arena(pathexp->patterns);
+    pathexp->num_paths = 0;
+    *paths = pathexp->paths;
+    for (size_t i = 0; i < len; i++) {
+        num += pattern[i] == '/';
+    }
+    // a / at the end only lets directories match
+    pathexp->trailing = len > 0 && pattern[len - 1] == '/';
+    if (pathexp->trailing) {
+        len--;
+        num--;
+    }
+
+    component_t *components =
+        (component_t *)arena_alloc(pathexp->patterns, num * sizeof(component_t));
+    const char *start = pattern;
+    for (size_t i = 0; i < num; i++) {
+        const char *end = (const char *)memchr(start, '/', (size_t)(pattern + len - start));
+        size_t n = end == NULL ? (size_t)(pattern + len - start) : (size_t)(end - start);
+        compile(pathexp->patterns, start, n, &components[i]);
+        wild |= components[i].literal == NULL;
+        globstars += components[i].globstar;
+        start += n + 1;
+    }
+    if (!wild) {
+        return 0;
+    }
+
+    expand_from(pathexp, arena, components, num, 0, 0);
+    // listings are sorted, so the paths only are out of order when a / sorts
+    // after a byte that follows a shorter name, like d/ and d.old/
+    for (size_t i = 1; i < pathexp->num_paths; i++) {
+        if (strcmp(pathexp->paths[i - 1], pathexp->paths[i]) > 0) {
+            qsort(pathexp->paths, pathexp->num_paths, sizeof(char *), compare_paths);
+            break;
+        }
+    }
+    // one ** after another finds the same path through each of them
+    if (globstars > 1 && pathexp->num_paths > 1) {
+        size_t kept = 1;
+        for (size_t i = 1; i < pathexp->num_paths; i++) {
+            if (strcmp(pathexp->paths[kept - 1], pathexp->paths[i]) != 0) {
+                pathexp->paths[kept++] = pathexp->paths[i];
+            }
+        }
+        pathexp->num_paths = kept;
+    }
+    *paths = pathexp->paths;
+    return pathexp->num_paths;
+}
@@ -0,0 +1,43 @@
+#ifndef PATHEXP_H_
+#define PATHEXP_H_
+
+#include <stddef.h>
+#include "./arena.h"
+
+typedef struct pathexp pathexp_t;
+typedef struct component name_pattern_t;
+
+/*
+ * initializes pathname expansion, with an empty cache of directory listings,
+ * returns pointer
+ */
+pathexp_t *init_pathexp();
+/*
+ * cleans up pathname expansion and its cached listings
+ * Note: this function will free the pathexp pointer
+ * DO NOT use the pointer after this function is called
+ */
+void cleanup_pathexp(pathexp_t *pathexp);
+
+/*
+ * expands a pattern of *, ? and [...] into the paths that match it, sorted,
+ * a backslash in the pattern makes the character after it match only itself,
+ * and a component that is only ** matches any number of directories
+ * the paths are allocated from arena, and *paths is set to the array of them,
+ * which stays valid until the next expansion
+ * returns the number of paths, 0 if none match or the pattern has no wildcards
+ */
+size_t expand_pattern(pathexp_t *pathexp, const char *pattern, arena_t *arena,
+                      char ***paths);
+
+/*
+ * compiles a pattern that names are matched against on their own, as find
+ * -name does, where a hidden name needs no . in the pattern, allocated from
+ * arena, returns pointer
+ */
+const name_pattern_t *compile_name_pattern(arena_t *arena, const char *pattern);
+
+/* matches a name, len bytes long, against a compiled pattern, returns non-zero if it matches */
+int match_name(const name_pattern_t *pattern, const char *name, size_t len);
+
+#endif  // PATHEXP_H_
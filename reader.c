@@ -0,0 +1,127 @@
+#include "./reader.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define READ_SIZE 65536  // at least this much room is asked of every read()
+
+// buffer holds the input from start to end, lines before start were already
+// returned, and scan is where the search for the next newline picks up, so no
+// byte is looked at twice no matter how long a line is
+struct line_reader {
+    int fd;
+    char *buffer;
+    size_t size;
+    size_t start;
+    size_t scan;
+    size_t end;
+    int eof;
+};
+
+/* initializes a line reader on a file descriptor, returns pointer */
+line_reader_t *init_line_reader(int fd) {
+    line_reader_t *reader = (line_reader_t *)malloc(sizeof(line_reader_t));
+    reader->fd = fd;
+    reader->size = READ_SIZE + 1;
+    reader->buffer = (char *)malloc(reader->size);
+    reader->start = 0;
+    reader->scan = 0;
+    reader->end = 0;
+    reader->eof = 0;
+    return reader;
+}
+
+/*
+ * cleans up the line reader, the file descriptor is not closed
+ * Note: this function will free the reader pointer
+ * DO NOT use the pointer after this function is called
+ */
+void cleanup_line_reader(line_reader_t *reader) {
+    if (reader == NULL) {
+        return;
+    }
+    free(reader->buffer);
+    free(reader);
+}
+
+/*
+ * reads whatever input is available into the reader's buffer, growing it if
+ * needed, returns the number of bytes read, 0 at end of input, -1 on failure
+ */
+ssize_t fill_line_reader(line_reader_t *reader) {
+    if (reader == NULL) {
+        return -1;
+    }
+    if (reader->eof) {
+        return 0;
+    }
+
+    // move the partial line to the front, then double the buffer until a
+    // full read fits after it, keeping a byte for the null terminator
+    if (reader->start > 0) {
+        memmove(reader->buffer, reader->buffer + reader->start,
+                reader->end - reader->start);
+        reader->end -= reader->start;
+        reader->scan -= reader->start;
+        reader->start = 0;
+    }
+    if (reader->size - reader->end < READ_SIZE + 1) {
+        while (reader->size - reader->end < READ_SIZE + 1) {
+            reader->size *= 2;
+        }
+        reader->buffer = (char *)realloc(reader->buffer, reader->size);
+    }
+
+    ssize_t num_read;
+    do {
+        num_read = read(reader->fd, reader->buffer + reader->end,
+                        reader->size - reader->end - 1);
+    } while (num_read < 0 && errno == EINTR);
+
+    if (num_read <= 0) {
+        reader->eof = 1;
+        return num_read;
+    }
+    reader->end += (size_t)num_read;
+    return num_read;
+}
+
+/*
+ * gets the next complete line from the buffer, without its newline and null
+ * terminated, len is set to its length
+ * once the input has ended, the last line is returned even without a newline
+ * returns NULL if no complete line is buffered
+ * the line stays valid until the next call to fill_line_reader()
+ */
+char *next_line(line_reader_t *reader, size_t *len) {
+    if (reader == NULL || reader->start == reader->end) {
+        return NULL;
+    }
+
+    char *line = reader->buffer + reader->start;
+    char *newline = (char *)memchr(reader->buffer + reader->scan, '\n',
+                                   reader->end - reader->scan);
+    if (newline == NULL) {
+        reader->scan = reader->end;
+        if (!reader->eof) {
+            return NULL;
+        }
+        // the input ended in the middle of a line
+        newline = reader->buffer + reader->end;
+    }
+
+    *newline = '\0';
+    *len = (size_t)(newline - line);
+    reader->start = reader->start + *len;
+    if (reader->start < reader->end) {
+        reader->start++;  // skip the newline
+    }
+    reader->scan = reader->start;
+    return line;
+}
+
+/* returns non-zero once the input has ended and every line was returned */
+int line_reader_done(line_reader_t *reader) {
+    return reader == NULL || (reader->eof && reader->start == reader->end);
+}
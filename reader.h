@@ -0,0 +1,35 @@
+#ifndef READER_H_
+#define READER_H_
+
+#include <sys/types.h>
+
+typedef struct line_reader line_reader_t;
+
+/* initializes a line reader on a file descriptor, returns pointer */
+line_reader_t *init_line_reader(int fd);
+/*
+ * cleans up the line reader, the file descriptor is not closed
+ * Note: this function will free the reader pointer
+ * DO NOT use the pointer after this function is called
+ */
+void cleanup_line_reader(line_reader_t *reader);
+
+/*
+ * reads whatever input is available into the reader's buffer, growing it if
+ * needed, returns the number of bytes read, 0 at end of input, -1 on failure
+ */
+ssize_t fill_line_reader(line_reader_t *reader);
+
+/*
+ * gets the next complete line from the buffer, without its newline and null
+ * terminated, len is set to its length
+ * once the input has ended, the last line is returned even without a newline
+ * returns NULL if no complete line is buffered
+ * the line stays valid until the next call to fill_line_reader()
+ */
+char *next_line(line_reader_t *reader, size_t *len);
+
+/* returns non-zero once the input has ended and every line was returned */
+int line_reader_done(line_reader_t *reader);
+
+#endif  // READER_H_
@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+"""
+Replays the shell_2_tests trace files on a shell, the way cs0330_shell_2_test
+runs them, without checking the output. make pgo uses it to train the
+profile-guided build on a representative workload.
+
+A trace line is sent to the shell as input, except for SLEEP n, which waits a
+quarter of n seconds like the quick tests do, INT, TSTP and QUIT, which the
+harness turns into signals for the foreground job, and BLANK, an empty line.
+Every shell runs under cs0330_shell_2_harness in a directory of its own.
+"""
+import argparse
+import concurrent.futures
+import glob
+import os
+import re
+import subprocess
+import sys
+import tempfile
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+HARNESS = os.path.join(HERE, "cs0330_shell_2_harness")
+SUITE = os.path.join(HERE, "shell_2_tests", "shell_2_tests_quick")
+SIGNALS = {"INT": "!c", "TSTP": "!z", "QUIT": "!\\"}
+TIMEOUT = 30
+
+
+def replay(shell, trace, suite):
+    """runs one trace on the shell, returns the shell's exit status"""
+    with open(trace) as f:
+        lines = [line.rstrip().replace("$SUITE", suite) for line in f]
+
+    with tempfile.TemporaryDirectory() as cwd:
+        proc = subprocess.Popen([HARNESS, shell], stdin=subprocess.PIPE,
+                                stdout=subprocess.DEVNULL,
+                                stderr=subprocess.DEVNULL, cwd=cwd)
+        time.sleep(0.2)
+        for line in lines:
+            if line.startswith("#"):
+                continue
+            sleep = re.match(r"SLEEP (\d+)", line)
+            if sleep:
+                time.sleep(int(sleep.group(1)) * 0.25)
+                continue
+            if line in SIGNALS:
+                line = SIGNALS[line]
+            elif line == "BLANK":
+                line = ""
+            proc.stdin.write((line + "\r\n").encode())
+            proc.stdin.flush()
+            time.sleep(0.05)
+        try:
+            proc.stdin.close()
+            return proc.wait(timeout=TIMEOUT)
+        except subprocess.TimeoutExpired:
+            proc.kill()
+            return proc.wait()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("shells", nargs="+")
+    parser.add_argument("--suite", default=SUITE)
+    parser.add_argument("--jobs", type=int, default=8,
+                        help="traces replayed at the same time")
+    args = parser.parse_args()
+
+    suite = os.path.abspath(args.suite)
+    traces = sorted(glob.glob(os.path.join(suite, "traces", "trace*.txt")))
+    shells = [os.path.abspath(shell) for shell in args.shells]
+    with concurrent.futures.ThreadPoolExecutor(args.jobs) as pool:
+        runs = [pool.submit(replay, shell, trace, suite)
+                for shell in shells for trace in traces]
+        for run in runs:
+            run.result()
+    print("replayed %d traces on %s" % (len(traces), " ".join(args.shells)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -1,12 +1,27 @@
+#include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
-#include "./jobs.h"
+#include "./parser.h"
+#include "./sh.h"
+#include "./utilities.h"
 
 // MACROS
 #define BUFFER_SIZE 1024
@@ -14,11 +29,90 @@
 #define FALSE 0
 #define FG 2
 #define BG 3
+#define MAX_EVENTS 4
+#define SAVED_FD_MIN 10 // the shell's stdin and stdout are saved above this fd
+#define CAPTURE_READ 65536 // room for every read of the output of a $(...)
+#define MAX_BUILTIN_SLOTS 256 // the most slots the built-in hash table can have
+#define MAX_BUILTIN_SEEDS 65536 // seeds tried for each table size
+
+// every built-in: its name, its handler, the fewest and most arguments it
+// takes (-1 for any number), and whether it is a utility, which can also run
+// in a child of its own as part of a pipeline or a background job, adding a
+// built-in only takes a line here and its handler
+#define BUILTINS(X)                              \
+    X("cd", builtin_cd, 1, 1, FALSE)             \
+    X("ln", builtin_ln, 2, 2, FALSE)             \
+    X("rm", builtin_rm, 1, 1, FALSE)             \
+    X("bg", builtin_bg, 1, 1, FALSE)             \
+    X("fg", builtin_fg, 1, 1, FALSE)             \
+    X("exit", builtin_exit, 0, -1, FALSE)        \
+    X("jobs", builtin_jobs, 0, 1, FALSE)         \
+    X("hash", builtin_hash, 0, -1, FALSE)        \
+    X("export", builtin_export, 0, -1, FALSE)    \
+    X("unset", builtin_unset, 1, -1, FALSE)      \
+    X("stats", builtin_stats, 0, 1, FALSE)       \
+    X("history", builtin_history, 0, 2, TRUE)    \
+    X("echo", builtin_echo, 0, -1, TRUE)         \
+    X("printf", builtin_printf, 1, -1, TRUE)     \
+    X("test", builtin_test, 0, -1, TRUE)         \
+    X("[", builtin_bracket, 1, -1, TRUE)         \
+    X("true", builtin_true, 0, -1, TRUE)         \
+    X("false", builtin_false, 0, -1, TRUE)       \
+    X("pwd", builtin_pwd, 0, -1, TRUE)           \
+    X("sleep", builtin_sleep, 1, -1, TRUE)       \
+    X("find", builtin_find, 0, -1, TRUE)
+
+#define BUILTIN_DECLARE(name, handler, min, max, utility) int handler(int argc, char *argv[]);
+#define BUILTIN_ENTRY(name, handler, min, max, utility) {name, handler, min, max, utility},
+#define BUILTIN_COUNT(name, handler, min, max, utility) +1
+#define NUM_BUILTINS ((size_t)(0 BUILTINS(BUILTIN_COUNT)))
+
+// posix_spawn() can only hand the terminal to the child on glibc 2.35+
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 35)
+#define HAVE_SPAWN_TCSETPGRP 1
+#endif
 
 // GLOBAL VARIABLES
 job_list_t *job_list;
-int jid; // the job id count
-int is_bg; //value is TRUE if currently a background process, FALSE if foreground
+cmd_hash_t *cmd_hash; // commands already looked up in PATH
+int use_spawn; // TRUE if commands are launched with posix_spawn(), FALSE for fork()
+int notify_now; // TRUE if job changes are printed as they happen, FALSE if before the prompt
+int epoll_fd;   // waits on stdin and signal_fd, -1 if stdin can't be waited on
+int signal_fd;  // SIGCHLD is read from here instead of being delivered
+arena_t *line_arena; // what parse() builds for a line, reset after every line
+stats_t *stats; // latency of every phase of running a command, NULL unless SH33_STATS is set
+vars_t *vars;   // shell variables, and the special parameters ?, $ and !
+history_t *history; // lines run so far, NULL if history isn't kept
+history_search_t *history_search; // index of history, NULL if history isn't kept
+editor_t *editor; // line editor of an interactive shell, NULL if lines are read whole
+completion_t *completion; // commands and paths tab completes to, NULL without the editor
+pathexp_t *pathexp; // expands *, ? and [...], with the directory listings it has read
+char *capture;       // what the command of a $(...) wrote, grown by doubling
+size_t capture_len;
+size_t capture_size;
+int substitution_status; // exit status of the last $(...) of the line, 0 if it had none
+
+// a built-in command, argc counts the command itself like argv does
+typedef struct builtin {
+    const char *name;
+    int (*handler)(int argc, char *argv[]);
+    int min_args;
+    int max_args;
+    int utility;
+} builtin_t;
+BUILTINS(BUILTIN_DECLARE)
+
+// perfect hash of the built-in table, from init_builtins(), a slot holds the
+// index of its built-in plus one, or 0 if it is empty
+unsigned char builtin_slots[MAX_BUILTIN_SLOTS];
+size_t builtin_mask;
+uint32_t builtin_seed;
+
+// job changes noticed by reap() that haven't been printed yet
+char *notifications;
+size_t notifications_len;
+size_t notifications_size;
+
 
 
 /**
@@ -51,6 +145,108 @@ void default_child_signals(){
     if(signal(SIGTTOU, SIG_DFL) == SIG_ERR){
         printf("signal default error");
     }
+
+    // the shell blocks SIGCHLD to read it from signal_fd
+    sigset_t mask;
+    sigemptyset(&mask);
+    if(sigprocmask(SIG_SETMASK, &mask, NULL) != 0){
+        printf("signal mask error");
+    }
+}
+
+/**
+ * The notify() function takes a message about a background job, formatted like printf(). Messages
+ * are kept until flush_notifications() prints them, so they never show up in the middle of the output
+ * of a foreground command.
+ * @param format: printf() format of the message
+*/
+void notify(const char *format, ...) __attribute__((format(printf, 1, 2)));
+void notify(const char *format, ...){
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    if (len < 0){
+        return;
+    }
+
+    // grow the buffer by doubling, so many messages don't mean many reallocs
+    size_t needed = notifications_len + (size_t)len + 1;
+    if (needed > notifications_size){
+        notifications_size = notifications_size == 0 ? BUFFER_SIZE : notifications_size;
+        while (notifications_size < needed){
+            notifications_size *= 2;
+        }
+        notifications = (char *)realloc(notifications, notifications_size);
+    }
+
+    va_start(args, format);
+    vsnprintf(notifications + notifications_len, (size_t)len + 1, format, args);
+    va_end(args);
+    notifications_len += (size_t)len;
+}
+
+/**
+ * The flush_notifications() function prints every message taken by notify() since it was last
+ * called.
+ * @return TRUE if anything was printed, FALSE otherwise
+*/
+int flush_notifications(){
+    if (notifications_len == 0){
+        return FALSE;
+    }
+    fwrite(notifications, 1, notifications_len, stdout);
+    fflush(stdout);
+    notifications_len = 0;
+    return TRUE;
+}
+
+/**
+ * The wait_foreground() function waits on every process of a job that is in
+ * the foreground, until all of them have terminated or the job is stopped.
+ * Stopped jobs stay in the job list, terminated jobs are removed from it. It
+ * is called from handle_commands() and change_location(). It waits with wait4(), so the job
+ * keeps track of the resources its processes used.
+ * @param job_jid: jid of the foreground job
+ * @param usage: set to the resources the job's terminated processes used, if it isn't NULL
+ * @return the exit status of the job like $? has it, 128 plus the signal if it was stopped or
+ * terminated by one
+*/
+int wait_foreground(int job_jid, struct rusage *usage){
+    pid_t job_pid = get_job_pid(job_list, job_jid);
+    int state = RUNNING;
+    int wret;
+    int wstatus = 0;
+    struct rusage process_usage;
+    uint64_t start = stats_now(stats);
+
+    // waiting on the process group catches every process of the job
+    while (state == RUNNING &&
+           (wret = wait4(-job_pid, &wstatus, WUNTRACED, &process_usage)) > 0){
+        state = update_job_status(job_list, wret, wstatus, &process_usage);
+    }
+
+    record_stat(stats, STAT_WAIT, start);
+
+    if (usage != NULL){
+        get_job_usage(job_list, job_jid, usage);
+    }
+
+    if (state == STOPPED){
+        // stopped/paused, stays in the job list
+        report_job_state(job_list, job_jid);
+        fprintf(stdout, "[%d] (%d) suspended by signal %d\n", job_jid, job_pid, WSTOPSIG(wstatus));
+        return 128 + WSTOPSIG(wstatus);
+    }
+
+    // the status of the job is the status of its last process
+    wstatus = get_job_status(job_list, job_jid);
+    if (WIFSIGNALED(wstatus)) {
+        // terminated by a signal
+        fprintf(stdout, "[%d] (%d) terminated by signal %d\n", job_jid, job_pid, WTERMSIG(wstatus));
+    }
+    remove_job_jid(job_list, job_jid);
+    return WIFSIGNALED(wstatus) ? 128 + WTERMSIG(wstatus) : WEXITSTATUS(wstatus);
 }
 
 /**
@@ -61,30 +257,32 @@ void default_child_signals(){
  * @param tokens[]: tokens array that contains the full file paths/command and
  * arguments
  * @param counter: number of elements in tokens
- * @return 0 if no error, -1 if error
+ * @return -1 if error, otherwise the exit status of the job like $? has it for fg, 0 for bg
 */
 int change_location(int new_ground, char *tokens[], int counter){
+    int status = 0;
 
     // error check to make sure there's a file path after the fg or bg command,
     // 2 because we incremented after adding elements above
     if(counter != 2){
-        return 1;
+        return -1;
     }
 
     char *process_jid_with_percent = tokens[1];
     char *pointer_to_percent = strrchr(process_jid_with_percent, '%');
-    char *process_jid_char = pointer_to_percent + 1; 
+    char *process_jid_char = pointer_to_percent == NULL
+                                 ? process_jid_with_percent
+                                 : pointer_to_percent + 1;
     int process_jid = atoi(process_jid_char);
     pid_t process_pid;
 
     // error-checking for invalid jid
-    if(process_jid > jid){
+    process_pid = get_job_pid(job_list, process_jid);
+    if(process_pid == -1){
         fprintf(stderr, "job not found\n");
         return -1;
     }
 
-    process_pid = get_job_pid(job_list, process_jid);
-
     // moving background process to foreground
     if (new_ground == FG){
 
@@ -96,29 +294,12 @@ int change_location(int new_ground, char *tokens[], int counter){
         }
         
         tcsetpgrp(0, process_pid);
+        // the whole job runs again, in the foreground
+        update_job_jid(job_list, process_jid, RUNNING);
+        report_job_state(job_list, process_jid);
         kill(-process_pid, SIGCONT); 
 
-        int status;
-        waitpid(process_pid, &status, WUNTRACED);
-
-        if(WIFEXITED(status)){
-            // terminated normally, remove foreground process that terminated
-            remove_job_jid(job_list, process_jid);
-            jid--; 
-        }
-
-        if (WIFSTOPPED(status)) {
-            // stopped/paused, update job's enum in job list
-            update_job_pid(job_list, process_pid, STOPPED);
-            fprintf(stdout, "[%d] (%d) suspended by signal %d\n", process_jid, process_pid, WSTOPSIG(status));
-        }
-        if (WIFSIGNALED(status)) {
-            // terminated by a signal, remove foregroud process that terminated
-            fprintf(stdout, "[%d] (%d) terminated by signal %d\n", process_jid, process_pid, WTERMSIG(status));
-            remove_job_jid(job_list, process_jid);
-            jid--; 
-
-        } 
+        status = wait_foreground(process_jid, NULL);
         tcsetpgrp(0, getpgrp()); 
 
     // moving process to background
@@ -130,134 +311,406 @@ int change_location(int new_ground, char *tokens[], int counter){
         kill(-process_pid, SIGCONT); 
 
     }
+    return status;
+
+}
+
+/**
+ * The write_stats() function dumps the latency histograms as JSON when the shell exits, to the file
+ * named by SH33_STATS, or to stderr if it is set to 1 or to nothing, and cleans them up.
+*/
+void write_stats() {
+    if (stats == NULL) {
+        return;
+    }
+
+    const char *path = getenv(STATS_ENV);
+    FILE *out = stderr;
+    if (path != NULL && *path != '\0' && strcmp(path, "1")) {
+        out = fopen(path, "w");
+        if (out == NULL) {
+            perror("stats");
+            out = stderr;
+        }
+    }
+    dump_stats(stats, out);
+    if (out != stderr) {
+        fclose(out);
+    }
+    cleanup_stats(stats);
+    stats = NULL;
+}
+
+/**
+ * The builtin_cd() function changes the working directory of the shell.
+ * @param argc: number of elements in argv
+ * @param argv: the cd command and its argument, the directory
+ * @return 0 if no error, 1 if error
+*/
+int builtin_cd(int argc, char *argv[]) {
+    (void)argc;
+    // error check chdir() syscall
+    if (chdir(argv[1]) != 0) {
+        perror("cd");
+        return 1;
+    }
     return 0;
+}
 
+/**
+ * The builtin_ln() function makes a hard link to a file.
+ * @param argc: number of elements in argv
+ * @param argv: the ln command and its arguments, the file and the new link
+ * @return 0 if no error, 1 if error
+*/
+int builtin_ln(int argc, char *argv[]) {
+    (void)argc;
+    // error check link() syscall
+    if (link(argv[1], argv[2]) != 0) {
+        perror("link");
+        return 1;
+    }
+    return 0;
 }
 
 /**
- * The check_built_in function handles the built in commands for shell. It
- * handles cd, ln, rm and exit. There is also error checking within the function
- * to ensure that cd has an argument following it and perror() is called for
- * syscall error checking. This function is called within handle_commands(), so
- * that we can first check if the command is a built-in shell command before
- * trying to proceed with the non-built in process.
- * @param tokens: tokens array that contains the full file paths/command and
- * arguments
- * @param argv: argv array that contains the binary path (command), and
- * arguments
- * @return - returns non-zero value if error occured
- *
- */
-int check_built_in(char *tokens[], char *argv[], int counter) {
-    const char *command = tokens[0];  // command will be at 0th index of tokens
-    int return_val = 1;  // default return should be error, unless a built in
-                         // command is executed
-
-    // can check for 3 types of commands if string length is 2, otherwise tries
-    // to go check for "exit" immediately, for better time efficiency
-    if (strlen(command) == 2) {
-        // check if cd
-        if (!strncmp(command, "cd", 2)) {
-            return_val = 0;  // sets return_val to 0, to indicate that this
-                             // function carried out a built-in successfully
-
-            // error check there should be an argument after cd
-            if (argv[1] == NULL) {
-                fprintf(stderr, "cd: syntax error\n");
-                return -1;
-            }
+ * The builtin_rm() function removes a file.
+ * @param argc: number of elements in argv
+ * @param argv: the rm command and its argument, the file
+ * @return 0 if no error, 1 if error
+*/
+int builtin_rm(int argc, char *argv[]) {
+    (void)argc;
+    // error check unlink() syscall
+    if (unlink(argv[1]) != 0) {
+        perror("unlink");
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * The builtin_bg() function resumes a job in the background.
+ * @param argc: number of elements in argv
+ * @param argv: the bg command and its argument, the jid
+ * @return 0 if no error, 1 if error
+*/
+int builtin_bg(int argc, char *argv[]) {
+    return change_location(BG, argv, argc) == 0 ? 0 : 1;
+}
+
+/**
+ * The builtin_fg() function resumes a job in the foreground and waits on it.
+ * @param argc: number of elements in argv
+ * @param argv: the fg command and its argument, the jid
+ * @return the exit status of the job, 1 if error
+*/
+int builtin_fg(int argc, char *argv[]) {
+    int status = change_location(FG, argv, argc);
+    return status < 0 ? 1 : status;
+}
+
+/**
+ * The builtin_exit() function cleans up and exits the shell.
+ * @param argc: number of elements in argv
+ * @param argv: the exit command, any arguments are ignored
+ * @return never returns
+*/
+int builtin_exit(int argc, char *argv[]) {
+    (void)argc;
+    (void)argv;
+    cleanup_job_list(job_list);
+    cleanup_cmd_hash(cmd_hash);
+    cleanup_arena(line_arena);
+    write_stats();
+    exit(0);  // exit doesn't require error checking
+}
+
+/**
+ * The builtin_jobs() function prints out the jobs list. With -l, every process of every job is
+ * listed too, with how long the job has been running and the resources its finished processes
+ * used.
+ * @param argc: number of elements in argv
+ * @param argv: the jobs command, and -l for the long listing
+ * @return 0 if no error, 2 if the option isn't -l
+*/
+int builtin_jobs(int argc, char *argv[]) {
+    if (argc == 2 && strcmp(argv[1], "-l")) {
+        fprintf(stderr, "jobs: %s: invalid option\n", argv[1]);
+        return 2;
+    }
+    jobs(job_list, argc == 2);
+    return 0;
+}
 
-            // file/directory after cd will be in argv[1]
-            const char *full_path = argv[1];
-            // error check chdir() syscall
-            if (chdir(full_path) != 0) {
-                perror("cd");
+/**
+ * The builtin_hash() function lists the commands remembered from PATH, forgets them with -r, or
+ * looks up the names given ahead of time.
+ * @param argc: number of elements in argv
+ * @param argv: the hash command and its arguments
+ * @return 0 if no error, 1 if a name wasn't found
+*/
+int builtin_hash(int argc, char *argv[]) {
+    int fd;
+    int ret = 0;
+    if (argc == 1) {
+        print_cmd_hash(cmd_hash);
+    } else if (!strcmp(argv[1], "-r")) {
+        clear_cmd_hash(cmd_hash);
+    } else {
+        for (int i = 1; i < argc; i++) {
+            if (lookup_command(cmd_hash, argv[i], &fd) == NULL) {
+                fprintf(stderr, "hash: %s: not found\n", argv[i]);
+                ret = 1;
             }
+        }
+    }
+    return ret;
+}
 
+/**
+ * The builtin_export() function exports variables, setting them first if they are given as
+ * NAME=value, or prints the environment commands get if there are no arguments.
+ * @param argc: number of elements in argv
+ * @param argv: the export command and the names to export
+ * @return 0 if no error, 1 if a name isn't valid
+*/
+int builtin_export(int argc, char *argv[]) {
+    int ret = 0;
+    if (argc == 1) {
+        for (char **env = get_envp(vars); *env != NULL; env++) {
+            printf("export %s\n", *env);
         }
-        // check if ln
-        if (!strncmp(command, "ln", 2)) {
-            return_val = 0;
-            const char *old_path = argv[1];
-            const char *new_path = argv[2];
-            // error check link() syscall
-            if (link(old_path, new_path) != 0) {
-                perror("link");
-            }
+        return 0;
+    }
+    for (int i = 1; i < argc; i++) {
+        size_t len = var_name_len(argv[i]);
+        if (len == 0 || (argv[i][len] != '\0' && argv[i][len] != '=')) {
+            fprintf(stderr, "export: %s: not a valid identifier\n", argv[i]);
+            ret = 1;
+            continue;
         }
-        // check if rm
-        if (!strncmp(command, "rm", 2)) {
-            return_val = 0;
-            const char *path = argv[1];
-            // error check unlink() syscall
-            if (unlink(path) != 0) {
-                perror("unlink");
-            }
+        if (argv[i][len] == '=') {
+            set_var(vars, argv[i], len, argv[i] + len + 1, strlen(argv[i] + len + 1));
         }
-        // check if bg
-        if (!strncmp(command, "bg", 2)){
-            return_val = 0;
-            //error check
-            if (change_location(BG, tokens, counter) != 0){
-                return -1;
-            }
+        export_var(vars, argv[i], len);
+    }
+    // the environment may have moved, commands and getenv() use it from environ
+    environ = get_envp(vars);
+    return ret;
+}
 
+/**
+ * The builtin_unset() function unsets variables, which also takes them out of the environment.
+ * @param argc: number of elements in argv
+ * @param argv: the unset command and the names to unset
+ * @return 0 if no error, 1 if a name isn't valid
+*/
+int builtin_unset(int argc, char *argv[]) {
+    int ret = 0;
+    for (int i = 1; i < argc; i++) {
+        size_t len = var_name_len(argv[i]);
+        if (len == 0 || argv[i][len] != '\0') {
+            fprintf(stderr, "unset: %s: not a valid identifier\n", argv[i]);
+            ret = 1;
+            continue;
         }
-        // check if fg
-        if (!strncmp(command, "fg", 2)){
-            return_val = 0;
-            //error check
-            if (change_location(FG, tokens, counter) != 0){
-                return -1;
-            }
-            
+        unset_var(vars, argv[i], len);
+    }
+    environ = get_envp(vars);
+    return ret;
+}
+
+/**
+ * The builtin_stats() function prints the latency histograms of every phase as JSON, or forgets
+ * them with -r. It only works if SH33_STATS was set when the shell started.
+ * @param argc: number of elements in argv
+ * @param argv: the stats command, and -r to reset
+ * @return 0 if no error, 1 if stats aren't collected, 2 if the option isn't -r
+*/
+int builtin_stats(int argc, char *argv[]) {
+    if (stats == NULL) {
+        fprintf(stderr, "stats: set %s to collect stats\n", STATS_ENV);
+        return 1;
+    }
+    if (argc == 2) {
+        if (strcmp(argv[1], "-r")) {
+            fprintf(stderr, "stats: %s: invalid option\n", argv[1]);
+            return 2;
         }
+        reset_stats(stats);
+        return 0;
     }
-    
-    // check if exit
-    if (strlen(command) == 4) {
-        if (!strncmp(command, "exit", 4)) {
-            return_val = 0;
-            cleanup_job_list(job_list);
-            exit(0);  // exit doesn't require error checking
+    return dump_stats(stats, stdout) == 0 ? 0 : 1;
+}
+
+/**
+ * The builtin_history() function prints the lines run so far, numbered from 1, or only the last
+ * ones. With -s, it prints the lines that contain a string instead, newest first, the way
+ * reverse incremental search steps through them.
+ * @param argc: number of elements in argv
+ * @param argv: the history command, and how many lines to print or -s and the string
+ * @return 0 if no error, 1 if history isn't kept or no line has the string, 2 for a bad argument
+*/
+int builtin_history(int argc, char *argv[]) {
+    if (history == NULL) {
+        fprintf(stderr, "history: set %s to keep history\n", HISTORY_ENV);
+        return 1;
+    }
+    size_t total = history_len(history);
+    size_t first = 0;
+    if (argc == 3) {
+        if (strcmp(argv[1], "-s")) {
+            fprintf(stderr, "history: %s: invalid option\n", argv[1]);
+            return 2;
+        }
+        int ret = 1;
+        size_t len;
+        long entry = (long)total;
+        while ((entry = search_history(history_search, argv[2], strlen(argv[2]),
+                                       (size_t)entry)) >= 0) {
+            const char *line = get_history(history, (size_t)entry, &len);
+            printf("%5ld  %.*s\n", entry + 1, (int)len, line);
+            ret = 0;
         }
+        return ret;
+    }
+    if (argc == 2) {
+        char *end;
+        long count = strtol(argv[1], &end, 10);
+        if (*argv[1] == '\0' || *end != '\0' || count < 0) {
+            fprintf(stderr, "history: %s: numeric argument required\n", argv[1]);
+            return 2;
+        }
+        first = (size_t)count < total ? total - (size_t)count : 0;
+    }
+    for (size_t i = first; i < total; i++) {
+        size_t len;
+        const char *line = get_history(history, i, &len);
+        if (line != NULL) {
+            printf("%5zu  %.*s\n", i + 1, (int)len, line);
+        }
+    }
+    return 0;
+}
+
+// the table of built-ins, in the order of BUILTINS()
+static const builtin_t builtins[] = {BUILTINS(BUILTIN_ENTRY)};
+
+/**
+ * The hash_builtin() function hashes a built-in name with FNV-1a, starting from a seed, so that
+ * init_builtins() can try seeds until no two built-ins share a slot.
+ * @param seed: the seed mixed into the hash
+ * @param name: the name to hash
+ * @return the hash of the name
+*/
+uint32_t hash_builtin(uint32_t seed, const char *name) {
+    uint32_t hash = 2166136261u ^ seed;
+    while (*name) {
+        hash ^= (unsigned char)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * The init_builtins() function builds a perfect hash of the built-in table: it looks for the first
+ * seed that puts every built-in in a slot of its own, in a table of at least twice as many slots as
+ * there are built-ins, so finding a built-in is always one probe and one strcmp(). It is called
+ * once from main(), and only depends on the table, so it always picks the same seed.
+*/
+void init_builtins() {
+    size_t num_slots = 1;
+    while (num_slots < 2 * NUM_BUILTINS) {
+        num_slots *= 2;
+    }
 
-        //check for jobs, call helper jobs()
-        if (!strncmp(command, "jobs", 4)){
-            return_val = 0;
-            jobs(job_list);
+    for (; num_slots <= MAX_BUILTIN_SLOTS; num_slots *= 2) {
+        for (uint32_t seed = 0; seed < MAX_BUILTIN_SEEDS; seed++) {
+            memset(builtin_slots, 0, sizeof(builtin_slots));
+            size_t i;
+            for (i = 0; i < NUM_BUILTINS; i++) {
+                size_t slot = hash_builtin(seed, builtins[i].name) & (num_slots - 1);
+                if (builtin_slots[slot] != 0) {
+                    break;
+                }
+                builtin_slots[slot] = (unsigned char)(i + 1);
+            }
+            if (i == NUM_BUILTINS) {
+                builtin_seed = seed;
+                builtin_mask = num_slots - 1;
+                return;
+            }
         }
     }
-    return return_val;
+
+    // only if the table outgrows MAX_BUILTIN_SLOTS
+    fprintf(stderr, "no perfect hash for the built-ins\n");
+    exit(1);
+}
+
+/**
+ * The find_builtin() function looks up a command name in the built-in table.
+ * @param name: the command as it was typed
+ * @return the built-in, NULL if the command isn't a built-in
+*/
+const builtin_t *find_builtin(const char *name) {
+    unsigned char index = builtin_slots[hash_builtin(builtin_seed, name) & builtin_mask];
+    if (index == 0 || strcmp(builtins[index - 1].name, name)) {
+        return NULL;
+    }
+    return &builtins[index - 1];
+}
+
+/**
+ * The call_builtin() function checks the number of arguments of a built-in against the built-in
+ * table and runs its handler. A built-in with the wrong number of arguments is a syntax error and
+ * doesn't run.
+ * @param builtin: the built-in to run
+ * @param argc: number of elements in argv
+ * @param argv: argv array that contains the command and its arguments
+ * @return the exit status of the built-in, 2 if it has the wrong number of arguments
+*/
+int call_builtin(const builtin_t *builtin, int argc, char *argv[]) {
+    if (argc - 1 < builtin->min_args ||
+        (builtin->max_args >= 0 && argc - 1 > builtin->max_args)) {
+        fprintf(stderr, "%s: syntax error\n", builtin->name);
+        return 2;
+    }
+    return builtin->handler(argc, argv);
 }
 
 /**
  * The redirect_helper() is a helper function that is called in
  * redirection_handler() to avoid simplify code and avoid repetitiveness. It
  * redirects a given file descriptor, and opens it with the corresponding flags
- * and permission. There is error-checking for close() and open()
+ * and permission, or installs the fd the redirection already has open with
+ * dup2(). There is error-checking for close(), open() and dup2()
  *
- * @param redirections: an array that has only redirection symbols and
- * corresponding filenames
- * @param index: will be either 0 or 2, it is the index at which the current
- * redir symbol is at in the redirections array
- * @param fd: file descriptor
- * @param flags: the flags necessary for open() for that file
+ * @param redirection: the file descriptor to redirect, the file and the flags
+ * necessary for open() for that file, or the open fd that replaces it
  * @param permission: the permissions for the file
  */
-void redirect_helper(char *redirections[], int index, int fd, int flags,
-                     int permission) {
+void redirect_helper(redirection_t *redirection, int permission) {
+    // an fd that is already open, like a here-document's, is only put in place
+    if (redirection->open_fd >= 0) {
+        if (dup2(redirection->open_fd, redirection->fd) < 0) {
+            perror("dup2");
+            cleanup_job_list(job_list);
+            exit(1);
+        }
+        return;
+    }
+
     // error check close() syscall
-    if (close(fd) != 0) {
+    if (close(redirection->fd) != 0) {
         perror("close");
         cleanup_job_list(job_list);
         exit(1);
     }
 
-    // it is index + 1, since the file is located at the index after the symbol
-    // in redirections[]
-    // error check open() syscall
-    if (open(redirections[index + 1], flags, permission) == -1) {
+    // error check open() syscall, it takes the lowest fd, the one just closed
+    if (open(redirection->file, redirection->flags, permission) == -1) {
         perror("open");
         cleanup_job_list(job_list);
         exit(1);
@@ -265,407 +718,1346 @@ void redirect_helper(char *redirections[], int index, int fd, int flags,
 }
 
 /**
- * The redirection_handler() handles the redirection of file descriptors based
- * on what redirection symbol is being read. If it is <, then fd = 0, since we
- * are redirecting input, and so on.
+ * The redirection_handler() handles the redirections of a command, in the
+ * order they were given. Input (<) replaces fd 0, output (> or >>) replaces
+ * fd 1, as worked out by parse().
  *
- * @param redirections: an array that has only redirection symbols and
- * corresponding filenames
+ * @param command: the command whose redirections are handled
  */
-void redirection_handler(char *redirections[]) {
-    int counter = 0;
-    // preparing the counter for the for loop - possible counter values are: 0,
-    // 1, 3
-    if (redirections[0] != NULL) {
-        counter++;
-        if (redirections[2] != NULL) {
-            counter += 2;
-        }
-    }
-
-    // a loop that will iterate once if there is only redir symbol, and twice if
-    // it's input AND output
-    for (int i = 0; i < counter; i += 2) {
-        char *redir_symbol = redirections[i];
-        if (strlen(redir_symbol) == 1) {
-            // < [path] where file [path] as standard input (fd 0)
-            if (*redir_symbol == '<') {
-                redirect_helper(redirections, i, 0, O_RDONLY, 0777);
-                // > [path] where file [path] is standard output (fd 1)
-            } else if (*redir_symbol == '>') {
-                redirect_helper(redirections, i, 1,
-                                O_WRONLY | O_CREAT | O_TRUNC, 0777);
-            }
-            // >> [path] where file [path] is standard output (fd 1)
-        } else if ((!strncmp(redir_symbol, ">>", strlen(redir_symbol)))) {
-            redirect_helper(redirections, i, 1, O_WRONLY | O_APPEND | O_CREAT,
-                            0777);
+void redirection_handler(command_t *command) {
+    // iterates once if there is only one redirection, and twice if it's input
+    // AND output
+    for (int i = 0; i < command->num_redirections; i++) {
+        redirect_helper(&command->redirections[i], 0777);
+    }
+}
+
+/**
+ * The run_builtin() function runs a built-in in the shell itself, so it costs no fork. Its
+ * redirections are applied in-process: the shell's own stdin and stdout are saved with
+ * F_DUPFD_CLOEXEC, the files are put in their place, and the saved fds are put back once the
+ * built-in is done. stdout is flushed on both sides, so the built-in's output goes to the right file
+ * and shows up before the output of whatever runs next.
+ * @param builtin: the built-in to run
+ * @param command: the command, with its arguments and redirections
+ * @return the exit status of the built-in, 1 if a redirection failed
+*/
+int run_builtin(const builtin_t *builtin, command_t *command) {
+    int saved[MAX_REDIRECTIONS];
+    int status = 1;
+    int failed = FALSE;
+    int i;
+
+    fflush(stdout);
+    for (i = 0; i < command->num_redirections && !failed; i++) {
+        redirection_t *redirection = &command->redirections[i];
+        // if the fd isn't open, there's nothing to save and it is closed after
+        saved[i] = fcntl(redirection->fd, F_DUPFD_CLOEXEC, SAVED_FD_MIN);
+
+        int fd = redirection->open_fd >= 0
+                     ? redirection->open_fd
+                     : open(redirection->file, redirection->flags | O_CLOEXEC, 0777);
+        if (fd < 0 || dup2(fd, redirection->fd) < 0) {
+            perror(fd < 0 ? "open" : "dup2");
+            failed = TRUE;
+        }
+        // open() may have taken the fd itself, if it wasn't open
+        if (fd >= 0 && fd != redirection->fd && fd != redirection->open_fd) {
+            close(fd);
+        }
+    }
+
+    if (!failed) {
+        status = call_builtin(builtin, command->counter, command->argv);
+        fflush(stdout);
+    }
+
+    // in reverse, in case both redirections replaced the same fd
+    while (i-- > 0) {
+        int fd = command->redirections[i].fd;
+        if (saved[i] >= 0) {
+            dup2(saved[i], fd);
+            close(saved[i]);
+        } else {
+            close(fd);
         }
     }
+    return status;
 }
 
 /**
  * The reap() function is called right before the prompt is printed in the terminal. This is called in main(). 
  * This is to ensure that there are no zombie processes left in the background. This checks for all background 
- * by calling this in a while loop with waitpid(). Checks if process changes status, terminated normally,
- * terminated by a signal, is stopped/paused. 
+ * by calling this in a while loop with wait4(). Checks if process changes status, terminated normally,
+ * terminated by a signal, is stopped/paused. The process only updates its own state in the job, the job is
+ * reported once its state as a whole changes: terminated once all of its processes have, stopped once none is running.
  * @param wret: the pid of the specific background process
  * @param wstatus: status of the process which is updated by waitpid()
+ * @param usage: resources used by the process, from wait4()
 */
-void reap(int wret, int wstatus){
+void reap(int wret, int wstatus, struct rusage *usage){
+    int reaped_jid = get_job_jid(job_list, wret);
 
-    if (WIFCONTINUED(wstatus)){
-        //change status, and printf
-        if (update_job_pid(job_list, wret, RUNNING) == 0){
-            fprintf(stdout, "[%d] (%d) resumed\n", get_job_jid(job_list, wret), wret);
-        }  
-    
+    // not part of any job
+    if (reaped_jid == -1){
+        return;
     }
-    if (WIFEXITED(wstatus)) {
-        //terminated normally
-        fprintf(stdout, "[%d] (%d) terminated with exit status %d\n", get_job_jid(job_list, wret), wret, WEXITSTATUS(wstatus));
-        remove_job_pid(job_list, wret);
-        jid--;
 
+    pid_t job_pid = get_job_pid(job_list, reaped_jid);
+    int state = update_job_status(job_list, wret, wstatus, usage);
+
+    if (state == TERMINATED) {
+        // the status of the job is the status of its last process
+        wstatus = get_job_status(job_list, reaped_jid);
+        if (WIFEXITED(wstatus)) {
+            //terminated normally
+            notify("[%d] (%d) terminated with exit status %d\n", reaped_jid, job_pid, WEXITSTATUS(wstatus));
+        }
+
+        if (WIFSIGNALED(wstatus)) {
+            //terminated by a signal
+            notify("[%d] (%d) terminated by signal %d\n", reaped_jid, job_pid, WTERMSIG(wstatus));
+        }
+        remove_job_jid(job_list, reaped_jid);
+        return;
     }
 
-    if (WIFSIGNALED(wstatus)) {
-        //terminated by a signal
-        fprintf(stdout, "[%d] (%d) terminated by signal %d\n", get_job_jid(job_list, wret), wret, WTERMSIG(wstatus));
-        remove_job_pid(job_list, wret);
-        jid--;
+    // the other processes of a job change state too, only report the job once
+    if (report_job_state(job_list, reaped_jid) == -1){
+        return;
+    }
+
+    if (state == RUNNING){
+        //change status, and printf
+        notify("[%d] (%d) resumed\n", reaped_jid, job_pid);
     }
 
-    if (WIFSTOPPED(wstatus)) {
+    if (state == STOPPED) {
         //stopped/paused
-        if (update_job_pid(job_list, wret, STOPPED) == 0){
-            fprintf(stdout, "[%d] (%d) suspended by signal %d\n", get_job_jid(job_list, wret), wret, WSTOPSIG(wstatus));
-        }
+        notify("[%d] (%d) suspended by signal %d\n", reaped_jid, job_pid, WSTOPSIG(wstatus));
     }
 }
 
 
 /**
- * handle_commands() is a function that is called in main() after parsing, to
- * handle built in and non-built commands along with redirection. It forks if it
- * is a non-built in command and calls execv() in the child process. It also handles
- * @param tokens: tokens array that contains the full file paths/command and
- * arguments
- * @param argv: argv array that contains the binary path (command), and
- * arguments
- * @param redirections: an array that has only redirection symbols and
- * corresponding filenames
- * @param is_bg: boolean that is TRUE if it is a background process (&), and FALSE if foreground
- * @param counter: number of elements in tokens and argv
- *
- * @return 0 if there is no error
+ * send_setup_times() is called by a child of fork_process() when stats are on, once its setup is
+ * done. It sends the parent when its setup started and ended.
+ * @param fd: write end of the stats pipe, close-on-exec
+ * @param setup_start: when the child started its setup, from stats_now()
  */
-int handle_commands(char *tokens[], char *argv[], char *redirections[], int counter) {
-    pid_t pid;
-    if (check_built_in(tokens, argv, counter) == 1) {
-        // child process
-        if ((pid = fork()) == 0) {
-            setpgid(0, 0);
-    
-            // only for foreground
-            if (!is_bg){
-                int grpid = getpgrp();
-                if(grpid < 0){
-                    return -1; // throw an error it grp pid is less than 0
-                }
-                tcsetpgrp(0, grpid); // only for foreground, gives terminal control    
-            }
-
-            // signal handling, reset all signals ignored in the parent process 
-            // back to their default behaviour
-            default_child_signals();
-            
-            redirection_handler(redirections);
-            execv(tokens[0], argv);
-
-            // error checking execv
-            perror("execv");
-            cleanup_job_list(job_list);
-            exit(1);
-        }
-    
-        if (is_bg){ // if bg, add to jobs list 
+void send_setup_times(int fd, uint64_t setup_start) {
+    uint64_t times[2] = {setup_start, stats_now(stats)};
+    // if this fails only the stats of this command are lost
+    if (write(fd, times, sizeof(times)) != sizeof(times)) {
+        return;
+    }
+}
 
-            // if background state is runnning, add to job_list
-            if (add_job(job_list, jid, pid, RUNNING, tokens[0]) == -1){
-                return -1; // error check
-            }
+/**
+ * receive_setup_times() is called by fork_process() when stats are on, to record how long the
+ * child's setup took and, by waiting for the pipe to close on exec, how long the exec took.
+ * @param fd: read end of the stats pipe
+ * @param execs: TRUE if the child is going to exec, FALSE if it runs a built-in
+ */
+void receive_setup_times(int fd, int execs) {
+    uint64_t times[2];
+    char c;
 
-            // print background process that just started running
-            fprintf(stdout, "[%d] (%d)\n", jid, get_job_pid(job_list, jid));
-            jid++;
-            
-        }
-
-        else{
-            int wret; 
-            int wstatus;
-            // call waitpid once for foreground process
-            wret = waitpid(pid, &wstatus, WUNTRACED);
-
-            if (WIFSTOPPED(wstatus)) {
-                // stopped/paused
-                // if foreground, add to the job_list
-                add_job(job_list, jid, wret, STOPPED, tokens[0]);
-                fprintf(stdout, "[%d] (%d) suspended by signal %d\n", jid, wret, WSTOPSIG(wstatus));
-                jid++;
-            }
-            if (WIFSIGNALED(wstatus)) {
-                // terminated by a signal
-                fprintf(stdout, "[%d] (%d) terminated by signal %d\n", jid, wret, WTERMSIG(wstatus));
-            } 
-            
-        }
-        // give back terminal control
-        int grpid = getpgrp();
-        if(grpid < 0){
-            return -1; // throw an error if group pid is less than 0
+    if (read(fd, times, sizeof(times)) != sizeof(times)) {
+        return;
+    }
+    record_stat_ns(stats, STAT_CHILD_SETUP, times[1] - times[0]);
+    if (execs) {
+        // end of file once the exec closed the child's write end
+        while (read(fd, &c, 1) > 0) {
         }
-        tcsetpgrp(0, grpid);
-
+        record_stat(stats, STAT_EXEC, times[1]);
     }
-        
-    return 0;
 }
 
-
 /**
- * The parse() function is responsible for parsing the user input once it is
- * read from the REPL. It is called within main(). It builds the tokens, argv
- * and redirections arrays through this. It is also responsible for catching
- * syntax errors and invalid user input early on for better time efficiency and
- * fewer wasteful operations are executed. Checks for & command for background processes
- *
- * @param buffer: input array
- * @param tokens: tokens array that contains the full file paths/command and
- * arguments
- * @param argv: argv array that contains the binary path (command), and
- * arguments
- * @param redirections: an array that has only redirection symbols and
- * corresponding filenames
+ * fork_process() launches a non-built-in command the traditional way: it forks,
+ * and the child joins the job's process group, takes terminal control if it
+ * leads a foreground job, resets its signals, connects its pipes, handles
+ * redirections and calls execv(). It is the fallback for everything
+ * spawn_process() can't do.
+ * @param command: the command to launch, with its path already resolved
+ * @param foreground: TRUE if the command belongs to a foreground job
+ * @param pgid: process group of the job, 0 if this command starts the job
+ * @param in_fd: read end of the pipe from the previous command, or -1
+ * @param out_fd: write end of the pipe to the next command, or -1
  *
- * @return 0 if there is no error in parsing
+ * @return the pid of the child, -1 if fork() failed
  */
-int parse(char buffer[BUFFER_SIZE], char *tokens[], char *argv[],
-          char *redirections[]) {
-    // setting up local variables
-    char *one_token;       // the current token
-    char *previous_token;  // token before current token
-    char *last_char;
-    is_bg = FALSE;
-
-    // index counter for the tokens and argv array
-    int counter = 0;
-    // counter for number of input redir (shouldn't be more than 1)
-    int input_redir_count = 0;
-    // counter for number of output redir (shouldn't be more than 1)
-    int output_redir_count = 0;
-    // index counter for the redirections array
-    int redirect_count = 0;
-
-    // strtok takes care of the white space and tabs
-    while ((one_token = strtok(buffer, " \t\n")) != NULL) {
-        tokens[counter] = one_token;
-
-        // error check if there's more than one input redir or output redir
-        // symbol
-        if (input_redir_count > 1) {
-            fprintf(stderr, "syntax error: multiple input files\n");
-            return 1;
-        }
-
-        if (output_redir_count > 1) {
-            fprintf(stderr, "syntax error: multiple output files\n");
-            return 1;
-        }
-
-        if (counter > 0) {
-            previous_token = tokens[counter - 1];
-
-            // if the token before one_token was redir symbol, then don't add
-            // filename token to argv add only to redirections array to use for
-            // redirections later
-            if (*previous_token == '>' || *previous_token == '<') {
-                if (*one_token == '>' || *one_token == '<') {
-                    fprintf(stderr,
-                            "Syntax error: file is a redirection symbol\n");
-                    return 1;
-                }
+pid_t fork_process(command_t *command, int foreground, pid_t pgid, int in_fd,
+                   int out_fd) {
+    pid_t pid;
+    // with stats on, the child sends when its setup started and ended through
+    // this pipe, and the pipe closing on exec tells the parent the exec is done
+    int stats_fds[2] = {-1, -1};
+    if (stats != NULL && pipe2(stats_fds, O_CLOEXEC) != 0) {
+        stats_fds[0] = stats_fds[1] = -1;
+    }
+    uint64_t start = stats_now(stats);
 
-                redirections[redirect_count] = one_token;
-                redirect_count++;
-                counter--;  // reduce counter index, so that tokens[counter] can
-                            // be overwritten as we
-                // don't need redirection symbols and filenames in tokens
-                buffer = NULL;
-                // continue should just skip the stuff underneath and run next
-                // iteration of the loop
-                continue;
-            }
+    // child process
+    if ((pid = fork()) == 0) {
+        uint64_t setup_start = stats_now(stats);
+        setpgid(0, pgid);
+
+        // the command's own assignments, for the exec and a utility alike
+        if (command->envp != NULL) {
+            environ = command->envp;
         }
 
-        // check if it is redirection symbol, don't add to argv, add to
-        // redirections
-        if (*one_token == '>') {
-            redirections[redirect_count] = one_token;
-            redirect_count++;
-            output_redir_count++;
-            // error check for redirect_count > 1
-            counter++;
-            buffer = NULL;
-            // continue should just skip the stuff underneath and run next
-            // iteration of the loop
-            continue;
-            // check if it is redirection symbol, don't add to argv, add to
-            // redirections
-        } else if (*one_token == '<') {
-            redirections[redirect_count] = one_token;
-            redirect_count++;
-            input_redir_count++;
-            // error check for redirect_count > 1
-            counter++;
-            buffer = NULL;
-            // continue should just skip the stuff underneath and run next
-            // iteration of the loop
-            continue;
+        // only for the first command of a foreground job
+        if (foreground && pgid == 0){
+            int grpid = getpgrp();
+            if(grpid < 0){
+                exit(1); // throw an error it grp pid is less than 0
+            }
+            tcsetpgrp(0, grpid); // only for foreground, gives terminal control
         }
 
-        // if it's the 0th index, need to make sure full file path doesn't go
-        // into argv
-        if (counter == 0) {
-            // finds last occurence of c in str and returns pointer to it
-            last_char = strrchr(one_token, '/');
+        // signal handling, reset all signals ignored in the parent process
+        // back to their default behaviour
+        default_child_signals();
 
-            if (last_char == NULL) {
-                // should be same as tokens if no / is found
-                argv[counter] = tokens[counter];
+        // the pipe ends are close-on-exec, only the dup2() copies survive
+        if (in_fd >= 0 && dup2(in_fd, STDIN_FILENO) < 0) {
+            perror("dup2");
+            exit(1);
+        }
+        if (out_fd >= 0 && dup2(out_fd, STDOUT_FILENO) < 0) {
+            perror("dup2");
+            exit(1);
+        }
 
-            } else {
-                argv[counter] =
-                    last_char + 1;  // since last_char[0] is '/', want to
-                // pointer to be after that
+        redirection_handler(command);
+        if (stats_fds[1] >= 0) {
+            send_setup_times(stats_fds[1], setup_start);
+        }
+
+        // a utility built-in runs right here, exit() flushes its output
+        if (command->builtin != NULL) {
+            if (stats_fds[1] >= 0) {
+                close(stats_fds[1]);
             }
+            exit(call_builtin(command->builtin, command->counter, command->argv));
+        }
 
-            // for anything after first token, we don't care if it has a /, so
-            // argv should have same thing as tokens
-        } else {
-            argv[counter] = tokens[counter];
+        // the handle skips resolving the path again, execv() if it can't be used
+        if (command->exec_fd >= 0) {
+            execveat(command->exec_fd, "", command->argv, environ,
+                     AT_EMPTY_PATH);
         }
-        counter++;
-        buffer = NULL;  // if str is NULL, strtok will return a pointer to
-        // token right after the one returned in the previous call, or NULL if
-        // no more tokens
+        execv(command->path, command->argv);
+
+        // error checking execv
+        perror("execv");
+        cleanup_job_list(job_list);
+        exit(1);
     }
 
-    // error check to make sure there is a filename after the redirect
-    // symbol
-    if (input_redir_count > 0 || output_redir_count > 0) {
-        if (redirect_count != 2 && redirect_count != 4) {
-            fprintf(stderr, "No file name given after redirect\n");
-            return 1;
+    if (pid > 0) {
+        record_stat(stats, STAT_LAUNCH, start);
+    }
+    if (stats_fds[0] >= 0) {
+        close(stats_fds[1]);
+        if (pid > 0) {
+            receive_setup_times(stats_fds[0], command->builtin == NULL);
         }
+        close(stats_fds[0]);
     }
 
-    // error check if it was all whitespace/tabs
-    if (tokens[0] == NULL) {
-        return 1;
+    if (pid < 0) {
+        perror("fork");
+        return -1;
     }
+    // also set the group from the parent, so the next command of the pipeline
+    // can join it even if this child hasn't run yet
+    setpgid(pid, pgid == 0 ? pid : pgid);
+    return pid;
+}
 
-    argv[counter] = NULL;  // ends argv with null
-
-    // check if it is a background process
-    if (*argv[counter - 1] == '&'){
-        is_bg = TRUE;
-        // remove the & character from the argv array, since it is not an argument
-        argv[counter - 1] = NULL;
+/**
+ * spawn_process() launches a non-built-in command with posix_spawn(), which
+ * avoids copying the shell's page tables and does the child setup of
+ * fork_process() without running any shell code in the child. The process
+ * group, the signal defaults, terminal control, the pipes and the redirections
+ * are all expressed as spawn attributes and file actions.
+ * @param command: the command to launch, with its path already resolved
+ * @param foreground: TRUE if the command belongs to a foreground job
+ * @param pgid: process group of the job, 0 if this command starts the job
+ * @param in_fd: read end of the pipe from the previous command, or -1
+ * @param out_fd: write end of the pipe to the next command, or -1
+ *
+ * @return the pid of the child, 0 if the command has to be launched with
+ * fork_process() instead, -1 if the launch failed
+ */
+pid_t spawn_process(command_t *command, int foreground, pid_t pgid, int in_fd,
+                    int out_fd) {
+    posix_spawnattr_t attr;
+    posix_spawn_file_actions_t actions;
+    sigset_t default_signals;
+    sigset_t child_mask;
+    pid_t pid = 0;
+    int takes_terminal = foreground && pgid == 0 && isatty(STDIN_FILENO);
+    int error;
+
+    // a built-in needs the shell's code in the child
+    if (command->builtin != NULL) {
+        return 0;
+    }
+#ifndef HAVE_SPAWN_TCSETPGRP
+    // handing over the terminal can't be expressed as a file action
+    if (takes_terminal) {
+        return 0;
     }
+#endif
 
+    if (posix_spawnattr_init(&attr) != 0) {
+        return 0;
+    }
+    if (posix_spawn_file_actions_init(&actions) != 0) {
+        posix_spawnattr_destroy(&attr);
+        return 0;
+    }
 
-    // only if parsing is correct and inputs are valid do we
-    // continue to run the command
+    // same signals as default_child_signals()
+    sigemptyset(&default_signals);
+    sigaddset(&default_signals, SIGINT);
+    sigaddset(&default_signals, SIGTSTP);
+    sigaddset(&default_signals, SIGTTOU);
+    sigemptyset(&child_mask);
+
+    // setpgid(0, pgid) in the child
+    posix_spawnattr_setpgroup(&attr, pgid);
+    posix_spawnattr_setsigdefault(&attr, &default_signals);
+    posix_spawnattr_setsigmask(&attr, &child_mask);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP |
+                                        POSIX_SPAWN_SETSIGDEF |
+                                        POSIX_SPAWN_SETSIGMASK);
+
+#ifdef HAVE_SPAWN_TCSETPGRP
+    // only for foreground, gives terminal control before stdin is redirected
+    if (takes_terminal) {
+        posix_spawn_file_actions_addtcsetpgrp_np(&actions, STDIN_FILENO);
+    }
+#endif
 
-    handle_commands(tokens, argv, redirections, counter);
+    // the pipe ends are close-on-exec, only the dup2() copies survive
+    if (in_fd >= 0) {
+        posix_spawn_file_actions_adddup2(&actions, in_fd, STDIN_FILENO);
+    }
+    if (out_fd >= 0) {
+        posix_spawn_file_actions_adddup2(&actions, out_fd, STDOUT_FILENO);
+    }
 
-    return 0;
+    // same redirections as redirection_handler(), they win over the pipes
+    for (int i = 0; i < command->num_redirections; i++) {
+        redirection_t *redirection = &command->redirections[i];
+        if (redirection->open_fd >= 0) {
+            posix_spawn_file_actions_adddup2(&actions, redirection->open_fd,
+                                             redirection->fd);
+        } else {
+            posix_spawn_file_actions_addopen(&actions, redirection->fd,
+                                             redirection->file, redirection->flags,
+                                             0777);
+        }
+    }
+
+    error = posix_spawn(&pid, command->path, &actions, &attr, command->argv,
+                        command->envp != NULL ? command->envp : environ);
+
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+
+    if (error != 0) {
+        fprintf(stderr, "spawn: %s\n", strerror(error));
+        return -1;
+    }
+    return pid;
 }
 
 /**
- * The main() function is responsible for reading user input through the REPL,
- * and showing the 33sh prompt.
+ * launch_pipeline() launches every command of a pipeline into one process
+ * group, connecting each command's stdout to the next command's stdin. Each
+ * command is launched with spawn_process(), or with fork_process() if posix_spawn
+ * is turned off or can't express the launch.
+ * @param pipeline: the pipeline to launch, with the paths of its commands
+ * resolved
  *
- * @return 0 if no error
+ * @return the process group of the pipeline, -1 if no command was launched
  */
-int main() {
-    char buf[BUFFER_SIZE];
-    ssize_t input_size;  // size of user input
-
-    init_ignoring_signal();
-    job_list = init_job_list();
-    jid = 1;
-
-    // show prompt initially when the program first runs:
-    #ifdef PROMPT
-        if (printf("33sh> ") < 0) {
-            fprintf(stderr, "ERROR printing prompt\n");
-        }
-
-        if (fflush(stdout) < 0) {
-            fprintf(stderr, "ERROR printing prompt\n");
-        }
-    #endif
-
-    // REPL, keep reading input till read returns
-    while ((input_size = read(STDIN_FILENO, buf, BUFFER_SIZE)) > 0) {
-        // initialize all arrays with size of input_size, since it cannot be
-        // larger than that, for better memory efficiency
-        char *argv[input_size];
-        char *redirections[input_size];  // contains redir symbols with file
-                                         // name after
-        char *tokens[input_size];
-
-        // initializing all arrays to 0x0 so they are null terminated
-        memset(tokens, 0, ((long unsigned int)input_size) * sizeof(char *));
-        memset(argv, 0, ((long unsigned int)input_size) * sizeof(char *));
-        memset(redirections, 0,
-               ((long unsigned int)input_size) * sizeof(char *));
-
-        // case for no input, only hit enter - should skip everything and
-        // reprint prompt
-        if (!(input_size == 1 && buf[0] == '\n')) {
-            if (buf != NULL) {
-                buf[input_size - 1] = '\0';  // null terminate buffer
-
-                parse(buf, tokens, argv, redirections);
-                    
-            } else {
-                continue;
+pid_t launch_pipeline(pipeline_t *pipeline) {
+    command_t *commands = pipeline->commands;
+    int num_commands = pipeline->num_commands;
+    int foreground = !pipeline->is_bg;
+    pid_t pgid = 0;
+    int in_fd = -1;
+
+    // a forked child would print whatever is still buffered again
+    fflush(stdout);
+
+    for (int i = 0; i < num_commands; i++) {
+        int pipe_fds[2] = {-1, -1};
+        pid_t pid = 0;
+
+        // close-on-exec, so no command inherits a pipe end it doesn't use
+        if (i < num_commands - 1 && pipe2(pipe_fds, O_CLOEXEC) != 0) {
+            perror("pipe2");
+            break;
+        }
+
+        if (use_spawn) {
+            // posix_spawn() returns once the child has exec'd, so this
+            // includes the child's setup and the exec
+            uint64_t start = stats_now(stats);
+            pid = spawn_process(&commands[i], foreground, pgid, in_fd, pipe_fds[1]);
+            if (pid > 0) {
+                record_stat(stats, STAT_LAUNCH, start);
+            }
+        }
+        if (pid == 0) {
+            pid = fork_process(&commands[i], foreground, pgid, in_fd, pipe_fds[1]);
+        }
+
+        // the shell keeps only the read end for the next command
+        if (in_fd >= 0) {
+            close(in_fd);
+        }
+        if (pipe_fds[1] >= 0) {
+            close(pipe_fds[1]);
+        }
+        in_fd = pipe_fds[0];
+
+        commands[i].pid = pid;
+        if (pid > 0 && pgid == 0) {
+            pgid = pid;
+        }
+    }
+
+    if (in_fd >= 0) {
+        close(in_fd);
+    }
+    return pgid == 0 ? -1 : pgid;
+}
+
+/**
+ * The set_number_var() function sets a variable to a number, which is how the shell keeps $?, $$
+ * and $!.
+ * @param name: the name of the variable
+ * @param value: the number
+*/
+void set_number_var(const char *name, long value){
+    char buffer[32];
+    int len = snprintf(buffer, sizeof(buffer), "%ld", value);
+    set_var(vars, name, strlen(name), buffer, (size_t)len);
+}
+
+/**
+ * The assign() function sets the shell variables of a command that is only NAME=value
+ * assignments, in order. The values were expanded when the line was parsed, so they all see the
+ * variables as they were before the line.
+ * @param command: the command, which has no words
+*/
+void assign(command_t *command){
+    for (int i = 0; i < command->num_assignments; i++){
+        // a name can't have an =, so the first one ends it
+        char *assignment = command->assignments[i];
+        char *value = strchr(assignment, '=') + 1;
+        set_var(vars, assignment, (size_t)(value - 1 - assignment), value, strlen(value));
+    }
+    // an exported variable that was unset may have made the environment move
+    environ = get_envp(vars);
+}
+
+/**
+ * The resolve_commands() function gets every command of a pipeline ready to launch: commands
+ * without a / are looked up in PATH, missing ones fail here before anything in the pipeline is
+ * launched, and built-ins don't need to be, they run in a child of their own. Assignments before a
+ * command become its environment.
+ * @param pipeline: the commands of the pipeline, in order
+ * @param builtins: TRUE if every built-in runs in a child, FALSE if only the utilities do
+ *
+ * @return 0 on success, 127 if a command wasn't found
+ */
+int resolve_commands(pipeline_t *pipeline, int builtins) {
+    command_t *commands = pipeline->commands;
+    char **shell_environ = environ;
+
+    for (int i = 0; i < pipeline->num_commands; i++) {
+        commands[i].path = commands[i].tokens[0];
+        commands[i].exec_fd = -1;
+        commands[i].envp = NULL;
+        if (commands[i].num_assignments > 0) {
+            commands[i].envp = overlay_envp(vars, line_arena, commands[i].assignments,
+                                            commands[i].num_assignments);
+        }
+        const builtin_t *builtin = find_builtin(commands[i].tokens[0]);
+        commands[i].builtin = builtin != NULL && (builtins || builtin->utility) ? builtin : NULL;
+        if (commands[i].builtin == NULL && strchr(commands[i].path, '/') == NULL) {
+            // PATH=dir cmd looks cmd up in dir
+            environ = commands[i].envp != NULL ? commands[i].envp : shell_environ;
+            commands[i].path = lookup_command(cmd_hash, commands[i].tokens[0],
+                                              &commands[i].exec_fd);
+            environ = shell_environ;
+            if (commands[i].path == NULL) {
+                fprintf(stderr, "%s: command not found\n",
+                        commands[i].tokens[0]);
+                return 127;
             }
         }
+    }
+    return 0;
+}
+
+/**
+ * The start_job() function launches a pipeline with launch_pipeline() and adds it to the job list
+ * as one job, under its process group, with every process it launched.
+ * @param pipeline: the pipeline, with its commands resolved
+ *
+ * @return the jid of the job, -1 if nothing was launched or the job couldn't be added
+ */
+int start_job(pipeline_t *pipeline) {
+    command_t *commands = pipeline->commands;
+    pid_t pgid = launch_pipeline(pipeline);
+    if (pgid < 0) {
+        return -1;
+    }
 
-        //reaping
-        int wret_2;
-        int wstatus_2;
-        while((wret_2 = waitpid(-1, &wstatus_2, WNOHANG|WUNTRACED|WCONTINUED)) > 0){
-            reap(wret_2, wstatus_2);
+    // the lowest free jid, a finished job's jid is free again right away
+    int jid = get_next_jid(job_list);
+
+    // every launched process of the pipeline belongs to the one job
+    if (add_job(job_list, jid, pgid, RUNNING, commands[0].tokens[0]) == -1){
+        return -1; // error check
+    }
+    for (int i = 0; i < pipeline->num_commands; i++) {
+        if (commands[i].pid > 0 && commands[i].pid != pgid) {
+            add_job_process(job_list, jid, commands[i].pid, RUNNING);
         }
+    }
+    return jid;
+}
+
+/**
+ * handle_commands() is a function that is called in main() after parsing, to
+ * handle built in and non-built commands along with redirection. Built-ins
+ * are only run on their own; anything else is looked up and launched with
+ * launch_pipeline(), as one job no matter how many commands it has. Foreground
+ * jobs are waited on with wait_foreground(). A line of only assignments sets
+ * them in the shell, unless it runs in the background. Assignments before a
+ * command only go in its environment, an overlay of the shell's cached one,
+ * and are ignored by built-ins that run in the shell.
+ * @param pipeline: the commands of the pipeline, in order
+ * @param usage: set to the resources a foreground job used, if it isn't NULL
+ *
+ * @return the exit status of the line, like $? has it
+ */
+int handle_commands(pipeline_t *pipeline, struct rusage *usage) {
+    command_t *commands = pipeline->commands;
+    int num_commands = pipeline->num_commands;
+    uint64_t start = stats_now(stats);
+    int status = 0;
+
+    // like in sh, the status of a line of assignments is that of its last $(...)
+    if (commands[0].counter == 0) {
+        if (!pipeline->is_bg) {
+            assign(&commands[0]);
+        }
+        return substitution_status;
+    }
+
+    // a built-in on its own runs in the shell, except for a utility in the
+    // background, which runs in a child like in a pipeline
+    const builtin_t *builtin = find_builtin(commands[0].tokens[0]);
+    if (num_commands == 1 && builtin != NULL &&
+        !(pipeline->is_bg && builtin->utility)) {
+        record_stat(stats, STAT_LOOKUP, start);
+        start = stats_now(stats);
+        status = run_builtin(builtin, &commands[0]);
+        record_stat(stats, STAT_BUILTIN, start);
+        return status;
+    }
+
+    status = resolve_commands(pipeline, FALSE);
+    if (status != 0) {
+        return status;
+    }
+    record_stat(stats, STAT_LOOKUP, start);
+
+    // if nothing was launched (jid < 0), only take back the terminal
+    int jid = start_job(pipeline);
+    if (jid > 0){
+        if (pipeline->is_bg){ // if bg, keep it in the jobs list
+            // print background process that just started running
+            fprintf(stdout, "[%d] (%d)\n", jid, get_job_pid(job_list, jid));
+            // $! is the last process of the pipeline, like in sh
+            for (int i = num_commands - 1; i >= 0; i--) {
+                if (commands[i].pid > 0) {
+                    set_number_var("!", commands[i].pid);
+                    break;
+                }
+            }
+        } else {
+            // jobs finishing in the foreground are taken out of the list
+            status = wait_foreground(jid, usage);
+        }
+    } else {
+        status = 1;
+    }
+
+    // give back terminal control
+    int grpid = getpgrp();
+    if(grpid < 0){
+        return 1; // throw an error if group pid is less than 0
+    }
+    tcsetpgrp(0, grpid);
+
+    return status;
+}
 
-// shows prompt
+/**
+ * The open_history() function opens the history file, ~/.33sh_history for a shell on a terminal
+ * that was built with PROMPT, or the file SH33_HISTFILE names in any shell.
+ * @return the history, NULL if it isn't kept or the file can't be opened
+*/
+history_t *open_history(){
+    char *path = getenv(HISTORY_ENV);
+    if (path != NULL) {
+        return init_history(path);
+    }
 #ifdef PROMPT
-        if (printf("33sh> ") < 0) {
-            fprintf(stderr, "ERROR printing prompt\n");
+    char *home = getenv("HOME");
+    char file[PATH_MAX];
+    if (home != NULL && isatty(STDIN_FILENO) &&
+        snprintf(file, sizeof(file), "%s/%s", home, HISTORY_FILE) < (int)sizeof(file)) {
+        return init_history(file);
+    }
+#endif
+    return NULL;
+}
+
+/**
+ * The complete_line() function finds what the word before the cursor can be completed to, for
+ * the line editor. The line is scanned the way the parser reads it, so the word is unquoted and
+ * it is known whether it is where a command goes. A word starting with % completes to the JIDs
+ * of jobs, one where a command goes to a built-in or a command in PATH, unless it has a /, and
+ * any other word to a path, which must be a directory or an executable where a command goes.
+ * @param line: what was typed before the cursor
+ * @param len: its length
+ * @param matches: where the words it can be completed to are added
+ * @return where the word starts in line
+*/
+size_t complete_line(const char *line, size_t len, matches_t *matches){
+    char word[PATH_MAX];
+    size_t word_len = 0;
+    size_t start = len;
+    int in_word = FALSE;
+    int command = TRUE;   // the word is where a command goes
+    int redirect = FALSE; // the word is the file of a redirection
+    char quote = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        char c = line[i];
+        int blank = c == ' ' || c == '\t';
+        int operator = c == '|' || c == '&' || c == '<' || c == '>';
+        if (quote == 0 && (blank || operator)) {
+            if (in_word) {
+                word[word_len] = '\0';
+                size_t name_len = var_name_len(word);
+                // NAME=value before a command leaves the next word the command
+                if (!redirect && !(name_len > 0 && word[name_len] == '=')) {
+                    command = FALSE;
+                }
+                redirect = FALSE;
+                in_word = FALSE;
+            }
+            if (c == '|' || c == '&') {
+                command = TRUE;
+            } else if (operator) {
+                redirect = TRUE;
+            }
+            continue;
+        }
+        if (!in_word) {
+            in_word = TRUE;
+            start = i;
+            word_len = 0;
+        }
+        if (quote == 0 && (c == '\'' || c == '"')) {
+            quote = c;
+            continue;
+        }
+        if (c == quote) {
+            quote = 0;
+            continue;
+        }
+        if (c == '\\' && i + 1 < len &&
+            (quote == 0 || (quote == '"' && strchr("\"\\$", line[i + 1]) != NULL))) {
+            c = line[++i];
+        }
+        if (word_len + 1 >= sizeof(word)) {
+            return len;
+        }
+        word[word_len++] = c;
+    }
+    if (!in_word) {
+        start = len;
+        word_len = 0;
+    }
+    word[word_len] = '\0';
+
+    if (word[0] == '%') {
+        char spec[32];
+        int jid;
+        // goes through every job, which leaves the iterator at the head again
+        while ((jid = get_next_job_jid(job_list)) != -1) {
+            int spec_len = snprintf(spec, sizeof(spec), "%%%d", jid);
+            if ((size_t)spec_len >= word_len && !strncmp(spec, word, word_len)) {
+                add_match(matches, spec, (size_t)spec_len);
+            }
+        }
+    } else if (command && !redirect && strchr(word, '/') == NULL) {
+        for (size_t i = 0; i < NUM_BUILTINS; i++) {
+            if (!strncmp(builtins[i].name, word, word_len)) {
+                add_match(matches, builtins[i].name, strlen(builtins[i].name));
+            }
+        }
+        complete_command(completion, word, word_len, matches);
+    } else {
+        complete_path(completion, word, word_len, command && !redirect, matches);
+    }
+    return start;
+}
+
+/**
+ * The open_editor() function sets up the line editor, which reads a terminal key by key in raw
+ * mode, for a shell built with PROMPT whose stdin and stdout are a terminal that isn't dumb.
+ * @return the editor, NULL if lines are read whole instead
+*/
+editor_t *open_editor(){
+#ifdef PROMPT
+    char *term = getenv("TERM");
+    if (isatty(STDIN_FILENO) && isatty(STDOUT_FILENO) &&
+        !(term != NULL && !strcmp(term, "dumb"))) {
+        completion = init_completion();
+        return init_editor(STDIN_FILENO, STDOUT_FILENO, history, history_search,
+                           complete_line);
+    }
+#endif
+    return NULL;
+}
+
+/**
+ * The remember_line() function adds a line to the history before it runs, unless history isn't
+ * kept or the line is blank.
+ * @param line: the line, which parse() hasn't changed yet
+ * @param len: its length
+*/
+void remember_line(const char *line, size_t len){
+    if (history != NULL && strspn(line, " \t") < len) {
+        add_history(history, line, len);
+    }
+}
+
+/**
+ * The print_prompt() function shows the 33sh prompt, if the shell was built with the PROMPT macro.
+*/
+void print_prompt(){
+#ifdef PROMPT
+    if (printf(PROMPT_TEXT) < 0) {
+        fprintf(stderr, "ERROR printing prompt\n");
+    }
+
+    if (fflush(stdout) < 0) {
+        fprintf(stderr, "ERROR printing prompt\n");
+    }
+#endif
+}
+
+/**
+ * The reap_children() function reaps every child that changed state, passing each one to reap(). It
+ * empties signal_fd first, so that the next SIGCHLD wakes the event loop again.
+*/
+void reap_children(){
+    struct signalfd_siginfo info;
+    uint64_t start = stats_now(stats);
+    while (signal_fd >= 0 && read(signal_fd, &info, sizeof(info)) == sizeof(info)){
+        // one SIGCHLD can stand for several children, waitpid() finds them all
+    }
+
+    int wret;
+    int wstatus;
+    struct rusage usage;
+    while((wret = wait4(-1, &wstatus, WNOHANG|WUNTRACED|WCONTINUED, &usage)) > 0){
+        reap(wret, wstatus, &usage);
+    }
+    record_stat(stats, STAT_REAP, start);
+}
+
+/**
+ * The init_events() function sets up the event loop: SIGCHLD is blocked and read from signal_fd
+ * instead, and epoll waits on both stdin and signal_fd. If stdin can't be waited on, like a regular
+ * file, epoll_fd is -1 and the shell just reads stdin and reaps after every command.
+*/
+void init_events(){
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    epoll_fd = -1;
+
+    if (sigprocmask(SIG_BLOCK, &mask, NULL) != 0){
+        perror("sigprocmask");
+    }
+    signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signal_fd < 0){
+        perror("signalfd");
+        return;
+    }
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0){
+        perror("epoll_create1");
+        return;
+    }
+
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = signal_fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, signal_fd, &event) != 0){
+        perror("epoll_ctl");
+    }
+    event.data.fd = STDIN_FILENO;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, STDIN_FILENO, &event) != 0){
+        // regular files are always readable and can't be added
+        close(epoll_fd);
+        epoll_fd = -1;
+    }
+}
+
+/**
+ * The wait_for_input() function runs the event loop until stdin has input. Children are reaped the
+ * moment they change state, so the job list is always up to date and no zombies are left behind
+ * while the shell waits. If notify_now is set, the messages about them are printed right away on
+ * their own line, followed by a new prompt.
+ * @return 0 once stdin can be read, -1 if waiting failed
+*/
+int wait_for_input(){
+    struct epoll_event events[MAX_EVENTS];
+
+    while (epoll_fd >= 0){
+        int num_events = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+        if (num_events < 0){
+            return -1;
         }
 
-        if (fflush(stdout) < 0) {
-            fprintf(stderr, "ERROR printing prompt\n");
+        int input = FALSE;
+        for (int i = 0; i < num_events; i++){
+            if (events[i].data.fd == signal_fd){
+                reap_children();
+            } else {
+                input = TRUE;
+            }
         }
+
+        if (notify_now && notifications_len > 0){
+            // the line being edited is shown again below the notifications
+            if (editor != NULL) {
+                editor_hide(editor);
+                flush_notifications();
+                editor_show(editor);
+            } else {
+#ifdef PROMPT
+                printf("\n");
 #endif
+                flush_notifications();
+                print_prompt();
+            }
+        }
 
+        if (input){
+            return 0;
+        }
+    }
+    return 0;
+}
+
+/**
+ * The print_time() function prints one line of the report of time_pipeline(), like bash does.
+ * @param label: what the time is
+ * @param time: the time
+*/
+void print_time(const char *label, struct timeval *time){
+    fprintf(stderr, "%s\t%ldm%ld.%03lds\n", label, (long)time->tv_sec / 60, (long)time->tv_sec % 60,
+            (long)time->tv_usec / 1000);
+}
+
+/**
+ * The time_pipeline() function runs a foreground pipeline that started with the time keyword, and
+ * once it is done or stopped prints to stderr how long it took, the user and system CPU time it
+ * used, and the most memory any of its processes used. The resources used by launched commands come
+ * from wait4(), those used by the shell itself, for a built-in or for launching, from getrusage().
+ * @param pipeline: the pipeline to run
+ * @return the exit status of the pipeline
+*/
+int time_pipeline(pipeline_t *pipeline){
+    struct timespec start;
+    struct timespec end;
+    struct rusage self_before;
+    struct rusage self_after;
+    struct rusage usage;
+    struct timeval self;
+    struct timeval real;
+
+    memset(&usage, 0, sizeof(usage));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    getrusage(RUSAGE_SELF, &self_before);
+
+    int status = handle_commands(pipeline, &usage);
+
+    getrusage(RUSAGE_SELF, &self_after);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    timersub(&self_after.ru_utime, &self_before.ru_utime, &self);
+    timeradd(&usage.ru_utime, &self, &usage.ru_utime);
+    timersub(&self_after.ru_stime, &self_before.ru_stime, &self);
+    timeradd(&usage.ru_stime, &self, &usage.ru_stime);
+    // no process finished, so it was a built-in that ran in the shell
+    if (usage.ru_maxrss == 0){
+        usage.ru_maxrss = self_after.ru_maxrss;
+    }
+
+    long nsec = end.tv_nsec - start.tv_nsec;
+    real.tv_sec = end.tv_sec - start.tv_sec - (nsec < 0);
+    real.tv_usec = (nsec < 0 ? nsec + 1000000000L : nsec) / 1000;
+
+    fprintf(stderr, "\n");
+    print_time("real", &real);
+    print_time("user", &usage.ru_utime);
+    print_time("sys", &usage.ru_stime);
+    fprintf(stderr, "maxrss\t%ldKB\n", usage.ru_maxrss);
+    return status;
+}
+
+// a $(...) in a here-document runs a command, which may have here-documents of its own
+int substitute_output(char *command, char **output, size_t *len);
+
+/**
+ * The read_here_docs() function reads the bodies of the here-documents of a pipeline, in the order
+ * they are in the line, each from the lines after it up to its delimiter, and expands them unless
+ * their delimiter was quoted. The end of input also ends a body, as a warning.
+ * @param pipeline: the pipeline, as parse() built it
+ * @param more: gets the next line of input
+ * @param data: passed to more
+ * @return 0 on success, -1 if a body had a syntax error
+*/
+int read_here_docs(pipeline_t *pipeline, line_source_t more, void *data) {
+    char *body = NULL;
+    size_t size = 0;
+
+    for (int c = 0; c < pipeline->num_commands; c++) {
+        command_t *command = &pipeline->commands[c];
+        for (int r = 0; r < command->num_redirections; r++) {
+            redirection_t *redirection = &command->redirections[r];
+            if (redirection->here != HERE_DOC) {
+                continue;
+            }
+
+            size_t body_len = 0;
+            char *line;
+            size_t len;
+            while (TRUE) {
+                line = more == NULL ? NULL : more(data, &len);
+                if (line == NULL) {
+                    fprintf(stderr, "warning: here-document ended by end of input (wanted '%s')\n",
+                            redirection->file);
+                    break;
+                }
+                if (redirection->strip_tabs) {
+                    while (*line == '\t') {
+                        line++;
+                        len--;
+                    }
+                }
+                if (!strcmp(line, redirection->file)) {
+                    break;
+                }
+                // the line, its newline and the null after the body
+                if (body_len + len + 2 > size) {
+                    size = (body_len + len + 2) * 2;
+                    body = (char *)realloc(body, size);
+                }
+                memcpy(body + body_len, line, len);
+                body_len += len;
+                body[body_len++] = '\n';
+            }
+
+            if (redirection->literal || body_len == 0) {
+                redirection->text = (char *)arena_alloc(line_arena, body_len + 1);
+                if (body_len > 0) {
+                    memcpy(redirection->text, body, body_len);
+                }
+                redirection->text[body_len] = '\0';
+                redirection->text_len = body_len;
+            } else {
+                body[body_len] = '\0';
+                if (expand_here(line_arena, vars, substitute_output, body, body_len,
+                                &redirection->text, &redirection->text_len) != 0) {
+                    free(body);
+                    return -1;
+                }
+            }
+        }
+    }
+    free(body);
+    return 0;
+}
+
+/**
+ * The open_here() function opens an fd that reads the text of a here-document or here-string,
+ * which never touches the disk. Text that fits in a pipe's atomic write goes into a pipe, whose
+ * write end is closed right away, anything longer into a memfd, which is rewound to its start.
+ * The fd is close-on-exec, so only the copy a redirection puts in place is inherited.
+ * @param redirection: the redirection, with its text
+ * @return the fd, -1 if it couldn't be opened, which is printed
+*/
+int open_here(const redirection_t *redirection) {
+    int fds[2];
+
+    if (redirection->text_len <= PIPE_BUF) {
+        if (pipe2(fds, O_CLOEXEC) != 0) {
+            perror("pipe2");
+            return -1;
+        }
+        // the pipe is empty, so a write of up to PIPE_BUF bytes doesn't block or get split
+        if (redirection->text_len > 0 &&
+            write(fds[1], redirection->text, redirection->text_len) < 0) {
+            perror("write");
+            close(fds[0]);
+            fds[0] = -1;
+        }
+        close(fds[1]);
+        return fds[0];
+    }
+
+    int fd = memfd_create("33sh-here", MFD_CLOEXEC);
+    if (fd < 0) {
+        perror("memfd_create");
+        return -1;
+    }
+    for (size_t written = 0; written < redirection->text_len;) {
+        ssize_t n = write(fd, redirection->text + written, redirection->text_len - written);
+        if (n < 0) {
+            perror("write");
+            close(fd);
+            return -1;
+        }
+        written += (size_t)n;
+    }
+    lseek(fd, 0, SEEK_SET);
+    return fd;
+}
+
+/**
+ * The close_heres() function closes the fds open_here() opened for a pipeline, once it is launched,
+ * the commands have their own copies.
+ * @param pipeline: the pipeline
+*/
+void close_heres(pipeline_t *pipeline) {
+    for (int c = 0; c < pipeline->num_commands; c++) {
+        command_t *command = &pipeline->commands[c];
+        for (int r = 0; r < command->num_redirections; r++) {
+            if (command->redirections[r].open_fd >= 0) {
+                close(command->redirections[r].open_fd);
+                command->redirections[r].open_fd = -1;
+            }
+        }
+    }
+}
+
+/**
+ * The open_heres() function opens an fd for every here-document and here-string of a pipeline,
+ * which its redirection installs instead of opening a file.
+ * @param pipeline: the pipeline, with the bodies of its here-documents read
+ * @return 0 on success, -1 if one couldn't be opened, then none are left open
+*/
+int open_heres(pipeline_t *pipeline) {
+    for (int c = 0; c < pipeline->num_commands; c++) {
+        command_t *command = &pipeline->commands[c];
+        for (int r = 0; r < command->num_redirections; r++) {
+            redirection_t *redirection = &command->redirections[r];
+            if (redirection->here == HERE_NONE) {
+                continue;
+            }
+            if ((redirection->open_fd = open_here(redirection)) < 0) {
+                close_heres(pipeline);
+                return -1;
+            }
+        }
     }
-    cleanup_job_list(job_list);
     return 0;
 }
+
+/**
+ * The reserve_capture() function makes room for n more bytes in the capture buffer, doubling it
+ * until they fit, so output of any length costs a few copies instead of one per write.
+ * @param n: the number of bytes
+*/
+void reserve_capture(size_t n) {
+    if (capture_len + n <= capture_size) {
+        return;
+    }
+    size_t size = capture_size == 0 ? CAPTURE_READ : capture_size;
+    while (capture_len + n > size) {
+        size *= 2;
+    }
+    capture = (char *)realloc(capture, size);
+    capture_size = size;
+}
+
+/**
+ * The capture_write() function appends what a built-in writes to stdout to the capture buffer, it
+ * is the write function of the stream capture_builtin() puts in place of stdout.
+ * @param cookie: unused
+ * @param data: the bytes stdio flushes
+ * @param len: how many
+ * @return len, all of it is always taken
+*/
+ssize_t capture_write(void *cookie, const char *data, size_t len) {
+    (void)cookie;
+    reserve_capture(len);
+    memcpy(capture + capture_len, data, len);
+    capture_len += len;
+    return (ssize_t)len;
+}
+
+/**
+ * The capture_builtin() function runs a utility built-in in the shell itself, with stdout replaced
+ * by a stream that writes into the capture buffer, so a $(...) of a utility costs no fork, pipe or
+ * exec. Its redirections are applied like run_builtin() does.
+ * @param builtin: the built-in, which only writes through stdio
+ * @param command: the command, whose stdout isn't redirected
+ * @return the exit status of the built-in
+*/
+int capture_builtin(const builtin_t *builtin, command_t *command) {
+    cookie_io_functions_t functions = {NULL, capture_write, NULL, NULL};
+    FILE *stream = fopencookie(NULL, "w", functions);
+    if (stream == NULL) {
+        perror("fopencookie");
+        return 1;
+    }
+
+    fflush(stdout);
+    FILE *saved = stdout;
+    stdout = stream;
+    int status = run_builtin(builtin, command);
+    // closing the stream flushes the rest of the output into the buffer
+    fclose(stream);
+    stdout = saved;
+    return status;
+}
+
+/**
+ * The stop_capture() function is called when SIGCHLD comes in while the output of a $(...) is
+ * being read. It records what changed in the job's processes like wait_foreground() does, and
+ * kills the job once any of them is stopped, since a stopped process that still holds the pipe
+ * would keep the shell reading it forever. wait_foreground() then reports it as terminated by
+ * SIGKILL.
+ * @param jid: jid of the job of the $(...)
+*/
+void stop_capture(int jid) {
+    struct signalfd_siginfo info;
+    pid_t job_pid = get_job_pid(job_list, jid);
+    int stopped = FALSE;
+    int wret;
+    int wstatus;
+    struct rusage usage;
+
+    // one SIGCHLD can stand for several children, background ones are reaped after the command
+    while (read(signal_fd, &info, sizeof(info)) == sizeof(info)) {
+    }
+    while ((wret = wait4(-job_pid, &wstatus, WNOHANG | WUNTRACED, &usage)) > 0) {
+        update_job_status(job_list, wret, wstatus, &usage);
+        stopped |= WIFSTOPPED(wstatus);
+    }
+    if (stopped) {
+        kill(-job_pid, SIGKILL);
+        kill(-job_pid, SIGCONT);
+        // so that wait_foreground() waits for every process to be killed
+        update_job_jid(job_list, jid, RUNNING);
+    }
+}
+
+/**
+ * The capture_job() function runs a pipeline in a $(...) as a foreground job, with its last
+ * command's stdout going into a pipe, unless it is redirected. The pipe is read into the capture
+ * buffer, which always has CAPTURE_READ bytes of room for the next read, until every process has
+ * closed it, and then the job is waited on. While it is read, signal_fd is watched too, so that a
+ * job stopped by control-Z is killed with stop_capture() instead of hanging the shell. Every
+ * built-in runs in a child, so one like cd or exit doesn't change the shell.
+ * @param pipeline: the pipeline
+ * @return the exit status of the job, 127 if a command wasn't found, 1 if it couldn't be launched
+*/
+int capture_job(pipeline_t *pipeline) {
+    command_t *last = &pipeline->commands[pipeline->num_commands - 1];
+    redirection_t *output = NULL;
+    int fds[2];
+
+    int status = resolve_commands(pipeline, TRUE);
+    if (status != 0) {
+        return status;
+    }
+    if (pipe2(fds, O_CLOEXEC) != 0) {
+        perror("pipe2");
+        return 1;
+    }
+    // a command has at most one output redirection, so there is room for it
+    for (int i = 0; i < last->num_redirections; i++) {
+        if (last->redirections[i].fd == STDOUT_FILENO) {
+            output = &last->redirections[i];
+        }
+    }
+    if (output == NULL) {
+        output = &last->redirections[last->num_redirections++];
+        memset(output, 0, sizeof(redirection_t));
+        output->fd = STDOUT_FILENO;
+        output->here = HERE_NONE;
+        output->open_fd = fds[1];
+    }
+
+    int jid = start_job(pipeline);
+    if (output->open_fd == fds[1]) {
+        output->open_fd = -1;
+    }
+    // only the job has the write end now, so the read ends once it is done
+    close(fds[1]);
+    struct pollfd watch[2] = {{fds[0], POLLIN, 0}, {signal_fd, POLLIN, 0}};
+    nfds_t num_watched = jid > 0 && signal_fd >= 0 ? 2 : 1;
+    while (TRUE) {
+        if (poll(watch, num_watched, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (num_watched == 2 && (watch[1].revents & POLLIN)) {
+            stop_capture(jid);
+        }
+        if (watch[0].revents == 0) {
+            continue;
+        }
+        reserve_capture(CAPTURE_READ);
+        ssize_t n = read(fds[0], capture + capture_len, capture_size - capture_len);
+        if (n > 0) {
+            capture_len += (size_t)n;
+        } else if (n == 0 || errno != EINTR) {
+            break;
+        }
+    }
+    close(fds[0]);
+
+    status = jid > 0 ? wait_foreground(jid, NULL) : 1;
+    tcsetpgrp(0, getpgrp());
+    return status;
+}
+
+/**
+ * The substitute_output() function runs the command of a $(...) for parse(), and gets what it
+ * wrote to stdout. The command is parsed like a line, in line_arena, and may have $(...) of its
+ * own. A single utility built-in runs in the shell with capture_builtin(), anything else is
+ * launched with capture_job(). A line of only assignments sets nothing, as it would in a subshell,
+ * and neither & nor time apply. Its exit status goes in $?.
+ * @param command: the command, null terminated
+ * @param output: set to its output, which stays valid until the next $(...)
+ * @param len: set to the length of the output
+ * @return 0 on success, -1 if the command had a syntax error
+*/
+int substitute_output(char *command, char **output, size_t *len) {
+    pipeline_t pipeline;
+    int status = 0;
+
+    int parsed = parse(command, line_arena, vars, pathexp, substitute_output, &pipeline);
+    if (parsed == 2) {
+        return -1;
+    }
+    // after parsing, since the command's own $(...) use the buffer too
+    capture_len = 0;
+    if (parsed == 0 && (read_here_docs(&pipeline, NULL, NULL) != 0 ||
+                        open_heres(&pipeline) != 0)) {
+        return -1;
+    }
+
+    if (parsed == 0 && pipeline.commands[0].counter > 0) {
+        command_t *first = &pipeline.commands[0];
+        const builtin_t *builtin = find_builtin(first->tokens[0]);
+        int redirected = FALSE;
+        for (int i = 0; i < first->num_redirections; i++) {
+            redirected |= first->redirections[i].fd == STDOUT_FILENO;
+        }
+        pipeline.is_bg = FALSE;
+        pipeline.timed = FALSE;
+        if (pipeline.num_commands == 1 && builtin != NULL && builtin->utility && !redirected) {
+            status = capture_builtin(builtin, first);
+        } else {
+            status = capture_job(&pipeline);
+        }
+    }
+    if (parsed == 0) {
+        close_heres(&pipeline);
+    }
+
+    substitution_status = status;
+    set_number_var("?", status);
+    *output = capture;
+    *len = capture_len;
+    return 0;
+}
+
+/**
+ * The run_line() function runs one line of input: parse() builds its pipeline in line_arena,
+ * expanding variables as it goes, and only if parsing is correct and inputs are valid is the
+ * pipeline run, with time_pipeline() if it started with time. The bodies of its here-documents
+ * are read first, and every here-document and here-string gets an fd that is installed as stdin.
+ * Its exit status is kept for $?, 2 if it had a syntax error. The arena is reset afterwards, so
+ * every line reuses the same memory.
+ * @param line: the line, null terminated and without its newline
+ * @param more: gets the lines after it, for the bodies of here-documents
+ * @param data: passed to more
+*/
+void run_line(char *line, line_source_t more, void *data){
+    pipeline_t pipeline;
+
+    // getting more lines may move the buffer the line is in, and the words
+    // parse() finds point into it
+    if (strstr(line, "<<") != NULL) {
+        size_t len = strlen(line);
+        char *copy = (char *)arena_alloc(line_arena, len + 1);
+        line = memcpy(copy, line, len + 1);
+    }
+    substitution_status = 0;
+    uint64_t start = stats_now(stats);
+    int parsed = parse(line, line_arena, vars, pathexp, substitute_output, &pipeline);
+    record_stat(stats, STAT_PARSE, start);
+
+    if (parsed == 0 && read_here_docs(&pipeline, more, data) != 0) {
+        parsed = 2;
+    }
+    if (parsed == 0 && open_heres(&pipeline) != 0) {
+        set_number_var("?", 1);
+        parsed = 1;
+    }
+    if (parsed == 0) {
+        if (pipeline.timed && !pipeline.is_bg) {
+            set_number_var("?", time_pipeline(&pipeline));
+        } else {
+            set_number_var("?", handle_commands(&pipeline, NULL));
+        }
+        close_heres(&pipeline);
+    } else if (parsed == 2) {
+        set_number_var("?", 2);
+    }
+    reset_arena(line_arena);
+}
@@ -0,0 +1,106 @@
+#ifndef SH_H_
+#define SH_H_
+
+#include "./arena.h"
+#include "./cmdhash.h"
+#include "./complete.h"
+#include "./editor.h"
+#include "./histsearch.h"
+#include "./history.h"
+#include "./jobs.h"
+#include "./pathexp.h"
+#include "./stats.h"
+#include "./vars.h"
+
+/*
+ * the shell itself, everything but main(), which is in main.c, so the shell
+ * can also be linked into the benchmarks
+ */
+
+#define LAUNCH_ENV "SH33_LAUNCH"
+#define HASH_FDS_ENV "SH33_HASH_FDS"
+#define NOTIFY_ENV "SH33_NOTIFY"
+#define STATS_ENV "SH33_STATS"
+#define HISTORY_ENV "SH33_HISTFILE"
+#define HISTORY_FILE ".33sh_history"  // in HOME, unless SH33_HISTFILE says where
+#define ARENA_SIZE 4096
+#define PROMPT_TEXT "33sh> "
+#define HERE_PROMPT "> "  // before every line of a here-document typed in the editor
+
+extern job_list_t *job_list;
+extern cmd_hash_t *cmd_hash;  // commands already looked up in PATH
+extern int use_spawn;   // non-zero if commands are launched with posix_spawn()
+extern int notify_now;  // non-zero if job changes are printed as they happen
+extern arena_t *line_arena;  // what parse() builds for a line
+extern stats_t *stats;  // latency of every phase, NULL unless SH33_STATS is set
+extern char *notifications;  // job changes that haven't been printed yet
+extern char *capture;        // what the command of a $(...) wrote
+extern vars_t *vars;  // shell variables, and the special parameters ?, $ and !
+extern history_t *history;  // lines run so far, NULL if history isn't kept
+extern history_search_t *history_search;  // index of history, NULL without it
+extern editor_t *editor;  // line editor of an interactive shell, or NULL
+extern completion_t *completion;  // what tab completes to, NULL without editor
+extern pathexp_t *pathexp;  // expands *, ? and [...] with cached listings
+
+/* makes the shell ignore SIGINT, SIGTSTP and SIGTTOU */
+void init_ignoring_signal();
+
+/* builds the perfect hash of the built-in table */
+void init_builtins();
+
+/* sets up the event loop that waits on stdin and SIGCHLD */
+void init_events();
+
+/* waits until stdin has input, reaping children meanwhile, returns 0 on success */
+int wait_for_input();
+
+/* reaps every child that changed state */
+void reap_children();
+
+/* prints the job changes noticed since the last prompt, returns non-zero if there were any */
+int flush_notifications();
+
+/* prints the prompt, if the shell was built with PROMPT */
+void print_prompt();
+
+/* sets a variable to a number, like $?, $$ and $! are kept */
+void set_number_var(const char *name, long value);
+
+/*
+ * opens the history file, for a shell on a terminal that was built with PROMPT
+ * or whenever SH33_HISTFILE is set, returns the history, NULL if it isn't kept
+ */
+history_t *open_history();
+
+/*
+ * sets up the line editor, for a shell built with PROMPT whose stdin and stdout
+ * are a terminal that isn't dumb, returns the editor, NULL if it isn't used
+ */
+editor_t *open_editor();
+
+/*
+ * finds what the word at the end of line, len bytes long, can be completed to,
+ * adds the words to matches, returns where the word starts in line
+ */
+size_t complete_line(const char *line, size_t len, matches_t *matches);
+
+/* adds a line to the history, if it is kept and the line isn't blank */
+void remember_line(const char *line, size_t len);
+
+/*
+ * gets the next line of input, for the body of a here-document, without its
+ * newline and null terminated, sets *len to its length, returns NULL at the
+ * end of input
+ */
+typedef char *(*line_source_t)(void *data, size_t *len);
+
+/*
+ * parses and runs one line of input, null terminated and without its newline,
+ * the bodies of its here-documents are the lines more gets after it
+ */
+void run_line(char *line, line_source_t more, void *data);
+
+/* writes the stats to where SH33_STATS says and cleans them up */
+void write_stats();
+
+#endif  // SH_H_
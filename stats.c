@@ -0,0 +1,196 @@
+#include "./stats.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// log-linear buckets, like an HDR histogram: values below SUB_BUCKETS get a
+// bucket each, every power of two above is split into SUB_BUCKETS buckets, so
+// a value is off by at most 1/SUB_BUCKETS of itself
+#define SUB_BITS 4
+#define SUB_BUCKETS (1 << SUB_BITS)
+#define NUM_BUCKETS ((64 - SUB_BITS + 1) * SUB_BUCKETS)
+
+// the percentiles in the dump, in thousandths
+static const int percentiles[] = {500, 900, 990, 999};
+
+struct histogram {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint64_t buckets[NUM_BUCKETS];
+};
+typedef struct histogram histogram_t;
+
+struct stats {
+    histogram_t phases[NUM_STAT_PHASES];
+};
+
+#define STATS_NAME(phase, name) name,
+static const char *const phase_names[] = {STATS_PHASES(STATS_NAME)};
+#undef STATS_NAME
+
+/* gets the bucket a value goes in */
+static size_t bucket_index(uint64_t value) {
+    if (value < SUB_BUCKETS) {
+        return (size_t)value;
+    }
+    int exponent = 63 - __builtin_clzll(value);
+    size_t sub = (size_t)(value >> (exponent - SUB_BITS)) & (SUB_BUCKETS - 1);
+    return (size_t)(exponent - SUB_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+/* gets the smallest value that goes in a bucket */
+static uint64_t bucket_lowest(size_t index) {
+    if (index < SUB_BUCKETS) {
+        return index;
+    }
+    int exponent = (int)(index / SUB_BUCKETS) + SUB_BITS - 1;
+    uint64_t sub = index % SUB_BUCKETS;
+    return (SUB_BUCKETS + sub) << (exponent - SUB_BITS);
+}
+
+/* gets the largest value that goes in a bucket */
+static uint64_t bucket_highest(size_t index) {
+    return index + 1 == NUM_BUCKETS ? UINT64_MAX : bucket_lowest(index + 1) - 1;
+}
+
+/*
+ * gets the value below which the given thousandths of the values fall, the
+ * highest value of its bucket but never more than the largest value recorded
+ */
+static uint64_t percentile(histogram_t *histogram, int thousandths) {
+    uint64_t rank =
+        (histogram->count * (uint64_t)thousandths + 999) / 1000;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < NUM_BUCKETS; i++) {
+        seen += histogram->buckets[i];
+        if (seen >= rank && seen > 0) {
+            uint64_t value = bucket_highest(i);
+            return value < histogram->max ? value : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+/* initializes the latency histograms of every phase, returns pointer */
+stats_t *init_stats() {
+    stats_t *stats = (stats_t *)malloc(sizeof(stats_t));
+    reset_stats(stats);
+    return stats;
+}
+
+/*
+ * cleans up the histograms
+ * Note: this function will free the stats pointer
+ * DO NOT use the pointer after this function is called
+ */
+void cleanup_stats(stats_t *stats) { free(stats); }
+
+/*
+ * gets the current CLOCK_MONOTONIC time in nanoseconds, 0 if stats is NULL,
+ * so timing costs nothing when instrumentation is off
+ */
+uint64_t stats_now(stats_t *stats) {
+    struct timespec now;
+    if (stats == NULL || clock_gettime(CLOCK_MONOTONIC, &now) != 0) {
+        return 0;
+    }
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+/*
+ * records that a phase took from start to now, start is from stats_now(),
+ * does nothing if stats is NULL
+ */
+void record_stat(stats_t *stats, stat_phase_t phase, uint64_t start) {
+    uint64_t now = stats_now(stats);
+    if (stats != NULL && now >= start) {
+        record_stat_ns(stats, phase, now - start);
+    }
+}
+
+/* records that a phase took ns nanoseconds, does nothing if stats is NULL */
+void record_stat_ns(stats_t *stats, stat_phase_t phase, uint64_t ns) {
+    if (stats == NULL) {
+        return;
+    }
+    histogram_t *histogram = &stats->phases[phase];
+    if (histogram->count == 0 || ns < histogram->min) {
+        histogram->min = ns;
+    }
+    if (ns > histogram->max) {
+        histogram->max = ns;
+    }
+    histogram->count++;
+    histogram->sum += ns;
+    histogram->buckets[bucket_index(ns)]++;
+}
+
+/* forgets every recorded time */
+void reset_stats(stats_t *stats) {
+    if (stats != NULL) {
+        memset(stats, 0, sizeof(stats_t));
+    }
+}
+
+/* writes one phase as a JSON object */
+static int dump_histogram(histogram_t *histogram, FILE *out) {
+    uint64_t mean = histogram->count == 0 ? 0 : histogram->sum / histogram->count;
+    if (fprintf(out,
+                "{\"count\": %llu, \"min_ns\": %llu, \"max_ns\": %llu, "
+                "\"mean_ns\": %llu",
+                (unsigned long long)histogram->count,
+                (unsigned long long)histogram->min,
+                (unsigned long long)histogram->max,
+                (unsigned long long)mean) < 0) {
+        return -1;
+    }
+    for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++) {
+        // p50, p90 and p99 are in percent, p999 is the 99.9th in thousandths
+        int name = percentiles[i] % 10 == 0 ? percentiles[i] / 10 : percentiles[i];
+        if (fprintf(out, ", \"p%d_ns\": %llu", name,
+                    (unsigned long long)percentile(histogram, percentiles[i])) < 0) {
+            return -1;
+        }
+    }
+
+    // only the buckets that have anything, as [lowest value, count]
+    const char *separator = "";
+    if (fprintf(out, ", \"buckets\": [") < 0) {
+        return -1;
+    }
+    for (size_t i = 0; i < NUM_BUCKETS; i++) {
+        if (histogram->buckets[i] == 0) {
+            continue;
+        }
+        if (fprintf(out, "%s[%llu, %llu]", separator,
+                    (unsigned long long)bucket_lowest(i),
+                    (unsigned long long)histogram->buckets[i]) < 0) {
+            return -1;
+        }
+        separator = ", ";
+    }
+    return fprintf(out, "]}") < 0 ? -1 : 0;
+}
+
+/*
+ * writes every phase's count, min, max, mean, percentiles and non-empty
+ * histogram buckets as JSON, returns 0 on success, -1 on failure
+ */
+int dump_stats(stats_t *stats, FILE *out) {
+    if (stats == NULL || fprintf(out, "{\n") < 0) {
+        return -1;
+    }
+    for (int i = 0; i < NUM_STAT_PHASES; i++) {
+        if (fprintf(out, "  \"%s\": ", phase_names[i]) < 0 ||
+            dump_histogram(&stats->phases[i], out) != 0 ||
+            fprintf(out, i + 1 < NUM_STAT_PHASES ? ",\n" : "\n") < 0) {
+            return -1;
+        }
+    }
+    if (fprintf(out, "}\n") < 0) {
+        return -1;
+    }
+    return fflush(out) == 0 ? 0 : -1;
+}
@@ -0,0 +1,58 @@
+#ifndef STATS_H_
+#define STATS_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+// the phases of running a command that are timed, with their names in the
+// JSON dump
+#define STATS_PHASES(X)                 \
+    X(STAT_READ, "read")                \
+    X(STAT_PARSE, "parse")              \
+    X(STAT_LOOKUP, "lookup")            \
+    X(STAT_BUILTIN, "builtin")          \
+    X(STAT_LAUNCH, "launch")            \
+    X(STAT_CHILD_SETUP, "child_setup")  \
+    X(STAT_EXEC, "exec")                \
+    X(STAT_WAIT, "wait")                \
+    X(STAT_REAP, "reap")
+
+#define STATS_ENUM(phase, name) phase,
+typedef enum { STATS_PHASES(STATS_ENUM) NUM_STAT_PHASES } stat_phase_t;
+#undef STATS_ENUM
+
+typedef struct stats stats_t;
+
+/* initializes the latency histograms of every phase, returns pointer */
+stats_t *init_stats();
+/*
+ * cleans up the histograms
+ * Note: this function will free the stats pointer
+ * DO NOT use the pointer after this function is called
+ */
+void cleanup_stats(stats_t *stats);
+
+/*
+ * gets the current CLOCK_MONOTONIC time in nanoseconds, 0 if stats is NULL,
+ * so timing costs nothing when instrumentation is off
+ */
+uint64_t stats_now(stats_t *stats);
+
+/*
+ * records that a phase took from start to now, start is from stats_now(),
+ * does nothing if stats is NULL
+ */
+void record_stat(stats_t *stats, stat_phase_t phase, uint64_t start);
+/* records that a phase took ns nanoseconds, does nothing if stats is NULL */
+void record_stat_ns(stats_t *stats, stat_phase_t phase, uint64_t ns);
+
+/* forgets every recorded time */
+void reset_stats(stats_t *stats);
+
+/*
+ * writes every phase's count, min, max, mean, percentiles and non-empty
+ * histogram buckets as JSON, returns 0 on success, -1 on failure
+ */
+int dump_stats(stats_t *stats, FILE *out);
+
+#endif  // STATS_H_
@@ -0,0 +1,698 @@
+#include "./utilities.h"
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "./arena.h"
+#include "./pathexp.h"
+#include "./walk.h"
+
+#define MAX_SPEC 64  // longest conversion printf() passes on to the C library
+#define FIND_PATTERNS_SIZE 1024  // first block of the arena of find's patterns
+
+/*
+ * prints the escape sequence after a backslash, as echo -e and printf do,
+ * returns the number of characters after the backslash that it used, -1 for
+ * \c, which ends the output
+ */
+static int print_escape(const char *s) {
+    const char *digits = s;
+    int value = 0;
+    int used = 0;
+
+    switch (*s) {
+        case 'a': putchar('\a'); return 1;
+        case 'b': putchar('\b'); return 1;
+        case 'f': putchar('\f'); return 1;
+        case 'n': putchar('\n'); return 1;
+        case 'r': putchar('\r'); return 1;
+        case 't': putchar('\t'); return 1;
+        case 'v': putchar('\v'); return 1;
+        case '\\': putchar('\\'); return 1;
+        case 'c': return -1;
+        case 'x':
+            // \xHH, one or two hex digits
+            for (used = 1; used < 3; used++) {
+                char c = s[used];
+                int digit = c >= '0' && c <= '9'   ? c - '0'
+                            : c >= 'a' && c <= 'f' ? c - 'a' + 10
+                            : c >= 'A' && c <= 'F' ? c - 'A' + 10
+                                                   : -1;
+                if (digit < 0) {
+                    break;
+                }
+                value = value * 16 + digit;
+            }
+            if (used == 1) {
+                putchar('\\');
+                return 0;
+            }
+            putchar(value);
+            return used;
+        default:
+            break;
+    }
+
+    // \NNN and \0NNN, up to three octal digits after the optional 0
+    if (*digits == '0') {
+        digits++;
+        used++;
+    }
+    for (int i = 0; i < 3 && digits[i] >= '0' && digits[i] <= '7'; i++) {
+        value = value * 8 + digits[i] - '0';
+        used++;
+    }
+    if (used == 0) {
+        // not an escape, the backslash is printed as it is
+        putchar('\\');
+        return 0;
+    }
+    putchar(value & 0xff);
+    return used;
+}
+
+/* prints a string, interpreting escapes, returns -1 if it hit \c, else 0 */
+static int print_escaped(const char *s) {
+    while (*s) {
+        if (*s != '\\') {
+            putchar(*s++);
+            continue;
+        }
+        int used = print_escape(s + 1);
+        if (used < 0) {
+            return -1;
+        }
+        s += used + 1;
+    }
+    return 0;
+}
+
+/* echo [-neE] [string ...], prints its arguments separated by spaces */
+int builtin_echo(int argc, char *argv[]) {
+    int newline = 1;
+    int escapes = 0;
+    int i = 1;
+
+    // like coreutils, an argument is only options if every letter is one
+    for (; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; i++) {
+        if (strspn(argv[i] + 1, "neE") != strlen(argv[i] + 1)) {
+            break;
+        }
+        for (const char *c = argv[i] + 1; *c; c++) {
+            if (*c == 'n') {
+                newline = 0;
+            } else {
+                escapes = *c == 'e';
+            }
+        }
+    }
+
+    for (int first = i; i < argc; i++) {
+        if (i > first) {
+            putchar(' ');
+        }
+        if (!escapes) {
+            fputs(argv[i], stdout);
+        } else if (print_escaped(argv[i]) < 0) {
+            return 0;
+        }
+    }
+    if (newline) {
+        putchar('\n');
+    }
+    return 0;
+}
+
+/*
+ * converts a printf argument to a number, a leading quote gives the value of
+ * the character after it, sets *status to 1 if it isn't a number
+ */
+static intmax_t printf_number(const char *arg, int *status) {
+    if (arg == NULL) {
+        return 0;
+    }
+    if (arg[0] == '\'' || arg[0] == '"') {
+        return (unsigned char)arg[1];
+    }
+
+    char *end;
+    errno = 0;
+    intmax_t value = strtoimax(arg, &end, 0);
+    if (end == arg || *end != '\0' || errno != 0) {
+        fprintf(stderr, "printf: %s: invalid number\n", arg);
+        *status = 1;
+    }
+    return value;
+}
+
+/*
+ * prints the format once, taking the arguments its conversions need from args
+ * returns the number of arguments it took, -1 if the output has to end, for
+ * \c or an invalid conversion
+ */
+static int printf_once(const char *format, char *args[], int num_args,
+                       int *status) {
+    int used = 0;
+    const char *f = format;
+
+    while (*f) {
+        if (*f == '\\') {
+            int escape = print_escape(f + 1);
+            if (escape < 0) {
+                return -1;
+            }
+            f += escape + 1;
+            continue;
+        }
+        if (*f != '%') {
+            putchar(*f++);
+            continue;
+        }
+        if (f[1] == '%') {
+            putchar('%');
+            f += 2;
+            continue;
+        }
+
+        // copy the flags, width and precision, with room for the length
+        // modifier and the conversion
+        const char *start = f++;
+        f += strspn(f, "-+ #0");
+        f += strspn(f, "0123456789");
+        if (*f == '.') {
+            f++;
+            f += strspn(f, "0123456789");
+        }
+        size_t len = (size_t)(f - start);
+        char conversion = *f;
+        if (conversion == '\0' || len + 3 > MAX_SPEC) {
+            fprintf(stderr, "printf: %s: invalid conversion\n", start);
+            *status = 1;
+            return -1;
+        }
+        f++;
+
+        char spec[MAX_SPEC];
+        memcpy(spec, start, len);
+        char *arg = used < num_args ? args[used] : NULL;
+        used += used < num_args;
+
+        switch (conversion) {
+            case 's':
+            case 'c':
+                spec[len] = 's';
+                spec[len + 1] = '\0';
+                if (conversion == 'c') {
+                    // only the first character of the argument
+                    char c[2] = {arg == NULL ? '\0' : arg[0], '\0'};
+                    printf(spec, c);
+                } else {
+                    printf(spec, arg == NULL ? "" : arg);
+                }
+                break;
+            case 'b':
+                if (arg != NULL && print_escaped(arg) < 0) {
+                    return -1;
+                }
+                break;
+            case 'd':
+            case 'i':
+                spec[len] = 'j';
+                spec[len + 1] = conversion;
+                spec[len + 2] = '\0';
+                printf(spec, printf_number(arg, status));
+                break;
+            case 'o':
+            case 'u':
+            case 'x':
+            case 'X':
+                spec[len] = 'j';
+                spec[len + 1] = conversion;
+                spec[len + 2] = '\0';
+                printf(spec, (uintmax_t)printf_number(arg, status));
+                break;
+            default:
+                fprintf(stderr, "printf: %%%c: invalid conversion\n",
+                        conversion);
+                *status = 1;
+                return -1;
+        }
+    }
+    return used;
+}
+
+/* printf format [argument ...], prints its arguments as the format says */
+int builtin_printf(int argc, char *argv[]) {
+    char **args = argv + 2;
+    int num_args = argc - 2;
+    int status = 0;
+    int used;
+
+    // the format is used again until every argument has been taken
+    do {
+        used = printf_once(argv[1], args, num_args, &status);
+        if (used > 0) {
+            args += used;
+            num_args -= used;
+        }
+    } while (used > 0 && num_args > 0);
+    return status;
+}
+
+// the expression being evaluated by test, pos is the next argument
+struct test_expr {
+    char **argv;
+    int argc;
+    int pos;
+    int error;
+};
+typedef struct test_expr test_expr_t;
+
+static int test_or(test_expr_t *t);
+
+/* checks whether the next argument is the given word */
+static int test_peek(test_expr_t *t, const char *word) {
+    return t->pos < t->argc && !strcmp(t->argv[t->pos], word);
+}
+
+/* converts an argument of a numeric comparison, setting error if it isn't */
+static long long test_number(test_expr_t *t, const char *arg) {
+    char *end;
+    errno = 0;
+    long long value = strtoll(arg, &end, 10);
+    if (end == arg || *end != '\0' || errno != 0) {
+        fprintf(stderr, "test: %s: integer expression expected\n", arg);
+        t->error = 1;
+    }
+    return value;
+}
+
+/* checks for the operators that take one argument */
+static int is_unary(const char *op) {
+    return op[0] == '-' && op[1] != '\0' && op[2] == '\0' &&
+           strchr("bcdefghknprsStuwxzLOG", op[1]) != NULL;
+}
+
+/* checks for the operators that go between two arguments */
+static int is_binary(const char *op) {
+    static const char *const ops[] = {"=",   "==",  "!=",  "<",   ">",
+                                      "-eq", "-ne", "-lt", "-le", "-gt",
+                                      "-ge", "-nt", "-ot", "-ef", NULL};
+    for (int i = 0; ops[i] != NULL; i++) {
+        if (!strcmp(op, ops[i])) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* evaluates a unary operator on its argument */
+static int test_unary(test_expr_t *t, char op, const char *arg) {
+    struct stat st;
+
+    switch (op) {
+        case 'z': return *arg == '\0';
+        case 'n': return *arg != '\0';
+        case 't': return isatty((int)test_number(t, arg));
+        case 'r': return access(arg, R_OK) == 0;
+        case 'w': return access(arg, W_OK) == 0;
+        case 'x': return access(arg, X_OK) == 0;
+        case 'h':
+        case 'L': return lstat(arg, &st) == 0 && S_ISLNK(st.st_mode);
+        default: break;
+    }
+
+    if (stat(arg, &st) != 0) {
+        return 0;
+    }
+    switch (op) {
+        case 'b': return S_ISBLK(st.st_mode);
+        case 'c': return S_ISCHR(st.st_mode);
+        case 'd': return S_ISDIR(st.st_mode);
+        case 'e': return 1;
+        case 'f': return S_ISREG(st.st_mode);
+        case 'g': return (st.st_mode & S_ISGID) != 0;
+        case 'k': return (st.st_mode & S_ISVTX) != 0;
+        case 'p': return S_ISFIFO(st.st_mode);
+        case 's': return st.st_size > 0;
+        case 'S': return S_ISSOCK(st.st_mode);
+        case 'u': return (st.st_mode & S_ISUID) != 0;
+        case 'O': return st.st_uid == geteuid();
+        case 'G': return st.st_gid == getegid();
+        default: return 0;
+    }
+}
+
+/* compares two modification times, returns <0, 0 or >0 like strcmp() */
+static int compare_mtime(const struct stat *a, const struct stat *b) {
+    if (a->st_mtim.tv_sec != b->st_mtim.tv_sec) {
+        return a->st_mtim.tv_sec < b->st_mtim.tv_sec ? -1 : 1;
+    }
+    if (a->st_mtim.tv_nsec != b->st_mtim.tv_nsec) {
+        return a->st_mtim.tv_nsec < b->st_mtim.tv_nsec ? -1 : 1;
+    }
+    return 0;
+}
+
+/* evaluates a binary operator on its two arguments */
+static int test_binary(test_expr_t *t, const char *left, const char *op,
+                       const char *right) {
+    if (op[0] != '-') {
+        int cmp = strcmp(left, right);
+        switch (op[0]) {
+            case '=': return cmp == 0;
+            case '!': return cmp != 0;
+            case '<': return cmp < 0;
+            default: return cmp > 0;
+        }
+    }
+
+    if (op[1] == 'n' && op[2] == 't') {
+        // a file that doesn't exist is older than one that does
+        struct stat a, b;
+        int has_a = stat(left, &a) == 0, has_b = stat(right, &b) == 0;
+        return has_a && (!has_b || compare_mtime(&a, &b) > 0);
+    }
+    if (op[1] == 'o' && op[2] == 't') {
+        struct stat a, b;
+        int has_a = stat(left, &a) == 0, has_b = stat(right, &b) == 0;
+        return has_b && (!has_a || compare_mtime(&a, &b) < 0);
+    }
+    if (op[1] == 'e' && op[2] == 'f') {
+        struct stat a, b;
+        return stat(left, &a) == 0 && stat(right, &b) == 0 &&
+               a.st_dev == b.st_dev && a.st_ino == b.st_ino;
+    }
+
+    long long l = test_number(t, left);
+    long long r = test_number(t, right);
+    if (!strcmp(op, "-eq")) return l == r;
+    if (!strcmp(op, "-ne")) return l != r;
+    if (!strcmp(op, "-lt")) return l < r;
+    if (!strcmp(op, "-le")) return l <= r;
+    if (!strcmp(op, "-gt")) return l > r;
+    return l >= r;
+}
+
+/*
+ * primary: ( expression ), a binary operator, a unary operator or a string,
+ * in that order, so "-n = -n" compares two strings
+ */
+static int test_primary(test_expr_t *t) {
+    if (t->pos >= t->argc) {
+        t->error = 1;
+        return 0;
+    }
+    char **argv = t->argv + t->pos;
+    int left = t->argc - t->pos;
+
+    if (left >= 3 && is_binary(argv[1])) {
+        t->pos += 3;
+        return test_binary(t, argv[0], argv[1], argv[2]);
+    }
+    if (!strcmp(argv[0], "(") && left >= 2) {
+        t->pos++;
+        int value = test_or(t);
+        if (!test_peek(t, ")")) {
+            t->error = 1;
+        }
+        t->pos++;
+        return value;
+    }
+    if (left >= 2 && is_unary(argv[0])) {
+        t->pos += 2;
+        return test_unary(t, argv[0][1], argv[1]);
+    }
+    // a string on its own is true if it isn't empty
+    t->pos++;
+    return argv[0][0] != '\0';
+}
+
+/* negation: ! expression */
+static int test_not(test_expr_t *t) {
+    if (test_peek(t, "!") && t->pos + 1 < t->argc) {
+        t->pos++;
+        return !test_not(t);
+    }
+    return test_primary(t);
+}
+
+/* conjunction: expression -a expression, binds tighter than -o */
+static int test_and(test_expr_t *t) {
+    int value = test_not(t);
+    while (test_peek(t, "-a")) {
+        t->pos++;
+        int right = test_not(t);
+        value = value && right;
+    }
+    return value;
+}
+
+/* disjunction: expression -o expression */
+static int test_or(test_expr_t *t) {
+    int value = test_and(t);
+    while (test_peek(t, "-o")) {
+        t->pos++;
+        int right = test_and(t);
+        value = value || right;
+    }
+    return value;
+}
+
+/* test expression, returns 0 if the expression is true, 1 if it is false */
+int builtin_test(int argc, char *argv[]) {
+    // no expression at all is false
+    if (argc == 1) {
+        return 1;
+    }
+
+    test_expr_t t = {argv + 1, argc - 1, 0, 0};
+    int value = test_or(&t);
+    if (t.pos != t.argc && !t.error) {
+        fprintf(stderr, "test: %s: unexpected argument\n", t.argv[t.pos]);
+        t.error = 1;
+    }
+    if (t.error) {
+        return 2;
+    }
+    return !value;
+}
+
+/* [ expression ], the same as test but the last argument has to be ] */
+int builtin_bracket(int argc, char *argv[]) {
+    if (strcmp(argv[argc - 1], "]")) {
+        fprintf(stderr, "[: missing ]\n");
+        return 2;
+    }
+    return builtin_test(argc - 1, argv);
+}
+
+/* true, returns 0 */
+int builtin_true(int argc, char *argv[]) {
+    (void)argc;
+    (void)argv;
+    return 0;
+}
+
+/* false, returns 1 */
+int builtin_false(int argc, char *argv[]) {
+    (void)argc;
+    (void)argv;
+    return 1;
+}
+
+/* pwd, prints the working directory */
+int builtin_pwd(int argc, char *argv[]) {
+    (void)argc;
+    (void)argv;
+    char *cwd = getcwd(NULL, 0);
+    if (cwd == NULL) {
+        perror("pwd");
+        return 1;
+    }
+    puts(cwd);
+    free(cwd);
+    return 0;
+}
+
+/* does nothing, it only has to interrupt nanosleep() */
+static void interrupt_sleep(int sig) { (void)sig; }
+
+/*
+ * sleep number[smhd] ..., sleeps for the sum of its arguments, a SIGINT
+ * that would otherwise be ignored ends the sleep early
+ */
+int builtin_sleep(int argc, char *argv[]) {
+    double seconds = 0;
+
+    for (int i = 1; i < argc; i++) {
+        char *end;
+        double value = strtod(argv[i], &end);
+        double unit = *end == 'm' ? 60 : *end == 'h' ? 3600 : *end == 'd' ? 86400 : 1;
+        if (*end != '\0' && strchr("smhd", *end) != NULL) {
+            end++;
+        }
+        if (end == argv[i] || *end != '\0' || !(value >= 0)) {
+            fprintf(stderr, "sleep: invalid time interval '%s'\n", argv[i]);
+            return 1;
+        }
+        seconds += value * unit;
+    }
+    if (seconds > (double)INT_MAX) {
+        seconds = (double)INT_MAX;
+    }
+
+    // in the shell SIGINT is ignored, so catch it for the length of the sleep
+    // instead, a child running sleep keeps the default and just dies
+    struct sigaction old;
+    struct sigaction catch;
+    sigaction(SIGINT, NULL, &old);
+    int caught = old.sa_handler == SIG_IGN;
+    if (caught) {
+        memset(&catch, 0, sizeof(catch));
+        catch.sa_handler = interrupt_sleep;
+        sigemptyset(&catch.sa_mask);
+        sigaction(SIGINT, &catch, NULL);
+    }
+
+    struct timespec left;
+    left.tv_sec = (time_t)seconds;
+    left.tv_nsec = (long)((seconds - (double)left.tv_sec) * 1e9);
+    int status = 0;
+    while (nanosleep(&left, &left) != 0) {
+        if (errno != EINTR) {
+            status = 1;
+            break;
+        }
+        if (caught) {
+            // the status of a command killed by SIGINT
+            status = 128 + SIGINT;
+            break;
+        }
+    }
+
+    if (caught) {
+        sigaction(SIGINT, &old, NULL);
+    }
+    return status;
+}
+
+// the -name patterns of a find, every one of which a name has to match
+typedef struct find {
+    const name_pattern_t **names;
+    size_t num_names;
+} find_t;
+
+/* matches a name against every -name pattern, for walk_tree() */
+static int find_filter(void *data, const char *name, size_t len, int type) {
+    const find_t *find = (const find_t *)data;
+    (void)type;
+    for (size_t i = 0; i < find->num_names; i++) {
+        if (!match_name(find->names[i], name, len)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* reads the number after -mindepth or -maxdepth, returns it, -1 if it isn't one */
+static int find_depth(const char *option, const char *arg) {
+    char *end;
+    long depth = strtol(arg, &end, 10);
+    if (end == arg || *end != '\0' || depth < 0 || depth > INT_MAX) {
+        fprintf(stderr, "find: %s: invalid argument '%s'\n", option, arg);
+        return -1;
+    }
+    return (int)depth;
+}
+
+/*
+ * find [path ...] [-name pattern] [-type f|d|l] [-mindepth n] [-maxdepth n]
+ * [-print], prints the paths under every path, . if there is none, that pass
+ * every test, each directory right before what is in it, in the order of
+ * their names
+ */
+int builtin_find(int argc, char *argv[]) {
+    arena_t *arena = init_arena(FIND_PATTERNS_SIZE);
+    find_t find;
+    walk_t walk;
+    int bad = 0;  // non-zero if the arguments are wrong
+    int status = 0;
+    int i = 1;
+
+    find.names = (const name_pattern_t **)arena_alloc(arena, (size_t)argc * sizeof(void *));
+    find.num_names = 0;
+    memset(&walk, 0, sizeof(walk));
+    walk.filter = find_filter;
+    walk.data = &find;
+    walk.types = WALK_ANY;
+    walk.max_depth = -1;
+    walk.hidden = 1;
+    walk.tree_order = 1;
+
+    int paths = i;
+    while (i < argc && argv[i][0] != '-') {
+        i++;
+    }
+    int num_paths = i - paths;
+
+    for (; i < argc && !bad; i++) {
+        const char *option = argv[i];
+        if (strcmp(option, "-print") == 0) {
+            continue;
+        }
+        if (strcmp(option, "-name") != 0 && strcmp(option, "-type") != 0 &&
+            strcmp(option, "-mindepth") != 0 && strcmp(option, "-maxdepth") != 0) {
+            fprintf(stderr, "find: unknown predicate '%s'\n", option);
+            bad = 1;
+            break;
+        }
+        if (++i == argc) {
+            fprintf(stderr, "find: missing argument to '%s'\n", option);
+            bad = 1;
+            break;
+        }
+        const char *arg = argv[i];
+        if (strcmp(option, "-name") == 0) {
+            find.names[find.num_names++] = compile_name_pattern(arena, arg);
+        } else if (strcmp(option, "-type") == 0) {
+            int type = strcmp(arg, "f") == 0   ? WALK_FILE
+                       : strcmp(arg, "d") == 0 ? WALK_DIR
+                       : strcmp(arg, "l") == 0 ? WALK_LINK
+                                               : 0;
+            if (type == 0) {
+                fprintf(stderr, "find: -type: unknown type '%s'\n", arg);
+                bad = 1;
+            }
+            // every -type has to hold
+            walk.types &= type;
+        } else if (strcmp(option, "-mindepth") == 0) {
+            bad = (walk.min_depth = find_depth(option, arg)) < 0;
+        } else {
+            bad = (walk.max_depth = find_depth(option, arg)) < 0;
+        }
+    }
+
+    for (int p = 0; p < (num_paths == 0 ? 1 : num_paths) && !bad; p++) {
+        const char *root = num_paths == 0 ? "." : argv[paths + p];
+        char **found;
+        ssize_t num = walk_tree(root, &walk, &found);
+        if (num < 0) {
+            fprintf(stderr, "find: '%s': %s\n", root, strerror(errno));
+            status = 1;
+            continue;
+        }
+        for (ssize_t f = 0; f < num; f++) {
+            puts(found[f]);
+        }
+        free(found);
+    }
+    cleanup_arena(arena);
+    return bad || status;
+}
@@ -0,0 +1,45 @@
+#ifndef UTILITIES_H_
+#define UTILITIES_H_
+
+/*
+ * built-in versions of common utilities, so running them doesn't cost a fork
+ * every one takes argc and argv like main(), writes to stdout through stdio
+ * and returns its exit status
+ */
+
+/* echo [-neE] [string ...], prints its arguments separated by spaces */
+int builtin_echo(int argc, char *argv[]);
+
+/* printf format [argument ...], prints its arguments as the format says */
+int builtin_printf(int argc, char *argv[]);
+
+/* test expression, returns 0 if the expression is true, 1 if it is false */
+int builtin_test(int argc, char *argv[]);
+
+/* [ expression ], the same as test but the last argument has to be ] */
+int builtin_bracket(int argc, char *argv[]);
+
+/* true, returns 0 */
+int builtin_true(int argc, char *argv[]);
+
+/* false, returns 1 */
+int builtin_false(int argc, char *argv[]);
+
+/* pwd, prints the working directory */
+int builtin_pwd(int argc, char *argv[]);
+
+/*
+ * sleep number[smhd] ..., sleeps for the sum of its arguments, a SIGINT
+ * that would otherwise be ignored ends the sleep early
+ */
+int builtin_sleep(int argc, char *argv[]);
+
+/*
+ * find [path ...] [-name pattern] [-type f|d|l] [-mindepth n] [-maxdepth n]
+ * [-print], prints the paths under every path, . if there is none, that pass
+ * every test, each directory right before what is in it, in the order of
+ * their names
+ */
+int builtin_find(int argc, char *argv[]);
+
+#endif  // UTILITIES_H_
@@ -0,0 +1,370 @@
+#include "./vars.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "./arena.h"
+
+#define INITIAL_SLOTS 64  // a power of two
+#define NAMES_SIZE 1024   // first block of the names arena
+#define INLINE_SIZE 24    // values shorter than this are kept in the slot
+#define INITIAL_ENVP 64
+
+// a variable, its value is in the slot itself while it is short, so setting
+// and expanding short values never allocates
+struct var {
+    const char *name;  // interned in the names arena, NULL if the slot is empty
+    size_t name_len;
+    size_t hash;
+    int set;          // non-zero if it has a value, unset keeps the slot
+    int exported;     // non-zero if commands get it in their environment
+    char *env;        // NAME=value in envp, NULL if it isn't in the environment
+    size_t env_index; // where env is in envp
+    size_t len;       // length of the value
+    size_t capacity;  // size of value.heap, 0 while the value is inline
+    union {
+        char small[INLINE_SIZE];
+        char *heap;
+    } value;
+};
+typedef struct var var_t;
+
+// slots is an open addressing table, a variable's slot is kept for good once
+// its name has been interned, so there are no tombstones
+// envp is the environment of commands, kept up to date one variable at a time
+// as exported variables change, so it never has to be built for a launch
+struct vars {
+    var_t *slots;
+    size_t num_slots;
+    size_t num_vars;
+    arena_t *names;  // every name is stored once and lives as long as the table
+    char **envp;     // null terminated
+    const char **env_names;  // the name of the variable of every envp entry
+    size_t envp_len;
+    size_t envp_size;
+};
+
+/* FNV-1a hash of a variable name */
+static size_t hash_name(const char *name, size_t len) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)name[i];
+        hash *= 1099511628211ULL;
+    }
+    return (size_t)hash;
+}
+
+/* gets the value of a variable, wherever it is kept */
+static char *value_of(var_t *var) {
+    return var->capacity == 0 ? var->value.small : var->value.heap;
+}
+
+/*
+ * finds the slot of a name, returns pointer, which is the empty slot the name
+ * would go in if it isn't in the table
+ */
+static var_t *find_slot(vars_t *vars, const char *name, size_t len,
+                        size_t hash) {
+    size_t mask = vars->num_slots - 1;
+    size_t slot = hash & mask;
+    while (vars->slots[slot].name != NULL) {
+        var_t *var = &vars->slots[slot];
+        if (var->hash == hash && var->name_len == len &&
+            !memcmp(var->name, name, len)) {
+            return var;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return &vars->slots[slot];
+}
+
+/* doubles the table, moving every variable to its new slot */
+static void grow(vars_t *vars) {
+    var_t *old = vars->slots;
+    size_t old_slots = vars->num_slots;
+
+    vars->num_slots *= 2;
+    vars->slots = (var_t *)calloc(vars->num_slots, sizeof(var_t));
+    for (size_t i = 0; i < old_slots; i++) {
+        if (old[i].name != NULL) {
+            *find_slot(vars, old[i].name, old[i].name_len, old[i].hash) = old[i];
+        }
+    }
+    free(old);
+}
+
+/*
+ * finds a variable, creating an unset one if the name isn't in the table yet,
+ * returns pointer, which is only valid until the next variable is created
+ */
+static var_t *intern_var(vars_t *vars, const char *name, size_t name_len) {
+    size_t hash = hash_name(name, name_len);
+    var_t *var = find_slot(vars, name, name_len, hash);
+    if (var->name != NULL) {
+        return var;
+    }
+
+    // keep the table at most half full, so probes stay short
+    if ((vars->num_vars + 1) * 2 > vars->num_slots) {
+        grow(vars);
+        var = find_slot(vars, name, name_len, hash);
+    }
+    char *interned = (char *)arena_alloc(vars->names, name_len + 1);
+    memcpy(interned, name, name_len);
+    interned[name_len] = '\0';
+    memset(var, 0, sizeof(var_t));
+    var->name = interned;
+    var->name_len = name_len;
+    var->hash = hash;
+    vars->num_vars++;
+    return var;
+}
+
+/* takes a variable out of envp, moving the last entry into its place */
+static void remove_env(vars_t *vars, var_t *var) {
+    size_t last = --vars->envp_len;
+    if (var->env_index != last) {
+        const char *name = vars->env_names[last];
+        size_t name_len = strlen(name);
+        var_t *moved = find_slot(vars, name, name_len, hash_name(name, name_len));
+        moved->env_index = var->env_index;
+        vars->envp[var->env_index] = vars->envp[last];
+        vars->env_names[var->env_index] = name;
+    }
+    vars->envp[last] = NULL;
+    free(var->env);
+    var->env = NULL;
+}
+
+/*
+ * brings a variable's envp entry up to date, after its value or whether it is
+ * exported changed, returns 0 on success, -1 on failure
+ */
+static int update_env(vars_t *vars, var_t *var) {
+    if (!var->exported || !var->set) {
+        if (var->env != NULL) {
+            remove_env(vars, var);
+        }
+        return 0;
+    }
+
+    char *env = (char *)realloc(var->env, var->name_len + var->len + 2);
+    if (env == NULL) {
+        return -1;
+    }
+    memcpy(env, var->name, var->name_len);
+    env[var->name_len] = '=';
+    memcpy(env + var->name_len + 1, value_of(var), var->len + 1);
+
+    if (var->env == NULL) {
+        // one more entry and the null at the end
+        if (vars->envp_len + 2 > vars->envp_size) {
+            vars->envp_size *= 2;
+            vars->envp = (char **)realloc(vars->envp,
+                                          vars->envp_size * sizeof(char *));
+            vars->env_names = (const char **)realloc(
+                vars->env_names, vars->envp_size * sizeof(char *));
+        }
+        var->env_index = vars->envp_len++;
+        vars->env_names[var->env_index] = var->name;
+        vars->envp[vars->envp_len] = NULL;
+    }
+    var->env = env;
+    vars->envp[var->env_index] = env;
+    return 0;
+}
+
+/* initializes an empty variable table, returns pointer */
+vars_t *init_vars() {
+    vars_t *vars = (vars_t *)malloc(sizeof(vars_t));
+    vars->slots = (var_t *)calloc(INITIAL_SLOTS, sizeof(var_t));
+    vars->num_slots = INITIAL_SLOTS;
+    vars->num_vars = 0;
+    vars->names = init_arena(NAMES_SIZE);
+    vars->envp = (char **)calloc(INITIAL_ENVP, sizeof(char *));
+    vars->env_names = (const char **)calloc(INITIAL_ENVP, sizeof(char *));
+    vars->envp_len = 0;
+    vars->envp_size = INITIAL_ENVP;
+    return vars;
+}
+
+/*
+ * cleans up the variable table
+ * Note: this function will free the vars pointer
+ * DO NOT use the pointer after this function is called
+ */
+void cleanup_vars(vars_t *vars) {
+    if (vars == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < vars->num_slots; i++) {
+        if (vars->slots[i].capacity > 0) {
+            free(vars->slots[i].value.heap);
+        }
+        free(vars->slots[i].env);
+    }
+    free(vars->slots);
+    free(vars->envp);
+    free(vars->env_names);
+    cleanup_arena(vars->names);
+    free(vars);
+}
+
+/*
+ * gets the length of the variable name at the start of s, a letter or _
+ * followed by letters, digits and _, returns 0 if s doesn't start with one
+ */
+size_t var_name_len(const char *s) {
+    if (!(*s == '_' || (*s >= 'a' && *s <= 'z') || (*s >= 'A' && *s <= 'Z'))) {
+        return 0;
+    }
+    size_t len = 1;
+    while (s[len] == '_' || (s[len] >= 'a' && s[len] <= 'z') ||
+           (s[len] >= 'A' && s[len] <= 'Z') ||
+           (s[len] >= '0' && s[len] <= '9')) {
+        len++;
+    }
+    return len;
+}
+
+/*
+ * sets a variable, the name is the first name_len bytes of name and doesn't
+ * need to be null terminated, neither does the value, which must not point
+ * into the variable's current value
+ * returns 0 on success, -1 on failure
+ */
+int set_var(vars_t *vars, const char *name, size_t name_len, const char *value,
+            size_t value_len) {
+    if (vars == NULL || name == NULL || name_len == 0 || value == NULL) {
+        return -1;
+    }
+
+    var_t *var = intern_var(vars, name, name_len);
+
+    // a value that fits where the old one is doesn't need an allocation
+    if (var->capacity <= value_len &&
+        !(var->capacity == 0 && value_len < INLINE_SIZE)) {
+        char *heap = (char *)realloc(var->capacity == 0 ? NULL : var->value.heap,
+                                     value_len + 1);
+        if (heap == NULL) {
+            return -1;
+        }
+        var->value.heap = heap;
+        var->capacity = value_len + 1;
+    }
+
+    char *buffer = value_of(var);
+    memcpy(buffer, value, value_len);
+    buffer[value_len] = '\0';
+    var->len = value_len;
+    var->set = 1;
+    return var->exported ? update_env(vars, var) : 0;
+}
+
+/*
+ * gets the value of a variable, the name doesn't need to be null terminated
+ * returns the value, null terminated, and sets *len to its length if len isn't
+ * NULL, returns NULL if the variable isn't set or vars is NULL
+ * the value is only valid until the next set_var()
+ */
+const char *get_var(vars_t *vars, const char *name, size_t name_len,
+                    size_t *len) {
+    if (vars == NULL || name_len == 0) {
+        return NULL;
+    }
+    var_t *var = find_slot(vars, name, name_len, hash_name(name, name_len));
+    if (var->name == NULL || !var->set) {
+        return NULL;
+    }
+    if (len != NULL) {
+        *len = var->len;
+    }
+    return value_of(var);
+}
+
+/*
+ * unsets a variable, which also takes it out of the environment, the name
+ * doesn't need to be null terminated, returns 0 on success, -1 on failure
+ */
+int unset_var(vars_t *vars, const char *name, size_t name_len) {
+    if (vars == NULL || name_len == 0) {
+        return -1;
+    }
+    var_t *var = find_slot(vars, name, name_len, hash_name(name, name_len));
+    if (var->name == NULL) {
+        return 0;
+    }
+    var->set = 0;
+    var->exported = 0;
+    var->len = 0;
+    return update_env(vars, var);
+}
+
+/*
+ * exports a variable, so it is in the environment of commands whenever it is
+ * set, the name doesn't need to be null terminated
+ * returns 0 on success, -1 on failure
+ */
+int export_var(vars_t *vars, const char *name, size_t name_len) {
+    if (vars == NULL || name_len == 0) {
+        return -1;
+    }
+    var_t *var = intern_var(vars, name, name_len);
+    var->exported = 1;
+    return update_env(vars, var);
+}
+
+/*
+ * sets and exports every NAME=value of env, an environment like environ,
+ * entries whose name isn't a valid variable name are left out
+ */
+void import_env(vars_t *vars, char **env) {
+    for (size_t i = 0; env != NULL && env[i] != NULL; i++) {
+        size_t name_len = var_name_len(env[i]);
+        if (name_len > 0 && env[i][name_len] == '=') {
+            const char *value = env[i] + name_len + 1;
+            set_var(vars, env[i], name_len, value, strlen(value));
+            export_var(vars, env[i], name_len);
+        }
+    }
+}
+
+/*
+ * gets the environment of commands, every exported variable that is set as
+ * NAME=value, null terminated, it stays valid until a variable changes
+ */
+char **get_envp(vars_t *vars) { return vars->envp; }
+
+/*
+ * builds the environment of one command, envp with the NAME=value overrides
+ * put over it, in order so a later override wins, only the array is
+ * allocated, from the arena, and it points at the overrides themselves
+ * returns the environment, null terminated
+ */
+char **overlay_envp(vars_t *vars, arena_t *arena, char **overrides, int num) {
+    size_t len = vars->envp_len;
+    char **envp = (char **)arena_alloc(
+        arena, (len + (size_t)num + 1) * sizeof(char *));
+    memcpy(envp, vars->envp, len * sizeof(char *));
+
+    for (int i = 0; i < num; i++) {
+        size_t name_len = var_name_len(overrides[i]);
+        var_t *var = find_slot(vars, overrides[i], name_len,
+                               hash_name(overrides[i], name_len));
+        if (var->env != NULL) {
+            envp[var->env_index] = overrides[i];
+            continue;
+        }
+
+        // not in the environment, unless an earlier override added it
+        size_t j = vars->envp_len;
+        while (j < len && strncmp(envp[j], overrides[i], name_len + 1) != 0) {
+            j++;
+        }
+        envp[j] = overrides[i];
+        if (j == len) {
+            len++;
+        }
+    }
+    envp[len] = NULL;
+    return envp;
+}
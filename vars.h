@@ -0,0 +1,76 @@
+#ifndef VARS_H_
+#define VARS_H_
+
+#include <stddef.h>
+#include "./arena.h"
+
+typedef struct vars vars_t;
+
+/* initializes an empty variable table, returns pointer */
+vars_t *init_vars();
+/*
+ * cleans up the variable table
+ * Note: this function will free the vars pointer
+ * DO NOT use the pointer after this function is called
+ */
+void cleanup_vars(vars_t *vars);
+
+/*
+ * gets the length of the variable name at the start of s, a letter or _
+ * followed by letters, digits and _, returns 0 if s doesn't start with one
+ */
+size_t var_name_len(const char *s);
+
+/*
+ * sets a variable, the name is the first name_len bytes of name and doesn't
+ * need to be null terminated, neither does the value, which must not point
+ * into the variable's current value
+ * returns 0 on success, -1 on failure
+ */
+int set_var(vars_t *vars, const char *name, size_t name_len, const char *value,
+            size_t value_len);
+
+/*
+ * gets the value of a variable, the name doesn't need to be null terminated
+ * returns the value, null terminated, and sets *len to its length if len isn't
+ * NULL, returns NULL if the variable isn't set or vars is NULL
+ * the value is only valid until the next set_var()
+ */
+const char *get_var(vars_t *vars, const char *name, size_t name_len,
+                    size_t *len);
+
+/*
+ * unsets a variable, which also takes it out of the environment, the name
+ * doesn't need to be null terminated, returns 0 on success, -1 on failure
+ */
+int unset_var(vars_t *vars, const char *name, size_t name_len);
+
+/*
+ * exports a variable, so it is in the environment of commands whenever it is
+ * set, the name doesn't need to be null terminated
+ * returns 0 on success, -1 on failure
+ */
+int export_var(vars_t *vars, const char *name, size_t name_len);
+
+/*
+ * sets and exports every NAME=value of env, an environment like environ,
+ * entries whose name isn't a valid variable name are left out
+ */
+void import_env(vars_t *vars, char **env);
+
+/*
+ * gets the environment of commands, every exported variable that is set as
+ * NAME=value, null terminated, it stays valid until a variable changes
+ * it is kept up to date as variables change, so getting it costs nothing
+ */
+char **get_envp(vars_t *vars);
+
+/*
+ * builds the environment of one command, envp with the NAME=value overrides
+ * put over it, in order so a later override wins, only the array is
+ * allocated, from the arena, and it points at the overrides themselves
+ * returns the environment, null terminated
+ */
+char **overlay_envp(vars_t *vars, arena_t *arena, char **overrides, int num);
+
+#endif  // VARS_H_
@@ -0,0 +1,386 @@
+#include "./walk.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "./arena.h"
+
+#define MAX_WORKERS 16        // threads a walk uses at most
+#define DENTS_SIZE (1 << 16)  // bytes of directory entries read at once
+#define PATHS_SIZE (1 << 16)  // first block of the arena of a worker's paths
+#define INITIAL_TASKS 64
+#define INITIAL_FOUND 256
+
+// a directory waiting to be read
+typedef struct task {
+    const char *path;  // as it is reported, empty for the working directory
+    size_t len;
+    int depth;
+} task_t;
+
+typedef struct pool pool_t;
+
+// a thread of the walk, with the directories it has yet to read, which the
+// others take from the front while it takes from the back, so it goes
+// depth first through its own part of the tree and what is taken from it is
+// near the root, with the most under it
+typedef struct worker {
+    pool_t *pool;
+    pthread_t thread;
+    pthread_mutex_t lock;  // guards the tasks, which other workers take
+    task_t *tasks;
+    size_t first;          // the tasks are from first up to end
+    size_t end;
+    size_t max_tasks;
+    arena_t *paths;        // the paths of its tasks and of what it found
+    const char **found;    // grown by doubling
+    size_t num_found;
+    size_t max_found;
+    size_t found_bytes;
+    char *dents;           // the buffer getdents64() reads into
+} worker_t;
+
+struct pool {
+    const walk_t *walk;
+    worker_t workers[MAX_WORKERS];
+    size_t num_workers;
+    pthread_mutex_t lock;  // guards waiting on wake
+    pthread_cond_t wake;
+    size_t queued;   // tasks in any worker's list
+    size_t pending;  // tasks that haven't been read yet, 0 once the walk is done
+    size_t idle;     // workers waiting on wake
+};
+
+/* adds a path that was found */
+static void add_found(worker_t *worker, const char *path, size_t len) {
+    if (worker->num_found == worker->max_found) {
+        worker->max_found = worker->max_found == 0 ? INITIAL_FOUND : worker->max_found * 2;
+        worker->found = (const char **)realloc(worker->found,
+                                               worker->max_found * sizeof(char *));
+    }
+    worker->found[worker->num_found++] = path;
+    worker->found_bytes += len + 1;
+}
+
+/* adds a directory to the back of the worker's tasks, waking a worker that is idle */
+static void push_task(worker_t *worker, const char *path, size_t len, int depth) {
+    pool_t *pool = worker->pool;
+
+    pthread_mutex_lock(&worker->lock);
+    if (worker->end == worker->max_tasks) {
+        if (worker->first > worker->max_tasks / 2) {
+            memmove(worker->tasks, worker->tasks + worker->first,
+                    (worker->end - worker->first) * sizeof(task_t));
+            worker->end -= worker->first;
+            worker->first = 0;
+        } else {
+            worker->max_tasks = worker->max_tasks == 0 ? INITIAL_TASKS : worker->max_tasks * 2;
+            worker->tasks = (task_t *)realloc(worker->tasks,
+                                              worker->max_tasks * sizeof(task_t));
+        }
+    }
+    task_t *task = &worker->tasks[worker->end++];
+    task->path = path;
+    task->len = len;
+    task->depth = depth;
+    pthread_mutex_unlock(&worker->lock);
+
+    __atomic_add_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&pool->queued, 1, __ATOMIC_SEQ_CST);
+    // a worker checks queued after it counts itself idle, and this checks
+    // idle after counting the task, so one of the two sees the other
+    if (__atomic_load_n(&pool->idle, __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&pool->lock);
+        pthread_cond_signal(&pool->wake);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+/*
+ * takes a task from the back of a worker's own tasks, or from the front of
+ * another's if from isn't the worker itself
+ * returns non-zero if there was one
+ */
+static int take_task(worker_t *worker, worker_t *from, task_t *task) {
+    int taken = 0;
+
+    pthread_mutex_lock(&from->lock);
+    if (from->first < from->end) {
+        *task = from == worker ? from->tasks[--from->end] : from->tasks[from->first++];
+        if (from->first == from->end) {
+            from->first = from->end = 0;
+        }
+        taken = 1;
+    }
+    pthread_mutex_unlock(&from->lock);
+    if (taken) {
+        __atomic_sub_fetch(&worker->pool->queued, 1, __ATOMIC_SEQ_CST);
+    }
+    return taken;
+}
+
+/* gets the WALK_ type of an entry, from its d_type or statx() if it has none */
+static int entry_type(int fd, const struct dirent64 *dent) {
+    unsigned char type = dent->d_type;
+    if (type == DT_UNKNOWN) {
+        struct statx stx;
+        if (statx(fd, dent->d_name, AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT, STATX_TYPE,
+                  &stx) != 0) {
+            return WALK_OTHER;
+        }
+        return S_ISDIR(stx.stx_mode) ? WALK_DIR
+               : S_ISREG(stx.stx_mode) ? WALK_FILE
+               : S_ISLNK(stx.stx_mode) ? WALK_LINK
+                                       : WALK_OTHER;
+    }
+    return type == DT_DIR ? WALK_DIR
+           : type == DT_REG ? WALK_FILE
+           : type == DT_LNK ? WALK_LINK
+                            : WALK_OTHER;
+}
+
+/* reads a directory, reporting what it has in it and adding its directories as tasks */
+static void read_dir(worker_t *worker, const task_t *task) {
+    const walk_t *walk = worker->pool->walk;
+    int depth = task->depth + 1;
+    int report = depth >= walk->min_depth;
+    int descend = walk->max_depth < 0 || depth < walk->max_depth;
+    char path[PATH_MAX];
+    size_t len = task->len;
+    ssize_t n;
+
+    int fd = openat(AT_FDCWD, len == 0 ? "." : task->path,
+                    O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    memcpy(path, task->path, len);
+    if (len > 0 && path[len - 1] != '/') {
+        path[len++] = '/';
+    }
+    while ((n = getdents64(fd, worker->dents, DENTS_SIZE)) > 0) {
+        for (ssize_t offset = 0; offset < n;) {
+            const struct dirent64 *dent = (const struct dirent64 *)(worker->dents + offset);
+            offset += dent->d_reclen;
+            const char *name = dent->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+                continue;
+            }
+            size_t name_len = strlen(name);
+            if (len + name_len + 1 > PATH_MAX) {
+                continue;
+            }
+            int type = entry_type(fd, dent);
+            int found = report && (type & walk->types) &&
+                        (walk->filter == NULL ||
+                         walk->filter(walk->data, name, name_len, type));
+            int dir = type == WALK_DIR && descend && (name[0] != '.' || walk->hidden);
+            if (!found && !dir) {
+                continue;
+            }
+
+            char *copy = (char *)arena_alloc(worker->paths, len + name_len + 1);
+            memcpy(copy, path, len);
+            memcpy(copy + len, name, name_len + 1);
+            if (found) {
+                add_found(worker, copy, len + name_len);
+            }
+            if (dir) {
+                push_task(worker, copy, len + name_len, depth);
+            }
+        }
+    }
+    close(fd);
+}
+
+/*
+ * reads directories until there are none left, its own first, then any other
+ * worker's, waiting for more while a directory is still being read
+ */
+static void *run_worker(void *arg) {
+    worker_t *worker = (worker_t *)arg;
+    pool_t *pool = worker->pool;
+    size_t self = (size_t)(worker - pool->workers);
+    task_t task;
+
+    for (;;) {
+        int taken = take_task(worker, worker, &task);
+        for (size_t i = 1; !taken && i < pool->num_workers; i++) {
+            taken = take_task(worker, &pool->workers[(self + i) % pool->num_workers], &task);
+        }
+        if (taken) {
+            read_dir(worker, &task);
+            if (__atomic_sub_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST) == 0) {
+                pthread_mutex_lock(&pool->lock);
+                pthread_cond_broadcast(&pool->wake);
+                pthread_mutex_unlock(&pool->lock);
+            }
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        __atomic_add_fetch(&pool->idle, 1, __ATOMIC_SEQ_CST);
+        while (__atomic_load_n(&pool->queued, __ATOMIC_SEQ_CST) == 0 &&
+               __atomic_load_n(&pool->pending, __ATOMIC_SEQ_CST) > 0) {
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        }
+        __atomic_sub_fetch(&pool->idle, 1, __ATOMIC_SEQ_CST);
+        int done = __atomic_load_n(&pool->pending, __ATOMIC_SEQ_CST) == 0;
+        pthread_mutex_unlock(&pool->lock);
+        if (done) {
+            return NULL;
+        }
+    }
+}
+
+/* orders paths, for qsort() */
+static int compare_paths(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/*
+ * orders paths with a / before any other byte, so everything under a
+ * directory comes right after it, for qsort()
+ */
+static int compare_tree(const void *a, const void *b) {
+    const unsigned char *s = *(const unsigned char *const *)a;
+    const unsigned char *t = *(const unsigned char *const *)b;
+    while (*s != '\0' && *s == *t) {
+        s++;
+        t++;
+    }
+    int x = *s == '/' ? 1 : *s == '\0' ? 0 : *s + 1;
+    int y = *t == '/' ? 1 : *t == '\0' ? 0 : *t + 1;
+    return x - y;
+}
+
+/* gets the number of threads a walk uses */
+static size_t num_threads(const walk_t *walk) {
+    long threads = walk->threads > 0 ? walk->threads : sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) {
+        return 1;
+    }
+    return threads > MAX_WORKERS ? MAX_WORKERS : (size_t)threads;
+}
+
+/*
+ * walks the tree under root with a pool of threads, each going through
+ * directories of its own and taking them from the others once it runs out,
+ * symbolic links are reported but not followed, and directories that can't
+ * be read are skipped
+ * paths are reported as root followed by the path under it, the root itself
+ * as it is, an empty root is the working directory, whose entries are
+ * reported without a ./ in front
+ * *paths is set to the paths, sorted by strcmp(), or with every directory
+ * right before what is in it if walk->tree_order is set, the array and the
+ * paths are one malloc'd block, freed with free()
+ * returns the number of paths, -1 if root doesn't exist
+ */
+ssize_t walk_tree(const char *root, const walk_t *walk, char ***paths) {
+    size_t len = strlen(root);
+    struct stat st;
+    int root_found = 0;
+
+    *paths = NULL;
+    // a root that ends with a / is the directory a link to it points to
+    if ((len == 0 || root[len - 1] == '/' ? stat(len == 0 ? "." : root, &st)
+                                           : lstat(root, &st)) != 0) {
+        return -1;
+    }
+    int type = S_ISDIR(st.st_mode) ? WALK_DIR
+               : S_ISREG(st.st_mode) ? WALK_FILE
+               : S_ISLNK(st.st_mode) ? WALK_LINK
+                                     : WALK_OTHER;
+    if (walk->min_depth <= 0 && len > 0 && (type & walk->types)) {
+        // the root is filtered by its last component
+        size_t end = len;
+        while (end > 1 && root[end - 1] == '/') {
+            end--;
+        }
+        size_t start = end;
+        while (start > 0 && root[start - 1] != '/') {
+            start--;
+        }
+        root_found = walk->filter == NULL ||
+                     walk->filter(walk->data, root + start, end - start, type);
+    }
+
+    pool_t *pool = (pool_t *)calloc(1, sizeof(pool_t));
+    pool->walk = walk;
+    pool->num_workers = type == WALK_DIR && walk->max_depth != 0 ? num_threads(walk) : 0;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    for (size_t i = 0; i < pool->num_workers; i++) {
+        worker_t *worker = &pool->workers[i];
+        worker->pool = pool;
+        pthread_mutex_init(&worker->lock, NULL);
+        worker->paths = init_arena(PATHS_SIZE);
+        worker->dents = (char *)malloc(DENTS_SIZE);
+    }
+
+    if (pool->num_workers > 0) {
+        push_task(&pool->workers[0], root, len, 0);
+        // the workers leave signals to the shell, and the first one is this thread
+        sigset_t all;
+        sigset_t mask;
+        sigfillset(&all);
+        pthread_sigmask(SIG_SETMASK, &all, &mask);
+        size_t started = 1;
+        while (started < pool->num_workers &&
+               pthread_create(&pool->workers[started].thread, NULL, run_worker,
+                              &pool->workers[started]) == 0) {
+            started++;
+        }
+        pthread_sigmask(SIG_SETMASK, &mask, NULL);
+        // any that didn't start never get a task, the others take them all
+        run_worker(&pool->workers[0]);
+        for (size_t i = 1; i < started; i++) {
+            pthread_join(pool->workers[i].thread, NULL);
+        }
+    }
+
+    // everything that was found goes in one block, the array then the paths
+    size_t num = (size_t)root_found;
+    size_t bytes = root_found ? len + 1 : 0;
+    for (size_t i = 0; i < pool->num_workers; i++) {
+        num += pool->workers[i].num_found;
+        bytes += pool->workers[i].found_bytes;
+    }
+    char **array = (char **)malloc(num * sizeof(char *) + bytes + 1);
+    char *next = (char *)(array + num);
+    size_t at = 0;
+    if (root_found) {
+        memcpy(next, root, len + 1);
+        array[at++] = next;
+        next += len + 1;
+    }
+    for (size_t i = 0; i < pool->num_workers; i++) {
+        worker_t *worker = &pool->workers[i];
+        for (size_t f = 0; f < worker->num_found; f++) {
+            size_t n = strlen(worker->found[f]) + 1;
+            memcpy(next, worker->found[f], n);
+            array[at++] = next;
+            next += n;
+        }
+        pthread_mutex_destroy(&worker->lock);
+        cleanup_arena(worker->paths);
+        free(worker->found);
+        free(worker->tasks);
+        free(worker->dents);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wake);
+    free(pool);
+
+    // the threads found them in whatever order they got to them
+    if (num > 1) {
+        qsort(array, num, sizeof(char *), walk->tree_order ? compare_tree : compare_paths);
+    }
+    *paths = array;
+    return (ssize_t)num;
+}
@@ -0,0 +1,47 @@
+#ifndef WALK_H_
+#define WALK_H_
+
+#include <stddef.h>
+#include <sys/types.h>
+
+// the types of entries a walk reports
+#define WALK_FILE 1
+#define WALK_DIR 2
+#define WALK_LINK 4
+#define WALK_OTHER 8
+#define WALK_ANY (WALK_FILE | WALK_DIR | WALK_LINK | WALK_OTHER)
+
+/*
+ * decides whether an entry is reported, from its name, len bytes long, and its
+ * type, it is called from every thread of the walk at once
+ * returns non-zero to report the entry
+ */
+typedef int (*walk_filter_t)(void *data, const char *name, size_t len, int type);
+
+typedef struct walk {
+    walk_filter_t filter;  // NULL reports every entry
+    void *data;            // passed to the filter
+    int types;             // the WALK_ types that are reported
+    int min_depth;         // the root is at depth 0, the entries in it at 1
+    int max_depth;         // -1 for no limit
+    int hidden;            // non-zero to go into directories whose names start with .
+    int tree_order;        // non-zero to sort a directory right before what is in it
+    int threads;           // 0 for one for every processor
+} walk_t;
+
+/*
+ * walks the tree under root with a pool of threads, each going through
+ * directories of its own and taking them from the others once it runs out,
+ * symbolic links are reported but not followed, and directories that can't
+ * be read are skipped
+ * paths are reported as root followed by the path under it, the root itself
+ * as it is, an empty root is the working directory, whose entries are
+ * reported without a ./ in front
+ * *paths is set to the paths, sorted by strcmp(), or with every directory
+ * right before what is in it if walk->tree_order is set, the array and the
+ * paths are one malloc'd block, freed with free()
+ * returns the number of paths, -1 if root doesn't exist
+ */
+ssize_t walk_tree(const char *root, const walk_t *walk, char ***paths);
+
+#endif  // WALK_H_